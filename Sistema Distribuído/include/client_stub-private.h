@@ -6,6 +6,9 @@
 #ifndef _CLIENT_STUB_PRIVATE_H
 #define _CLIENT_STUB_PRIVATE_H
 
+// Entries sent on each OP_BULKLOAD message.
+#define BULK_LOAD_CHUNK_SIZE 1000
+
 struct rtree_t
 {
     struct sockaddr_in *p_sockaddr;
@@ -14,4 +17,34 @@ struct rtree_t
 
 void rtree_quit( struct rtree_t *p_rtree );
 
+struct message_t;
+struct entry_t;
+
+/*
+ * Sends a request that is answered with CT_ENTRIES (e.g. OP_SCAN) and copies the entries received.
+ *
+ * Parameters:
+ *      p_rtree: remote tree.
+ *      p_msg: request to send. The caller keeps ownership of the request MessageT.
+ *
+ * Returns:
+ *      NULL terminated array of entries (each one freed with entry_destroy); NULL on error.
+ */
+struct entry_t **rtree_send_receive_entries( struct rtree_t *p_rtree, struct message_t *p_msg );
+
+/*
+ * Sends a request carrying entries (OP_BULKLOAD, OP_PUTBATCH). Keys and values are not copied.
+ *
+ * Parameters:
+ *      p_rtree: remote tree.
+ *      opcode: request opcode.
+ *      pp_entries: entries to send.
+ *      n: number of entries.
+ *      result: value of the result field of the request.
+ *
+ * Returns:
+ *      The result field of the answer; -1 on error.
+ */
+int rtree_send_entries( struct rtree_t *p_rtree, int opcode, struct entry_t **pp_entries, int n, int result );
+
 #endif
\ No newline at end of file
@@ -20,6 +20,11 @@ struct rtree_t *rtree_connect(const char *address_port);
  */
 int rtree_disconnect(struct rtree_t *p_rtree);
 
+/* Função para verificar se a operação op_n (devolvida por uma escrita)
+ * já foi executada no servidor (ver verify).
+ * Devolve 0 (executada), -1 (ainda não executada ou problemas, com errno
+ * a EBADMSG se op_n não foi atribuído) ou -2 (executada, mas rejeitada).
+ */
 int rtree_verify(struct rtree_t *rtree, int op_n);
 
 /* Função para adicionar um elemento na árvore.
@@ -33,12 +38,20 @@ int rtree_put(struct rtree_t *rtree, struct entry_t *entry);
  */
 struct data_t *rtree_get(struct rtree_t *rtree, char *key);
 
+/* Função igual a rtree_get, para chaves binárias com keysize bytes.
+ */
+struct data_t *rtree_get2(struct rtree_t *rtree, char *key, size_t keysize);
+
 /* Função para remover um elemento da árvore. Vai libertar 
  * toda a memoria alocada na respetiva operação rtree_put().
  * Devolve: 0 (ok), -1 (key not found ou problemas).
  */
 int rtree_del(struct rtree_t *rtree, char *key);
 
+/* Função igual a rtree_del, para chaves binárias com keysize bytes.
+ */
+int rtree_del2(struct rtree_t *rtree, char *key, size_t keysize);
+
 /* Devolve o número de elementos contidos na árvore.
  */
 int rtree_size(struct rtree_t *rtree);
@@ -57,5 +70,69 @@ char **rtree_get_keys(struct rtree_t *rtree);
  */
 void **rtree_get_values(struct rtree_t *rtree);
 
+/* Devolve uma cópia da key na posição index da ordenação das keys da
+ * árvore (a primeira key tem index 0).
+ * Em caso de erro ou index fora dos limites, devolve NULL.
+ */
+char *rtree_get_key_at(struct rtree_t *rtree, int index);
+
+/* Devolve o número de keys da árvore menores que key, ou -1 em caso
+ * de erro.
+ */
+int rtree_get_rank(struct rtree_t *rtree, char *key);
+
+/* Função igual a rtree_get_rank, para chaves binárias com keysize bytes.
+ */
+int rtree_get_rank2(struct rtree_t *rtree, char *key, size_t keysize);
+
+/* Devolve um array de char* com a cópia das keys nas posições
+ * [offset, offset + limit) da ordenação das keys da árvore, colocando
+ * um último elemento a NULL.
+ */
+char **rtree_get_keys_page(struct rtree_t *rtree, int offset, int limit);
+
+/* Devolve um array de entry_t* com a cópia das entradas (key e value)
+ * com key em [start_key, end_key), por ordem lexicográfica, colocando um
+ * último elemento a NULL. start_key/end_key a NULL não limitam o
+ * intervalo e limit <= 0 devolve todas as entradas do intervalo.
+ * Cada entrada deve ser libertada com entry_destroy().
+ * Em caso de erro, devolve NULL.
+ */
+struct entry_t **rtree_scan(struct rtree_t *rtree, char *start_key, char *end_key, int limit);
+
+/* Função igual a rtree_scan, mas com o tamanho de start_key e end_key
+ * (que podem ser binárias).
+ */
+struct entry_t **rtree_scan2(struct rtree_t *rtree, char *start_key, size_t start_keysize, char *end_key,
+                             size_t end_keysize, int limit);
+
+/* Semelhante a rtree_scan(), mas devolve as entradas cuja key começa
+ * por prefix.
+ * Em caso de erro, devolve NULL.
+ */
+struct entry_t **rtree_scan_prefix(struct rtree_t *rtree, char *prefix, int limit);
+
+/* Função igual a rtree_scan_prefix, mas com o tamanho de prefix (que pode
+ * ser binário).
+ */
+struct entry_t **rtree_scan_prefix2(struct rtree_t *rtree, char *prefix, size_t prefixsize, int limit);
+
+/* Função para carregar uma árvore remota vazia com n entradas, por
+ * ordem estritamente crescente da key (ver tree_bulk_load). As entradas
+ * são enviadas em blocos de BULK_LOAD_CHUNK_SIZE e aplicadas de uma só
+ * vez quando o último bloco chega ao servidor.
+ * Devolve o número da operação (ver rtree_verify) ou -1 em caso de erro.
+ * A carga é aplicada depois da resposta: se o servidor a rejeitar (árvore
+ * não vazia), a operação fica executada na mesma e só rtree_verify, que
+ * devolve -2, o indica.
+ */
+int rtree_bulk_load(struct rtree_t *rtree, struct entry_t **entries, int n);
+
+/* Função para adicionar ou substituir n entradas numa só mensagem, que
+ * o servidor aplica como uma só operação de escrita (ver tree_put_batch).
+ * Devolve o número da operação (ver rtree_verify) ou -1 em caso de erro.
+ */
+int rtree_put_batch(struct rtree_t *rtree, struct entry_t **entries, int n);
+
 
 #endif
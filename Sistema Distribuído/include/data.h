@@ -6,6 +6,7 @@
 struct data_t
 {
     int datasize; /* Tamanho do bloco de dados */
+    int refcount; /* Número de referências (0 se o data_t faz parte de outra estrutura) */
     void* data;   /* Conteúdo arbitrário */
 };
 
@@ -30,6 +31,15 @@ void data_destroy( struct data_t* data );
  */
 struct data_t* data_dup( struct data_t* data );
 
+/* Função que devolve uma referência para um data_t criado pelas funções
+ * acima, sem copiar os dados: incrementa o contador de referências e
+ * devolve o mesmo data_t. Cada referência é libertada com data_destroy e
+ * os dados só são libertados com a última. Os dados partilhados não devem
+ * ser alterados. Um data_t que faz parte de outra estrutura (refcount 0) é
+ * duplicado com data_dup.
+ */
+struct data_t* data_share( struct data_t* data );
+
 /* Função que substitui o conteúdo de um elemento de dados data_t.
 *  Deve assegurar que destroi o conteúdo antigo do mesmo.
 */
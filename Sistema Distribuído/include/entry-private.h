@@ -0,0 +1,79 @@
+// Grupo 55
+// Jose Alves nº 44898
+// Gustavo Jardim nº 48483
+// Henrique Lopes nº 52840
+
+#ifndef _ENTRY_PRIVATE_H
+#define _ENTRY_PRIVATE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "entry.h"
+
+/*
+ * Number of leading key bytes cached on entry_t.key_prefix.
+ */
+#define ENTRY_KEY_PREFIX_SIZE 8
+
+/*
+ * Computes the cached prefix of a key: its first ENTRY_KEY_PREFIX_SIZE bytes loaded big-endian and zero padded, so
+ * comparing two prefixes as integers gives the same order as memcmp on those bytes.
+ *
+ * Parameters:
+ *      p_key: Key bytes.
+ *      keysize: Number of bytes of the key.
+ *
+ * Returns:
+ *      The prefix.
+ */
+static inline uint64_t entry_key_prefix( const char* p_key, size_t keysize )
+{
+    uint64_t prefix = 0;
+    size_t n = keysize < ENTRY_KEY_PREFIX_SIZE ? keysize : ENTRY_KEY_PREFIX_SIZE;
+
+    for ( size_t i = 0; i < ENTRY_KEY_PREFIX_SIZE; i++ )
+        prefix = (prefix << 8) | (i < n ? (uint8_t)p_key[i] : 0);
+
+    return prefix;
+}
+
+/*
+ * Sets the key members of an entry (key, keysize and key_prefix), without copying the key.
+ */
+static inline void entry_key_set( struct entry_t* p_entry, char* p_key, size_t keysize )
+{
+    p_entry->key = p_key;
+    p_entry->keysize = keysize;
+    p_entry->key_prefix = p_key ? entry_key_prefix( p_key, keysize ) : 0;
+}
+
+/*
+ * Compares the keys of two entries. Both keys must be set (not NULL).
+ *
+ * Different prefixes decide with one integer compare. Otherwise the first bytes are equal (or one key is a shorter
+ * zero padded prefix of the other) and only the remaining bytes and the sizes are looked at.
+ *
+ * Returns:
+ *      0 if the keys are equal, < 0 if key1 < key2, > 0 otherwise.
+ */
+static inline int entry_key_compare( struct entry_t* p_entry1, struct entry_t* p_entry2 )
+{
+    if ( p_entry1->key_prefix != p_entry2->key_prefix )
+        return p_entry1->key_prefix < p_entry2->key_prefix ? -1 : 1;
+
+    size_t min_size = p_entry1->keysize < p_entry2->keysize ? p_entry1->keysize : p_entry2->keysize;
+
+    if ( min_size > ENTRY_KEY_PREFIX_SIZE )
+    {
+        int compare_value = memcmp( p_entry1->key + ENTRY_KEY_PREFIX_SIZE, p_entry2->key + ENTRY_KEY_PREFIX_SIZE,
+                                    min_size - ENTRY_KEY_PREFIX_SIZE );
+
+        if ( compare_value != 0 )
+            return compare_value;
+    }
+
+    return (p_entry1->keysize > p_entry2->keysize) - (p_entry1->keysize < p_entry2->keysize);
+}
+
+#endif
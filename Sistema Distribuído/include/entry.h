@@ -1,14 +1,21 @@
 #ifndef _ENTRY_H
 #define _ENTRY_H /* Módulo entry */
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "data.h"
 
 /* Esta estrutura define o par {chave, valor} para a árvore
+ * A chave é uma sequência de keysize bytes arbitrários; as chaves criadas
+ * a partir de strings (entry_create) mantêm também o '\0' final.
  */
 struct entry_t
 {
-    char* key;    /* string, cadeia de caracteres terminada por '\0' */
+    char* key;    /* keysize bytes de chave */
     struct data_t* value; /* Bloco de dados */
+    size_t keysize;       /* Tamanho da chave, sem '\0' */
+    uint64_t key_prefix;  /* Primeiros 8 bytes da chave (big-endian) */
 };
 
 /* Função que cria uma entry, reservando a memória necessária para a
@@ -19,6 +26,11 @@ struct entry_t
  */
 struct entry_t* entry_create( char* key, struct data_t* data );
 
+/* Função igual a entry_create, para chaves binárias com keysize bytes
+ * (que podem conter '\0').
+ */
+struct entry_t* entry_create2( char* key, size_t keysize, struct data_t* data );
+
 /* Função que elimina uma entry, libertando a memória por ela ocupada
  */
 void entry_destroy( struct entry_t* entry );
@@ -34,7 +46,8 @@ struct entry_t* entry_dup( struct entry_t* entry );
 void entry_replace( struct entry_t* entry, char* p_new_key, struct data_t* p_new_value );
 
 /* Função que compara duas entradas e retorna a ordem das mesmas.
-*  Ordem das entradas é definida pela ordem das suas chaves.
+*  Ordem das entradas é definida pela ordem das suas chaves (ordem de
+*  memcmp; uma chave que é prefixo de outra é menor).
 *  A função devolve 0 se forem iguais, -1 se entry1<entry2, e 1 caso contrário.
 */
 int entry_compare( struct entry_t* entry1, struct entry_t* entry2 );
@@ -12,10 +12,15 @@
 #include <unistd.h>
 
 #include "sdmessage.pb-c.h"
+#include "data.h"
 
 // Wrapper for MessageT.
+//
+// p_value_ref: reference (see data_share) to a value sent without a copy: p_MessageT->data points to its buffer.
+// NULL if there is none.
 struct message_t {
     MessageT *p_MessageT;
+    struct data_t *p_value_ref;
 };
 
 // The message OPCODES.
@@ -29,6 +34,13 @@ struct message_t {
 #define OP_GETVALUES    70
 #define OP_VERIFY       80
 #define OP_ERROR        99
+#define OP_GETKEYAT     100
+#define OP_GETRANK      110
+#define OP_GETKEYSPAGE  120
+#define OP_SCAN         130
+#define OP_SCANPREFIX   140
+#define OP_BULKLOAD     150
+#define OP_PUTBATCH     160
 
 // Response message value type code.
 #define CT_BAD          0
@@ -39,6 +51,7 @@ struct message_t {
 #define CT_VALUES       50
 #define CT_RESULT       60
 #define CT_NONE         70
+#define CT_ENTRIES      80
 
 ///**
 // * Read an entire string from a network socket.
@@ -77,6 +90,25 @@ size_t  read_all( int sockfd, char **p_buffer );
  */
 size_t write_all( int sockfd, char *p_buffer, size_t len );
 
+/**
+ * Frees a message received by the server (unpacked with message_t__unpack) and the value reference it holds.
+ *
+ * Parameters:
+ *      p_msg: message to free.
+ */
+void message_destroy( struct message_t *p_msg );
+
+/**
+ * Copies a key received on a message (bytes field) to a '\0' terminated string.
+ *
+ * Parameters:
+ *      p_key: key field of the message.
+ *
+ * Returns:
+ *      The copy (to be freed by the caller); NULL if an error occurred.
+ */
+char *message_key_dup( ProtobufCBinaryData *p_key );
+
 /**
  * Get the OPCODE constant variable name as string with the value given.
  *
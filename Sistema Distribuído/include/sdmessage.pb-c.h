@@ -31,7 +31,14 @@ typedef enum _MessageT__Opcode {
   MESSAGE_T__OPCODE__OP_GETKEYS = 60,
   MESSAGE_T__OPCODE__OP_GETVALUES = 70,
   MESSAGE_T__OPCODE__OP_VERIFY = 80,
-  MESSAGE_T__OPCODE__OP_ERROR = 99
+  MESSAGE_T__OPCODE__OP_ERROR = 99,
+  MESSAGE_T__OPCODE__OP_GETKEYAT = 100,
+  MESSAGE_T__OPCODE__OP_GETRANK = 110,
+  MESSAGE_T__OPCODE__OP_GETKEYSPAGE = 120,
+  MESSAGE_T__OPCODE__OP_SCAN = 130,
+  MESSAGE_T__OPCODE__OP_SCANPREFIX = 140,
+  MESSAGE_T__OPCODE__OP_BULKLOAD = 150,
+  MESSAGE_T__OPCODE__OP_PUTBATCH = 160
     PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(MESSAGE_T__OPCODE)
 } MessageT__Opcode;
 typedef enum _MessageT__CType {
@@ -42,7 +49,8 @@ typedef enum _MessageT__CType {
   MESSAGE_T__C_TYPE__CT_KEYS = 40,
   MESSAGE_T__C_TYPE__CT_VALUES = 50,
   MESSAGE_T__C_TYPE__CT_RESULT = 60,
-  MESSAGE_T__C_TYPE__CT_NONE = 70
+  MESSAGE_T__C_TYPE__CT_NONE = 70,
+  MESSAGE_T__C_TYPE__CT_ENTRIES = 80
     PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(MESSAGE_T__C_TYPE)
 } MessageT__CType;
 
@@ -51,12 +59,12 @@ typedef enum _MessageT__CType {
 struct  MessageT__Entry
 {
   ProtobufCMessage base;
-  char *key;
+  ProtobufCBinaryData key;
   ProtobufCBinaryData data;
 };
 #define MESSAGE_T__ENTRY__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&message_t__entry__descriptor) \
-    , (char *)protobuf_c_empty_string, {0,NULL} }
+    , {0,NULL}, {0,NULL} }
 
 
 struct  MessageT
@@ -64,18 +72,23 @@ struct  MessageT
   ProtobufCMessage base;
   MessageT__Opcode opcode;
   MessageT__CType c_type;
-  char *key;
+  ProtobufCBinaryData key;
   size_t n_keys;
-  char **keys;
+  ProtobufCBinaryData *keys;
   ProtobufCBinaryData data;
   size_t n_datas;
   ProtobufCBinaryData *datas;
   MessageT__Entry *entry;
   uint32_t result;
+  uint32_t offset;
+  uint32_t limit;
+  ProtobufCBinaryData end_key;
+  size_t n_entries;
+  MessageT__Entry **entries;
 };
 #define MESSAGE_T__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&message_t__descriptor) \
-    , MESSAGE_T__OPCODE__OP_BAD, MESSAGE_T__C_TYPE__CT_BAD, (char *)protobuf_c_empty_string, 0,NULL, {0,NULL}, 0,NULL, NULL, 0 }
+    , MESSAGE_T__OPCODE__OP_BAD, MESSAGE_T__C_TYPE__CT_BAD, {0,NULL}, 0,NULL, {0,NULL}, 0,NULL, NULL, 0, 0, 0, {0,NULL}, 0,NULL }
 
 
 /* MessageT__Entry methods */
@@ -19,4 +19,15 @@ short parse_port( char *p_input_str );
 
 int parse_int(char *p_input_str);
 
+/**
+ * Parses the tree type given to the server: "bst", "avl" (with the hash index), "art", "bptree" or "cow".
+ *
+ * Parameters:
+ *      p_input_str: input string to parse.
+ *
+ * Returns:
+ *      The type to give to tree_create2; -1 if there's an error.
+ */
+int parse_tree_type( char *p_input_str );
+
 #endif
@@ -0,0 +1,127 @@
+// Grupo 55
+// Jose Alves nº 44898
+// Gustavo Jardim nº 48483
+// Henrique Lopes nº 52840
+
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * Size-class slab allocator for the small fixed-size structures of the tree (node_t, entry_t, data_t) and the
+ * small key/value buffers.
+ *
+ * Blocks of up to SLAB_MAX_BLOCK_SIZE bytes are carved from SLAB_PAGE_SIZE pages, each page holding blocks of
+ * a single size class. All pages come from one virtual memory region reserved on first use, so slab_free can
+ * tell slab blocks from malloc() blocks with a range check: bigger requests (or requests made after the region
+ * is exhausted) go to malloc() and slab_free hands them back to free(). This also means slab_free accepts any
+ * pointer returned by malloc()/strdup(), like the buffers given to data_create2() and entry_create().
+ *
+ * Each thread keeps a cache of free blocks per size class and only takes the global lock to move a batch of
+ * blocks between its cache and the global free lists. Its allocation counters are kept with the cache and added to
+ * the global statistics while it holds that lock.
+ */
+
+#define SLAB_PAGE_SIZE          ((size_t)64 * 1024)
+#define SLAB_REGION_SIZE        ((size_t)4 * 1024 * 1024 * 1024)
+#define SLAB_MAX_BLOCK_SIZE     256
+#define SLAB_N_CLASSES          9
+
+// Blocks moved at once between a thread cache and the global free list.
+#define SLAB_CACHE_BATCH        32
+
+/*
+ * Allocation statistics of one size class.
+ *
+ * Members:
+ *      block_size: size of the blocks of the class.
+ *      pages: pages carved for this class.
+ *      allocs: number of slab_alloc calls served by this class.
+ *      frees: number of slab_free calls of blocks of this class.
+ */
+struct slab_class_stats_t
+{
+    size_t block_size;
+    size_t pages;
+    size_t allocs;
+    size_t frees;
+};
+
+/*
+ * Allocator statistics.
+ *
+ * Members:
+ *      classes: statistics per size class.
+ *      large_allocs: allocations too big for a size class (served by malloc).
+ *      large_frees: frees of blocks not owned by the slab (given back to free).
+ *      region_used: bytes of the reserved region already carved into pages.
+ */
+struct slab_stats_t
+{
+    struct slab_class_stats_t classes[SLAB_N_CLASSES];
+    size_t large_allocs;
+    size_t large_frees;
+    size_t region_used;
+};
+
+/*
+ * Allocates a block of at least size bytes.
+ *
+ * Returns:
+ *      Pointer to the block; NULL on error.
+ */
+void *slab_alloc( size_t size );
+
+/*
+ * Allocates a block of size bytes with all bits set to zero.
+ *
+ * Returns:
+ *      Pointer to the block; NULL on error.
+ */
+void *slab_calloc( size_t size );
+
+/*
+ * Copies a string to a new block.
+ *
+ * Returns:
+ *      Pointer to the copy; NULL on error.
+ */
+char *slab_strdup( const char *p_str );
+
+/*
+ * Frees a block returned by slab_alloc, slab_calloc, slab_strdup or malloc. NULL is ignored.
+ */
+void slab_free( void *p_block );
+
+/*
+ * Tells if the size bytes at p_block are inside the slab region. The region is never unmapped, so that memory can
+ * always be read, even after its blocks are freed (it then holds other blocks or free list links, never a fault).
+ *
+ * Returns:
+ *      1 if they are; 0 otherwise (malloc() blocks, or no region).
+ */
+int slab_contains( const void *p_block, size_t size );
+
+/*
+ * Gives the blocks cached by the calling thread back to the global free lists. Threads that use the allocator
+ * should call it before they terminate.
+ */
+void slab_thread_cache_flush();
+
+/*
+ * Fills p_stats with the current allocator statistics. The counts of the other threads include what they did up to
+ * their last refill, release or flush of their cache (at most a few batches behind).
+ */
+void slab_get_stats( struct slab_stats_t *p_stats );
+
+/*
+ * Prints the allocator statistics.
+ *
+ * Parameters:
+ *      p_stream: where to print (e.g. stdout).
+ */
+void slab_print_stats( FILE *p_stream );
+
+#endif
@@ -7,6 +7,7 @@
 #define _TREE_PRIVATE_H
 
 #include "tree.h"
+#include "entry.h"
 
 /*
  * Tree structure.
@@ -14,38 +15,229 @@
  * Members:
  *      p_root: First node.
  *      size: Number of nodes on the gp_TREE.
+ *      type: Tree type (TREE_BST, TREE_AVL, TREE_ART, TREE_BPLUS or TREE_COW).
+ *      p_index: Hash index of the nodes by key (trees created with TREE_HASH_INDEX); NULL if there is none.
+ *      p_art_root: Root of a TREE_ART tree (see tree_art-private.h).
+ *      p_bpt_root: Root of a TREE_BPLUS tree (see tree_bptree-private.h).
+ *      p_cow: State of a TREE_COW tree (see tree_cow-private.h).
+ *
+ * p_root and p_index are only used by the node_t engines (see TREE_USES_NODES).
  */
 struct tree_t
 {
     struct node_t* p_root;
     size_t size;
+    int type;
+    struct tree_index_t* p_index;
+    struct art_node_t* p_art_root;
+    struct bpt_node_t* p_bpt_root;
+    struct tree_cow_t* p_cow;
 };
 
+/*
+ * Whether a tree type keeps its entries on node_t nodes (TREE_BST and TREE_AVL).
+ */
+#define TREE_USES_NODES( type ) ((type) == TREE_BST || (type) == TREE_AVL)
+
+// Keys (including the '\0') and values up to these sizes are stored inside the node.
+#define NODE_INLINE_KEY_SIZE 24
+#define NODE_INLINE_VALUE_SIZE 56
+
+// Deletes keep the path to the removed node on the stack for trees up to this height (any AVL tree).
+#define TREE_DEL_PATH_SIZE 64
+
 /*
  * Node structure.
  *
  * Members:
- *      p_entry: Entry kept by the node.
  *      p_left: Left child.
  *      p_right: Right child.
+ *      entry: Entry kept by the node. entry.key points to key_inline or to an out of line copy (always '\0'
+ *             terminated); entry.value always points to the value member.
+ *      key_inline: Storage for short keys.
+ *      height: Height of the subtree rooted at this node (leaf = 1).
+ *      size: Number of nodes on the subtree rooted at this node.
+ *      value: Short value, stored on value_inline (value.data always points to it).
+ *      value_inline: Storage for short values.
+ *
+ * entry.value points to value, or to a separate reference counted data_t for values bigger than
+ * NODE_INLINE_VALUE_SIZE, which tree_get shares (data_share) instead of copying.
+ *
+ * height and size are kept up to date by tree_put/tree_del on every tree type, so tree_height is O(1).
+ *
+ * The members used by the descent loops (children, cached key prefix and size, and a short key) are on the first
+ * 64 bytes, so a lookup touches one cache line per level instead of chasing node -> entry -> key. Keys that differ
+ * on their first 8 bytes are told apart by entry.key_prefix alone (see entry_key_compare).
  */
 struct node_t
 {
-    struct entry_t* p_entry;
     struct node_t* p_left;
     struct node_t* p_right;
+    struct entry_t entry;
+    char key_inline[NODE_INLINE_KEY_SIZE];
+    int height;
+    size_t size;
+    struct data_t value;
+    char value_inline[NODE_INLINE_VALUE_SIZE];
 };
 
+/*
+ * Inorder iterator over the nodes of a tree.
+ *
+ * Members:
+ *      pp_stack: Nodes still to be visited (their left subtree was already visited).
+ *      top: Number of nodes on the stack.
+ *
+ * The stack is sized to the tree height, so the iterator is invalidated by any change to the tree.
+ */
+struct tree_iter_t
+{
+    struct node_t** pp_stack;
+    int top;
+};
+
+/*
+ * State of a tree_scan/tree_scan_prefix, shared by every tree type.
+ *
+ * Members:
+ *      p_end_key: Scan stops on the first key >= p_end_key; NULL for no end.
+ *      p_prefix: Scan stops on the first key without this prefix; NULL for no prefix.
+ *      prefix_len: Length of p_prefix.
+ *      limit: Maximum number of entries to visit (<= 0 for no limit).
+ *      count: Entries visited so far.
+ *      callback: User callback.
+ *      p_context: User callback context.
+ */
+struct tree_scan_t
+{
+    struct entry_t* p_end_key;
+    char* p_prefix;
+    size_t prefix_len;
+    int limit;
+    int count;
+    int (*callback)( struct entry_t* p_entry, void* p_context );
+    void* p_context;
+};
+
+/*
+ * Array being filled by tree_append_key/tree_append_value.
+ *
+ * Members:
+ *      pp_items: The array.
+ *      n_items: Items already added.
+ *      limit: Number of items to add.
+ *      p_keysizes: Where tree_append_key stores the size of each key (room for limit sizes); NULL if not needed.
+ */
+struct tree_append_t
+{
+    void** pp_items;
+    size_t n_items;
+    size_t limit;
+    size_t* p_keysizes;
+};
+
+/*
+ * Visits the entries from the first key >= p_start_key (NULL for the first key), in key order, passing each one to
+ * tree_scan_visit until it stops the scan.
+ *
+ * Returns:
+ *      Number of entries given to the user callback; -1 on error.
+ */
+int tree_scan_run( struct tree_t* p_tree, struct entry_t* p_start_key, struct tree_scan_t* p_scan );
+
+/*
+ * Checks the end key, prefix and limit of a scan, and calls the user callback.
+ *
+ * Parameters:
+ *      p_entry: Entry visited.
+ *      p_scan: struct tree_scan_t of the scan.
+ *
+ * Returns:
+ *      Non zero if the scan is over.
+ */
+int tree_scan_visit( struct entry_t* p_entry, void* p_scan );
+
+/*
+ * Ordered walk over the entries of a tree that doesn't use node_t (TREE_ART, TREE_BPLUS or TREE_COW): visits the
+ * entries from the first key >= p_start_key (NULL for the first key), skipping the first skip, until the callback
+ * returns non zero.
+ *
+ * Returns:
+ *      Non zero if the callback stopped the walk; 0 otherwise.
+ */
+int tree_engine_walk( struct tree_t* p_tree, struct entry_t* p_start_key, size_t skip,
+                      int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context );
+
+/*
+ * Lookup on a TREE_BST/TREE_AVL tree (through its hash index, if it has one) that may be changed by a writer while
+ * it runs, for reads validated afterwards with a sequence counter (see tree_shard.c). It only reads memory of the slab region (never unmapped) with bounded
+ * sizes and a bounded number of steps, so a torn read gives a wrong answer, never a fault; the caller throws the
+ * answer away unless no write ran meanwhile. Reads that can't be done that way (keys or nodes outside the slab, big
+ * values, which are shared instead of copied) are left to the caller, under the lock.
+ *
+ * Parameters:
+ *      p_key, keysize: Key to look for.
+ *      p_value: Buffer of NODE_INLINE_VALUE_SIZE bytes for a copy of the value.
+ *      p_value_size: Set to the size of the value.
+ *
+ * Returns:
+ *      1 if the key was found (its value copied to p_value), 0 if it isn't on the tree, -1 if the read must be
+ *      repeated under the lock.
+ */
+int tree_get_optimistic( struct tree_t* p_tree, char* p_key, size_t keysize, char* p_value, int* p_value_size );
+
+/*
+ * Compares a key with the key of a node that a writer may be changing or may already have freed, as done by
+ * tree_get_optimistic.
+ *
+ * Parameters:
+ *      p_compare: Set as entry_key_compare( p_key, &p_node->entry ).
+ *
+ * Returns:
+ *      0 (compared) or -1 if the node or its key isn't on the slab region.
+ */
+int node_key_compare_optimistic( struct node_t* p_node, struct entry_t* p_key, int* p_compare );
+
+/*
+ * Callbacks that append a copy of the key (its keysize bytes and a '\0') or of the value (data_share) to a struct
+ * tree_append_t.
+ *
+ * Returns:
+ *      Non zero once limit items were added.
+ */
+int tree_append_key( struct entry_t* p_entry, void* p_append );
+int tree_append_value( struct entry_t* p_entry, void* p_append );
+
 /*
  * Funcao que cria um novo node, alocando a memoria necessaria.
+ * A key e copiada para o node; o value e guardado como em node_set_value.
  *
  * Parameters:
- *      p_entry: Entry to be kept by the node.
+ *      p_key: Key to be kept by the node.
+ *      keysize: Number of bytes of the key.
+ *      p_value: Value to be kept by the node.
  *
  * Returns:
  *      Pointer to the new node. NULL on error.
  */
-struct node_t* node_create( struct entry_t* p_entry );
+struct node_t* node_create( char* p_key, size_t keysize, struct data_t* p_value );
+
+/*
+ * Copies a key to a node, replacing the previous one.
+ *
+ * Returns:
+ *      0 on success; -1 on error (the node keeps the previous key).
+ */
+int node_set_key( struct node_t* p_node, char* p_key, size_t keysize );
+
+/*
+ * Sets the value of a node, replacing the previous one. Small values are copied into the node; big ones are kept
+ * through a reference taken with data_share (a copy if p_value has refcount 0).
+ *
+ * Returns:
+ *      0 on success; -1 on error (the node keeps the previous value).
+ */
+int node_set_value( struct node_t* p_node, struct data_t* p_value );
 
 /*
  * Funcao que elimina um node, libertando toda a memória por ele ocupada.
@@ -59,51 +251,219 @@ void node_destroy( struct node_t* p_node );
 
 /*
  * Funcao que elimina um node e todos os filhos desse mesmo node, libertando toda a memória por eles ocupados.
+ * Iterativa: roda os filhos da esquerda para cima enquanto destroi, sem stack nem memoria extra.
  *
  * Parameters:
  *      p_node: Node (and children) to be destroyed.
  *
  */
-void node_destroy_recursive( struct node_t *p_node );
+void node_destroy_subtree( struct node_t *p_node );
+
+
+/*
+ * Funcao auxiliar para remover iterativamente um node de uma arvore BST/AVL. O caminho desde a raiz e guardado
+ * num array (na stack ate TREE_DEL_PATH_SIZE nodes, senao no heap) e atualizado/rebalanceado de baixo para cima.
+ * Um node com dois filhos e substituido pelo node da menor chave do ramo direito.
+ *
+ * Parameters:
+ *    p_tree: Arvore onde o node se encontra.
+ *    p_key: Entry com a chave do node a remover (ver entry_key_set).
+ *    hash: tree_index_hash da chave (so usado se a arvore tiver indice, de onde o node e removido depois de o
+ *          caminho estar alocado e o node encontrado).
+ *
+ * Returns:
+ *    0 (ok) ou -1 se a chave nao existir ou em caso de erro (a arvore e o indice ficam como estavam).
+ */
+int tree_del_node( struct tree_t* p_tree, struct entry_t* p_key, uint64_t hash );
 
+/*
+ * Funcao auxiliar de tree_put2/tree_put_take, que insere um par chave-valor numa arvore de qualquer tipo.
+ * A key e copiada para a arvore; o value e guardado com data_share (uma copia se tiver refcount 0).
+ *
+ * Returns:
+ *    0 (ok) ou -1 em caso de erro.
+ */
+int tree_put_value( struct tree_t* p_tree, char* p_key, size_t keysize, struct data_t* p_value );
 
 /*
- * Obtem a altura de uma 'arvore recursivamente.
+ * Funcao auxiliar para inserir iterativamente um par chave-valor numa arvore sem balanceamento.
+ * A key e copiada para a arvore; o value e guardado como em node_set_value.
  *
  * Parameters:
- *     p_node: Root da arvore.
+ *    p_tree: Arvore onde o node vai ser inserido.
+ *    p_key: Entry com a chave a inserir (ver entry_key_set).
+ *    p_value: Dados a inserir.
+ *    pp_new_node: Colocado com o novo node, se a chave ainda nao existia.
+ *
+ * Returns:
+ *    0 (ok) ou -1 em caso de erro.
  */
-int tree_height_recursive( struct node_t* p_node );
+int tree_put_node_bst( struct tree_t* p_tree, struct entry_t* p_key, struct data_t* p_value,
+                       struct node_t** pp_new_node );
 
 /*
- * Funcao auxiliar para remover um node de uma arvore.
+ * Funcao auxiliar para inserir recursivamente um par chave-valor numa arvore AVL.
+ * A key e copiada para a arvore; o value e guardado como em node_set_value.
  *
  * Parameters:
- *    p_tree: Arvore onde o node se encontra.
- *    p_node: Node a remover.
- *    p_key: Chave do node a remover.
+ *    p_tree: Arvore onde o node vai ser inserido.
+ *    p_node: Raiz da subarvore onde inserir.
+ *    p_key: Entry com a chave a inserir (ver entry_key_set).
+ *    p_value: Dados a inserir.
+ *    pp_new_node: Colocado com o novo node, se a chave ainda nao existia.
+ *    p_result: Colocado a -1 se nao foi possivel criar o novo node.
+ *
+ * Returns:
+ *    Nova raiz da subarvore, depois de rebalanceada.
  */
-struct node_t* tree_del_node( struct tree_t* p_tree, struct node_t* p_node, char* p_key );
+struct node_t* tree_put_node_avl( struct tree_t* p_tree, struct node_t* p_node, struct entry_t* p_key,
+                                  struct data_t* p_value, struct node_t** pp_new_node, int* p_result );
 
+/*
+ * Obtem a altura guardada num node (0 para NULL).
+ *
+ * Parameters:
+ *    p_node: Node a consultar.
+ */
+int node_height( struct node_t* p_node );
 
 /*
- * Percorre a 'arvore inorder e insere as chaves dos nodes num array.
+ * Obtem o numero de nodes guardado num node (0 para NULL).
  *
  * Parameters:
- *  p_node: Node a partir do qual se inicia a percorrer a arvore.
- *  pp_keys: Array onde se vao inserir as chaves.
- *  p_index: Indice do array onde se vai inserir a proxima chave.
+ *    p_node: Node a consultar.
  */
-void inorder_append_keys( struct node_t *p_node, char **pp_keys, int *p_index );
+size_t node_size( struct node_t* p_node );
 
 /*
- * Percorre a 'arvore inorder e insere os valores dos nodes num array.
+ * Recalcula a altura e o numero de nodes de um node a partir dos filhos.
  *
  * Parameters:
- *      p_node: Node a partir do qual se inicia a percorrer a arvore.
- *      pp_values: Array onde se vao inserir os valores.
- *      p_index: Indice do array onde se vai inserir o proximo valor.
+ *    p_node: Node a atualizar.
+ */
+void node_update( struct node_t* p_node );
+
+/*
+ * Rotacoes simples usadas no balanceamento AVL.
+ *
+ * Parameters:
+ *    p_node: Raiz da subarvore a rodar.
+ *
+ * Returns:
+ *    Nova raiz da subarvore.
+ */
+struct node_t* node_rotate_left( struct node_t* p_node );
+struct node_t* node_rotate_right( struct node_t* p_node );
+
+/*
+ * Entrada de um batch (tree_put_batch/tree_del_batch), com a sua posicao no batch.
+ *
+ * Members:
+ *      p_entry: Entrada do batch.
+ *      position: Indice da entrada no array recebido.
+ */
+struct tree_batch_item_t
+{
+    struct entry_t* p_entry;
+    int position;
+};
+
+/*
+ * Ordena as entradas de um batch pela key e, para a mesma key, pela posicao no batch.
+ *
+ * Returns:
+ *    Array de n items ordenados (libertado com free); NULL em caso de erro.
+ */
+struct tree_batch_item_t* tree_batch_sort( struct entry_t** pp_entries, int n );
+
+/*
+ * Funcao auxiliar de tree_bulk_load para arvores BST/AVL: cria os nodes das entradas (ordenadas) e liga-os com
+ * node_build_balanced.
+ *
+ * Returns:
+ *    0 (ok) ou -1 em caso de erro (a arvore fica vazia).
+ */
+int tree_bulk_load_nodes( struct tree_t* p_tree, struct entry_t** pp_entries, int n );
+
+/*
+ * Liga n nodes ordenados numa arvore perfeitamente balanceada (tambem AVL), com o node do meio na raiz.
+ *
+ * Parameters:
+ *    pp_nodes: Nodes por ordem das chaves.
+ *    n: Numero de nodes.
+ *
+ * Returns:
+ *    Raiz da arvore; NULL se n for 0.
+ */
+struct node_t* node_build_balanced( struct node_t** pp_nodes, size_t n );
+
+/*
+ * Atualiza a altura e o tamanho de um node e, numa arvore AVL, aplica as rotacoes necessarias para repor o
+ * balanceamento.
+ *
+ * Parameters:
+ *    p_tree: Arvore a que o node pertence.
+ *    p_node: Raiz da subarvore a balancear.
+ *
+ * Returns:
+ *    Nova raiz da subarvore.
+ */
+struct node_t* node_rebalance( struct tree_t* p_tree, struct node_t* p_node );
+
+
+/*
+ * Percorre inorder os nodes de uma arvore BST/AVL com um tree_iter_t (sem recursao), ate o callback devolver
+ * diferente de 0.
+ *
+ * Parameters:
+ *      p_tree: Arvore a percorrer.
+ *      callback: Chamado com a entry de cada node.
+ *      p_context: Contexto do callback.
+ *
+ * Returns:
+ *      Diferente de 0 se o callback parou a travessia; 0 se chegou ao fim; -1 em caso de erro.
+ */
+int tree_node_walk( struct tree_t* p_tree, int (*callback)( struct entry_t* p_entry, void* p_context ),
+                    void* p_context );
+
+/*
+ * Initializes an iterator positioned on the node with the given index (inorder, starting at 0). Uses the subtree
+ * sizes kept on the nodes, so positioning costs O(height).
+ *
+ * Parameters:
+ *      p_iter: Iterator to initialize.
+ *      p_tree: Tree to iterate.
+ *      index: Index of the first node returned by tree_iter_next.
+ *
+ * Returns:
+ *      0 on success; -1 on error. An index out of bounds gives an iterator with no nodes.
+ */
+int tree_iter_init_at( struct tree_iter_t* p_iter, struct tree_t* p_tree, size_t index );
+
+/*
+ * Initializes an iterator positioned on the first node with a key greater or equal to the given key.
+ *
+ * Parameters:
+ *      p_iter: Iterator to initialize.
+ *      p_tree: Tree to iterate.
+ *      p_key: Key to seek (set with entry_key_set). NULL positions the iterator on the first node.
+ *
+ * Returns:
+ *      0 on success; -1 on error.
+ */
+int tree_iter_init_from_key( struct tree_iter_t* p_iter, struct tree_t* p_tree, struct entry_t* p_key );
+
+/*
+ * Gets the next node of the iterator.
+ *
+ * Returns:
+ *      Next node in order; NULL when there are no more nodes.
+ */
+struct node_t* tree_iter_next( struct tree_iter_t* p_iter );
+
+/*
+ * Frees the memory used by an iterator.
  */
-void inorder_append_values( struct node_t *p_node, void **pp_values, int *p_index );
+void tree_iter_destroy( struct tree_iter_t* p_iter );
 
 #endif
\ No newline at end of file
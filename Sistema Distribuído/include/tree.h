@@ -1,15 +1,44 @@
 #ifndef _TREE_H
 #define _TREE_H /* Módulo gp_TREE */
 
+#include <stddef.h>
+
 #include "data.h"
 
 struct tree_t; /* A definir pelo grupo em gp_TREE-private.h */
+struct entry_t;
+
+/* Tipos de árvore suportados por tree_create2().
+ */
+#define TREE_BST 0 /* Árvore binária de pesquisa sem balanceamento */
+#define TREE_AVL 1 /* Árvore AVL, altura mantida em O(log n) */
+#define TREE_ART 2 /* Adaptive radix tree, com compressão de caminhos */
+#define TREE_BPLUS 3 /* B+tree, entradas em arrays contíguos nas folhas */
+#define TREE_COW 4 /* Árvore AVL copy-on-write: as leituras não usam locks */
+
+/* Opção que pode ser combinada com o tipo (ex: TREE_AVL | TREE_HASH_INDEX):
+ * mantém também um índice de hash das keys, usado por tree_get (e pela
+ * procura da key em tree_put/tree_del) em O(1). As restantes operações
+ * continuam a usar a árvore ordenada. Não disponível para TREE_ART, TREE_BPLUS nem TREE_COW.
+ */
+#define TREE_HASH_INDEX 0x100
 
 /* Função para criar uma nova árvore gp_TREE vazia.
  * Em caso de erro retorna NULL.
  */
 struct tree_t* tree_create();
 
+/* Função para criar uma nova árvore gp_TREE vazia do tipo indicado
+ * (TREE_BST, TREE_AVL, TREE_ART, TREE_BPLUS ou TREE_COW). O contrato das restantes funções é o
+ * mesmo para qualquer tipo de árvore.
+ * Numa árvore TREE_COW as escritas (uma de cada vez) publicam uma nova versão
+ * da árvore sem alterar a anterior, pelo que as funções de leitura podem ser
+ * chamadas por várias threads ao mesmo tempo que uma escrita, sem locks: cada
+ * leitura vê a árvore inteira antes ou depois de cada escrita.
+ * Em caso de erro retorna NULL.
+ */
+struct tree_t* tree_create2( int type );
+
 /* Função para libertar toda a memória ocupada por uma árvore.
  */
 void tree_destroy( struct tree_t* tree );
@@ -24,6 +53,47 @@ void tree_destroy( struct tree_t* tree );
  */
 int tree_put( struct tree_t* tree, char* key, struct data_t* value );
 
+/* Função igual a tree_put, para chaves binárias com keysize bytes (que
+ * podem conter '\0'). As chaves são ordenadas byte a byte (memcmp), e
+ * uma chave que é prefixo de outra fica antes dela.
+ */
+int tree_put2( struct tree_t* tree, char* key, size_t keysize, struct data_t* value );
+
+/* Função igual a tree_put2, mas que fica com a referência do chamador
+ * para value (criado por data_create/data_create2, refcount > 0) em vez
+ * de copiar os dados: o chamador não pode voltar a usar value depois da
+ * chamada, mesmo em caso de erro. A key continua a ser copiada.
+ */
+int tree_put_take( struct tree_t* tree, char* key, size_t keysize, struct data_t* value );
+
+/* Função para carregar uma árvore vazia com n entradas ordenadas por
+ * ordem estritamente crescente da key (ver tree_put2), numa só passagem
+ * O(n): as árvores BST/AVL ficam perfeitamente balanceadas e a B+tree
+ * com as folhas cheias. As keys são copiadas e os values partilhados
+ * com data_share (não devem ser alterados depois).
+ * Retorna 0 (ok) ou -1 em caso de erro (árvore não vazia, entradas fora
+ * de ordem ou falta de memória), sem alterar a árvore.
+ * No servidor (rtree_bulk_load) a carga é assíncrona: uma carga rejeitada
+ * conta como executada e verify devolve -2 para ela.
+ */
+int tree_bulk_load( struct tree_t* tree, struct entry_t** entries, int n );
+
+/* Função para adicionar ou substituir n entradas de uma só vez. As
+ * entradas são ordenadas pela key e aplicadas por essa ordem; se a mesma
+ * key aparece mais do que uma vez, fica o value da última. As keys são
+ * copiadas e os values partilhados com data_share, como em
+ * tree_bulk_load.
+ * Retorna 0 (ok) ou -1 em caso de erro (as entradas sem erro são na
+ * mesma aplicadas).
+ */
+int tree_put_batch( struct tree_t* tree, struct entry_t** entries, int n );
+
+/* Função para remover de uma só vez as keys de n entradas (os values
+ * são ignorados), pela ordem das keys.
+ * Retorna o número de keys removidas ou -1 em caso de erro.
+ */
+int tree_del_batch( struct tree_t* tree, struct entry_t** keys, int n );
+
 /* Função para obter da árvore o valor associado à chave key.
  * A função deve devolver uma cópia dos dados que terão de ser
  * libertados no contexto da função que chamou tree_get, ou seja, a
@@ -34,12 +104,20 @@ int tree_put( struct tree_t* tree, char* key, struct data_t* value );
  */
 struct data_t* tree_get( struct tree_t* tree, char* key );
 
+/* Função igual a tree_get, para chaves binárias com keysize bytes.
+ */
+struct data_t* tree_get2( struct tree_t* tree, char* key, size_t keysize );
+
 /* Função para remover um elemento da árvore, indicado pela chave key,
  * libertando toda a memória alocada na respetiva operação tree_put.
  * Retorna 0 (ok) ou -1 (key not found).
  */
 int tree_del( struct tree_t* tree, char* key );
 
+/* Função igual a tree_del, para chaves binárias com keysize bytes.
+ */
+int tree_del2( struct tree_t* tree, char* key, size_t keysize );
+
 /* Função que devolve o número de elementos contidos na árvore.
  */
 int tree_size( struct tree_t* tree );
@@ -61,6 +139,77 @@ char** tree_get_keys( struct tree_t* tree );
 void** tree_get_values( struct tree_t* tree );
 
 
+/* Função que devolve uma cópia da key que ocupa a posição index na
+ * ordenação lexicográfica das keys da árvore (a primeira key tem index 0).
+ * A memória devolvida deve ser libertada por quem chamou a função.
+ * Devolve NULL se index estiver fora dos limites ou em caso de erro.
+ */
+char* tree_get_key_at( struct tree_t* tree, int index );
+
+/* Função igual a tree_get_key_at, para keys binárias: coloca em keysize
+ * (se não for NULL) o tamanho da key. A cópia tem um '\0' depois dos
+ * keysize bytes.
+ */
+char* tree_get_key_at2( struct tree_t* tree, int index, size_t* keysize );
+
+/* Função que devolve o número de keys da árvore lexicograficamente
+ * menores que key, ou seja, a posição que key ocupa (ou ocuparia) na
+ * ordenação das keys. A key não precisa de existir na árvore.
+ * Retorna -1 em caso de erro.
+ */
+int tree_get_rank( struct tree_t* tree, char* key );
+
+/* Função igual a tree_get_rank, mas com o tamanho da key (que pode ser
+ * binária, ver tree_put2).
+ */
+int tree_get_rank2( struct tree_t* tree, char* key, size_t keysize );
+
+/* Função que devolve um array de char* com a cópia das keys nas
+ * posições [offset, offset + limit) da ordenação lexicográfica,
+ * colocando o último elemento do array com o valor NULL.
+ * O array deve ser libertado com tree_free_keys().
+ * Devolve NULL em caso de erro.
+ */
+char** tree_get_keys_page( struct tree_t* tree, int offset, int limit );
+
+/* Função igual a tree_get_keys_page, que guarda também em keysizes (se
+ * não for NULL, com espaço para limit tamanhos) o tamanho de cada key.
+ * Cada cópia tem um '\0' depois dos keysize bytes.
+ */
+char** tree_get_keys_page2( struct tree_t* tree, int offset, int limit, size_t* keysizes );
+
+/* Função que percorre, por ordem lexicográfica, as entradas da árvore
+ * com key em [start_key, end_key), chamando callback(entry, context)
+ * para cada uma. start_key a NULL começa na primeira key, end_key a NULL
+ * vai até à última e limit <= 0 não limita o número de entradas.
+ * As entradas passadas a callback pertencem à árvore e não podem ser
+ * alteradas nem libertadas. Se callback devolver um valor diferente de 0
+ * o percurso termina.
+ * Retorna o número de entradas percorridas ou -1 em caso de erro.
+ */
+int tree_scan( struct tree_t* tree, char* start_key, char* end_key, int limit,
+               int (*callback)( struct entry_t* entry, void* context ), void* context );
+
+/* Função igual a tree_scan, mas com o tamanho de start_key e end_key
+ * (que podem ser binárias).
+ */
+int tree_scan2( struct tree_t* tree, char* start_key, size_t start_keysize, char* end_key, size_t end_keysize,
+                int limit, int (*callback)( struct entry_t* entry, void* context ), void* context );
+
+/* Função semelhante a tree_scan(), mas que percorre as entradas cuja
+ * key começa por prefix. O percurso começa na primeira key >= prefix e
+ * termina na primeira key que não tem o prefixo.
+ * Retorna o número de entradas percorridas ou -1 em caso de erro.
+ */
+int tree_scan_prefix( struct tree_t* tree, char* prefix, int limit,
+                      int (*callback)( struct entry_t* entry, void* context ), void* context );
+
+/* Função igual a tree_scan_prefix, mas com o tamanho de prefix (que pode
+ * ser binário).
+ */
+int tree_scan_prefix2( struct tree_t* tree, char* prefix, size_t prefixsize, int limit,
+                       int (*callback)( struct entry_t* entry, void* context ), void* context );
+
 /* Função que liberta toda a memória alocada por tree_get_keys().
  */
 void tree_free_keys( char** keys );
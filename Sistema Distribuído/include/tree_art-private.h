@@ -0,0 +1,166 @@
+// Grupo 55
+// Jose Alves nº 44898
+// Gustavo Jardim nº 48483
+// Henrique Lopes nº 52840
+
+#ifndef _TREE_ART_PRIVATE_H
+#define _TREE_ART_PRIVATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "entry.h"
+
+/*
+ * Adaptive radix tree (ART) engine, used by trees created with TREE_ART.
+ *
+ * Inner nodes branch on one key byte and come in four sizes (4, 16, 48 and 256 children) that grow and shrink with
+ * the number of children. Runs of bytes shared by every key below a node are stored once on the node (path
+ * compression): only the first ART_MAX_PREFIX_LEN bytes are kept, longer prefixes are read from any leaf below the
+ * node when they must be compared. Lookups only check the stored bytes and compare the whole key on the leaf.
+ *
+ * Keys may be prefixes of each other (binary keys can't use a terminator byte): the key that ends at a node is kept
+ * on its p_end_leaf, which comes before all children in key order.
+ *
+ * Every inner node keeps the number of keys below it, so rank/select are O(key length) like on the AVL tree.
+ *
+ * Leaves are tagged pointers (lowest bit set) stored in the children arrays.
+ */
+
+#define ART_NODE4 1
+#define ART_NODE16 2
+#define ART_NODE48 3
+#define ART_NODE256 4
+
+#define ART_MAX_PREFIX_LEN 10
+
+#define ART_IS_LEAF( p_node ) ((uintptr_t)(p_node) & 1)
+#define ART_LEAF( p_node ) ((struct art_leaf_t*)((uintptr_t)(p_node) & ~(uintptr_t)1))
+#define ART_TAG_LEAF( p_leaf ) ((struct art_node_t*)((uintptr_t)(p_leaf) | 1))
+
+/*
+ * Leaf. Holds a copy of the key (after the structure, '\0' terminated); entry.value is a reference counted copy of
+ * the value (see data_share).
+ */
+struct art_leaf_t
+{
+    struct entry_t entry;
+    char key[];
+};
+
+/*
+ * Header shared by every inner node.
+ *
+ * Members:
+ *      type: ART_NODE4, ART_NODE16, ART_NODE48 or ART_NODE256.
+ *      n_children: Number of children.
+ *      prefix_len: Length of the compressed path (may be bigger than ART_MAX_PREFIX_LEN).
+ *      size: Number of keys below the node (including p_end_leaf).
+ *      p_end_leaf: Leaf of the key that ends at this node; NULL if there is none.
+ *      prefix: First bytes of the compressed path.
+ */
+struct art_node_t
+{
+    uint8_t type;
+    uint16_t n_children;
+    uint32_t prefix_len;
+    size_t size;
+    struct art_leaf_t* p_end_leaf;
+    unsigned char prefix[ART_MAX_PREFIX_LEN];
+};
+
+// Sorted keys, children at the same position.
+struct art_node4_t
+{
+    struct art_node_t header;
+    unsigned char keys[4];
+    struct art_node_t* p_children[4];
+};
+
+struct art_node16_t
+{
+    struct art_node_t header;
+    unsigned char keys[16];
+    struct art_node_t* p_children[16];
+};
+
+// child_index[byte] is the position + 1 of the child on p_children (0 means no child).
+struct art_node48_t
+{
+    struct art_node_t header;
+    unsigned char child_index[256];
+    struct art_node_t* p_children[48];
+};
+
+struct art_node256_t
+{
+    struct art_node_t header;
+    struct art_node_t* p_children[256];
+};
+
+struct tree_t;
+
+/*
+ * Frees a node (or leaf) and everything below it.
+ */
+void tree_art_destroy( struct art_node_t* p_node );
+
+/*
+ * Adds or replaces a key. The key is copied; the tree keeps a reference to the value taken with data_share (a
+ * copy if its refcount is 0).
+ *
+ * Parameters:
+ *      p_tree: Tree (TREE_ART).
+ *      p_key: Entry with the key (see entry_key_set).
+ *      p_value: Value.
+ *
+ * Returns:
+ *      0 (ok) or -1 on error.
+ */
+int tree_art_put( struct tree_t* p_tree, struct entry_t* p_key, struct data_t* p_value );
+
+/*
+ * Finds a key.
+ *
+ * Returns:
+ *      The entry kept by the tree (not a copy); NULL if the key isn't on the tree.
+ */
+struct entry_t* tree_art_find( struct tree_t* p_tree, struct entry_t* p_key );
+
+/*
+ * Removes a key.
+ *
+ * Returns:
+ *      0 (ok) or -1 if the key isn't on the tree.
+ */
+int tree_art_del( struct tree_t* p_tree, struct entry_t* p_key );
+
+/*
+ * Height of a node, counting the leaves (O(number of inner nodes)).
+ */
+int tree_art_height( struct art_node_t* p_node );
+
+/*
+ * Entry at a position of the key order.
+ *
+ * Returns:
+ *      The entry kept by the tree (not a copy); NULL if index is out of bounds.
+ */
+struct entry_t* tree_art_entry_at( struct tree_t* p_tree, size_t index );
+
+/*
+ * Number of keys smaller than a key.
+ */
+size_t tree_art_rank( struct tree_t* p_tree, struct entry_t* p_key );
+
+/*
+ * Visits the entries in key order, starting on the first key >= p_start_key (NULL for the first key) and skipping
+ * the first skip entries from there, until the callback returns non zero.
+ *
+ * Returns:
+ *      Non zero if the callback stopped the walk; 0 otherwise.
+ */
+int tree_art_walk( struct tree_t* p_tree, struct entry_t* p_start_key, size_t skip,
+                   int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context );
+
+#endif
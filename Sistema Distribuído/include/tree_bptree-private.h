@@ -0,0 +1,151 @@
+// Grupo 55
+// Jose Alves nº 44898
+// Gustavo Jardim nº 48483
+// Henrique Lopes nº 52840
+
+#ifndef _TREE_BPTREE_PRIVATE_H
+#define _TREE_BPTREE_PRIVATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "entry.h"
+#include "data.h"
+
+/*
+ * B+tree engine, used by trees created with TREE_BPLUS.
+ *
+ * Entries only live on the leaves, in a sorted array; the leaves are linked in key order, so full walks are
+ * sequential sweeps over the leaf arrays. Inner nodes keep a sorted array of separator keys (copies owned by the
+ * node) and, for each child, the number of entries below it, so rank/select cost O(height * BPT_INNER_SLOTS) with
+ * no extra pointer chasing.
+ *
+ * Searches inside a node don't follow the key pointers: every node knows the prefix shared by all its keys
+ * (prefix_len bytes, read from its first key) and keeps, in a contiguous heads array, the 8 bytes that follow it on
+ * each key (see entry_key_prefix). The search key is checked against the node prefix once, and then the binary
+ * search runs on the heads; only keys with the same head as the search key are compared in full.
+ *
+ * Node sizes are fixed: a leaf holds up to BPT_LEAF_SLOTS entries and an inner node up to BPT_INNER_SLOTS children.
+ * Nodes other than the root are kept at least half full, except when the copy of a new separator key can't be
+ * allocated while deleting: the node is then left underfull, which is still a valid tree.
+ */
+
+#define BPT_LEAF_SLOTS 32
+#define BPT_INNER_SLOTS 32
+
+/*
+ * Header shared by both node types.
+ *
+ * Members:
+ *      is_leaf: 1 for leaves, 0 for inner nodes.
+ *      n: Number of entries (leaves) or of separator keys (inner nodes, which have n + 1 children).
+ *      prefix_len: Length of the prefix shared by all the keys of the node.
+ */
+struct bpt_node_t
+{
+    int is_leaf;
+    int n;
+    size_t prefix_len;
+};
+
+/*
+ * Leaf. entries[i].key is a copy owned by the leaf and entries[i].value a reference counted copy of the value (see
+ * data_share). heads[i] is the head of entries[i].key after the node prefix.
+ */
+struct bpt_leaf_t
+{
+    struct bpt_node_t header;
+    struct bpt_leaf_t* p_next;
+    uint64_t heads[BPT_LEAF_SLOTS];
+    struct entry_t entries[BPT_LEAF_SLOTS];
+};
+
+/*
+ * Inner node. Child i holds the keys k with keys[i - 1] <= k < keys[i]; counts[i] is its number of entries.
+ * heads[i] is the head of keys[i].key after the node prefix.
+ */
+struct bpt_inner_t
+{
+    struct bpt_node_t header;
+    uint64_t heads[BPT_INNER_SLOTS - 1];
+    struct entry_t keys[BPT_INNER_SLOTS - 1];
+    size_t counts[BPT_INNER_SLOTS];
+    struct bpt_node_t* p_children[BPT_INNER_SLOTS];
+};
+
+struct tree_t;
+
+/*
+ * Frees a node and everything below it.
+ */
+void tree_bpt_destroy( struct bpt_node_t* p_node );
+
+/*
+ * Adds or replaces a key. The key is copied; the tree keeps a reference to the value taken with data_share (a
+ * copy if its refcount is 0).
+ *
+ * Parameters:
+ *      p_tree: Tree (TREE_BPLUS).
+ *      p_key: Entry with the key (see entry_key_set).
+ *      p_value: Value.
+ *
+ * Returns:
+ *      0 (ok) or -1 on error.
+ */
+int tree_bpt_put( struct tree_t* p_tree, struct entry_t* p_key, struct data_t* p_value );
+
+/*
+ * Builds the tree from n entries in strictly ascending key order, on an empty tree, bottom-up: the entries are
+ * spread evenly over the fewest leaves that hold them, and each level of inner nodes the same way over the level
+ * below. Keys are copied and values shared (data_share).
+ *
+ * Returns:
+ *      0 (ok) or -1 on error (the tree is left empty).
+ */
+int tree_bpt_bulk_load( struct tree_t* p_tree, struct entry_t** pp_entries, int n );
+
+/*
+ * Finds a key.
+ *
+ * Returns:
+ *      The entry kept by the tree (not a copy); NULL if the key isn't on the tree.
+ */
+struct entry_t* tree_bpt_find( struct tree_t* p_tree, struct entry_t* p_key );
+
+/*
+ * Removes a key.
+ *
+ * Returns:
+ *      0 (ok) or -1 if the key isn't on the tree.
+ */
+int tree_bpt_del( struct tree_t* p_tree, struct entry_t* p_key );
+
+/*
+ * Number of levels of the tree, counting the leaves.
+ */
+int tree_bpt_height( struct tree_t* p_tree );
+
+/*
+ * Entry at a position of the key order.
+ *
+ * Returns:
+ *      The entry kept by the tree (not a copy); NULL if index is out of bounds.
+ */
+struct entry_t* tree_bpt_entry_at( struct tree_t* p_tree, size_t index );
+
+/*
+ * Number of keys smaller than a key.
+ */
+size_t tree_bpt_rank( struct tree_t* p_tree, struct entry_t* p_key );
+
+/*
+ * Visits the entries in key order, starting on the first key >= p_start_key (NULL for the first key) and skipping
+ * the first skip entries from there, until the callback returns non zero.
+ *
+ * Returns:
+ *      Non zero if the callback stopped the walk; 0 otherwise.
+ */
+int tree_bpt_walk( struct tree_t* p_tree, struct entry_t* p_start_key, size_t skip,
+                   int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context );
+
+#endif
@@ -0,0 +1,212 @@
+// Grupo 55
+// Jose Alves nº 44898
+// Gustavo Jardim nº 48483
+// Henrique Lopes nº 52840
+
+#ifndef _TREE_COW_PRIVATE_H
+#define _TREE_COW_PRIVATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "entry.h"
+
+/*
+ * Copy-on-write (persistent) AVL tree engine, used by trees created with TREE_COW.
+ *
+ * Published nodes are never changed. A write copies the nodes on its path (and the ones its rotations move), links
+ * the copies into a new version of the tree and publishes the new root with one atomic store, so readers always walk
+ * a complete, immutable snapshot: they don't take any lock and never wait for the writer. Writes still need the
+ * caller to run one at a time.
+ *
+ * Leaves hold the entries (key and value) and are shared by every version of the tree until their key is replaced
+ * or removed; nodes only hold the links, the subtree size (for rank/select) and the height.
+ *
+ * Replaced nodes and leaves are retired, not freed: a reader that loaded an older root may still be walking them.
+ * Epoch based reclamation decides when they can go. Readers announce themselves on the counter of the current epoch
+ * (tree_cow_enter / tree_cow_exit); the writer frees what was retired two epochs ago once no reader of the previous
+ * epoch is left, and then moves to the next epoch.
+ */
+
+// Largest height handled by the walks (an AVL tree that tall would have more than 2^43 keys).
+#define TREE_COW_MAX_HEIGHT 64
+
+// Most nodes a single write can copy: its path, the sibling path of a removal and the nodes moved by the rotations.
+#define TREE_COW_MAX_WRITE_NODES (4 * (TREE_COW_MAX_HEIGHT + 2))
+
+#define COW_IS_LEAF( p_item ) ((uintptr_t)(p_item) & 1)
+#define COW_LEAF( p_item ) ((struct cow_leaf_t*)((uintptr_t)(p_item) & ~(uintptr_t)1))
+#define COW_TAG_LEAF( p_leaf ) ((void*)((uintptr_t)(p_leaf) | 1))
+
+/*
+ * Leaf. Holds a copy of the key (after the structure, '\0' terminated); entry.value is a reference counted copy of
+ * the value (see data_share). Never changed once published.
+ */
+struct cow_leaf_t
+{
+    struct entry_t entry;
+    char key[];
+};
+
+/*
+ * Node.
+ *
+ * Members:
+ *      p_left, p_right: Children.
+ *      p_leaf: Entry of the node.
+ *      size: Number of nodes of the subtree.
+ *      height: Height of the subtree (1 for a node without children).
+ *      version: Write that created the node. Only that write may change it, before it publishes.
+ */
+struct cow_node_t
+{
+    struct cow_node_t* p_left;
+    struct cow_node_t* p_right;
+    struct cow_leaf_t* p_leaf;
+    size_t size;
+    int height;
+    unsigned long version;
+};
+
+/*
+ * Nodes and leaves retired on one epoch (leaves tagged with COW_TAG_LEAF).
+ */
+struct cow_garbage_t
+{
+    void** pp_items;
+    size_t n_items;
+    size_t capacity;
+};
+
+/*
+ * State of a TREE_COW tree.
+ *
+ * Members:
+ *      p_root: Published root; read with an atomic load.
+ *      version: Number of the last write.
+ *      epoch: Current epoch.
+ *      readers: Readers inside epochs of each parity.
+ *      garbage: What was retired on the epochs of each parity.
+ */
+struct tree_cow_t
+{
+    struct cow_node_t* p_root;
+    unsigned long version;
+    unsigned long epoch;
+    long readers[2];
+    struct cow_garbage_t garbage[2];
+};
+
+struct tree_t;
+
+/*
+ * Creates the state of an empty tree.
+ *
+ * Returns:
+ *      The state; NULL on error.
+ */
+struct tree_cow_t* tree_cow_create();
+
+/*
+ * Frees the tree, with everything still retired. There can't be readers.
+ */
+void tree_cow_destroy( struct tree_cow_t* p_cow );
+
+/*
+ * Starts a read: until tree_cow_exit, nothing reachable from a root loaded after this call is freed.
+ *
+ * Returns:
+ *      The epoch to give to tree_cow_exit.
+ */
+unsigned long tree_cow_enter( struct tree_cow_t* p_cow );
+
+/*
+ * Ends a read started by tree_cow_enter.
+ */
+void tree_cow_exit( struct tree_cow_t* p_cow, unsigned long epoch );
+
+/*
+ * Adds or replaces a key and publishes the new version. The key is copied; the tree keeps a reference to the value
+ * taken with data_share (a copy if its refcount is 0). Writes must not run concurrently.
+ *
+ * Parameters:
+ *      p_tree: Tree (TREE_COW).
+ *      p_key: Entry with the key (see entry_key_set).
+ *      p_value: Value.
+ *
+ * Returns:
+ *      0 (ok) or -1 on error (the tree is left unchanged).
+ */
+int tree_cow_put( struct tree_t* p_tree, struct entry_t* p_key, struct data_t* p_value );
+
+/*
+ * Removes a key and publishes the new version.
+ *
+ * Returns:
+ *      0 (ok) or -1 if the key isn't on the tree or there was no memory (the tree is left unchanged).
+ */
+int tree_cow_del( struct tree_t* p_tree, struct entry_t* p_key );
+
+/*
+ * Builds a perfectly balanced tree from n entries in strictly ascending key order, on an empty tree, and publishes
+ * it. Keys are copied and values shared (data_share).
+ *
+ * Returns:
+ *      0 (ok) or -1 on error (the tree is left empty).
+ */
+int tree_cow_bulk_load( struct tree_t* p_tree, struct entry_t** pp_entries, int n );
+
+/*
+ * The read functions below run on a snapshot: each enters an epoch, loads the root once and works on it. They can
+ * run concurrently with a write and with each other.
+ */
+
+/*
+ * Value of a key.
+ *
+ * Returns:
+ *      A reference to the value (data_share); an empty data_t (data_create2( 0, NULL )) if the key isn't on the tree.
+ */
+struct data_t* tree_cow_get( struct tree_t* p_tree, struct entry_t* p_key );
+
+/*
+ * Number of keys / number of levels.
+ */
+size_t tree_cow_size( struct tree_t* p_tree );
+int tree_cow_height( struct tree_t* p_tree );
+
+/*
+ * Copy of the key at a position of the key order, with its size on *p_keysize (if p_keysize isn't NULL).
+ *
+ * Returns:
+ *      The copy, terminated by a '\0' (free it); NULL if index is out of bounds or there was no memory.
+ */
+char* tree_cow_key_at( struct tree_t* p_tree, size_t index, size_t* p_keysize );
+
+/*
+ * Number of keys smaller than a key.
+ */
+size_t tree_cow_rank( struct tree_t* p_tree, struct entry_t* p_key );
+
+/*
+ * Visits the entries in key order, starting on the first key >= p_start_key (NULL for the first key) and skipping
+ * the first skip entries from there, until the callback returns non zero.
+ *
+ * Returns:
+ *      Non zero if the callback stopped the walk; 0 otherwise.
+ */
+int tree_cow_walk( struct tree_t* p_tree, struct entry_t* p_start_key, size_t skip,
+                   int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context );
+
+/*
+ * Builds the NULL terminated array of tree_get_keys, tree_get_values or tree_get_keys_page from one snapshot: the
+ * items from position offset on, at most limit of them, appended by append (see struct tree_append_t, which gets
+ * p_keysizes).
+ *
+ * Returns:
+ *      The array; NULL if there was no memory.
+ */
+void** tree_cow_collect( struct tree_t* p_tree, size_t offset, size_t limit,
+                         int (*append)( struct entry_t* p_entry, void* p_append ), size_t* p_keysizes );
+
+#endif
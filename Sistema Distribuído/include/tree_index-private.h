@@ -0,0 +1,139 @@
+// Grupo 55
+// Jose Alves nº 44898
+// Gustavo Jardim nº 48483
+// Henrique Lopes nº 52840
+
+#ifndef _TREE_INDEX_PRIVATE_H
+#define _TREE_INDEX_PRIVATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct node_t;
+struct entry_t;
+
+/*
+ * Open addressing (linear probing) hash index from keys to the nodes of a tree, used by trees created with
+ * TREE_HASH_INDEX so exact match lookups don't descend the tree.
+ *
+ * The index doesn't own anything: slots point at the tree nodes, which keep the keys. Removals use backward shift
+ * deletion, so there are no tombstones and lookups never scan past the first empty slot.
+ *
+ * The slot arrays replaced when the index grows are only freed with the index (together they are smaller than the
+ * current one), so tree_index_find_optimistic can run while the index changes.
+ */
+
+// Initial number of slots (power of 2) and maximum load factor (TREE_INDEX_LOAD_NUM / TREE_INDEX_LOAD_DEN).
+#define TREE_INDEX_INITIAL_CAPACITY 16
+#define TREE_INDEX_LOAD_NUM 3
+#define TREE_INDEX_LOAD_DEN 4
+
+// Most slot arrays an index can replace (each growth at least doubles the capacity).
+#define TREE_INDEX_MAX_OLD_SLOTS 64
+
+/*
+ * Index slot.
+ *
+ * Members:
+ *      hash: Hash of the key of the node (so probing compares keys only on a full hash match).
+ *      p_node: Indexed node; NULL if the slot is empty.
+ */
+struct tree_index_slot_t
+{
+    uint64_t hash;
+    struct node_t* p_node;
+};
+
+/*
+ * Hash index.
+ *
+ * Members:
+ *      p_slots: Slots array.
+ *      capacity: Number of slots (power of 2). Set after p_slots when the index grows, so p_slots has at least
+ *                capacity slots whenever capacity is read first.
+ *      count: Number of nodes indexed.
+ *      pp_old_slots: Slot arrays replaced by the growths.
+ *      n_old_slots: Number of arrays on pp_old_slots.
+ */
+struct tree_index_t
+{
+    struct tree_index_slot_t* p_slots;
+    size_t capacity;
+    size_t count;
+    struct tree_index_slot_t* pp_old_slots[TREE_INDEX_MAX_OLD_SLOTS];
+    int n_old_slots;
+};
+
+/*
+ * Creates an empty index.
+ *
+ * Returns:
+ *      The new index; NULL on error.
+ */
+struct tree_index_t* tree_index_create();
+
+/*
+ * Frees the index (not the nodes).
+ */
+void tree_index_destroy( struct tree_index_t* p_index );
+
+/*
+ * Hash of a key.
+ *
+ * Parameters:
+ *      p_key: Key bytes.
+ *      keysize: Number of bytes of the key.
+ */
+uint64_t tree_index_hash( const char* p_key, size_t keysize );
+
+/*
+ * Finds the node with a key.
+ *
+ * Parameters:
+ *      p_index: Index.
+ *      p_key: Entry with the key to find (see entry_key_set).
+ *      hash: tree_index_hash of the key.
+ *
+ * Returns:
+ *      The node; NULL if the key isn't indexed.
+ */
+struct node_t* tree_index_find( struct tree_index_t* p_index, struct entry_t* p_key, uint64_t hash );
+
+/*
+ * Same as tree_index_find, for tree_get_optimistic: the index may be changed by a writer while it runs (see
+ * node_key_compare_optimistic).
+ *
+ * Parameters:
+ *      pp_node: Set to the node found.
+ *
+ * Returns:
+ *      1 if the key was found, 0 if it isn't indexed, -1 if the lookup must be repeated under the lock.
+ */
+int tree_index_find_optimistic( struct tree_index_t* p_index, struct entry_t* p_key, uint64_t hash,
+                                struct node_t** pp_node );
+
+/*
+ * Grows the index, if needed, so it can hold count nodes. Called before changing the tree, so a later
+ * tree_index_insert can't fail.
+ *
+ * Returns:
+ *      0 on success; -1 on error.
+ */
+int tree_index_reserve( struct tree_index_t* p_index, size_t count );
+
+/*
+ * Adds a node (with a key not yet indexed). Room must have been reserved with tree_index_reserve.
+ */
+void tree_index_insert( struct tree_index_t* p_index, struct node_t* p_node, uint64_t hash );
+
+/*
+ * Removes a node.
+ *
+ * Parameters:
+ *      p_index: Index.
+ *      p_node: Node to remove.
+ *      hash: tree_index_hash of the key of the node.
+ */
+void tree_index_remove( struct tree_index_t* p_index, struct node_t* p_node, uint64_t hash );
+
+#endif
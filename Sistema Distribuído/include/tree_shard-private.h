@@ -0,0 +1,251 @@
+// Grupo 55
+// Jose Alves nº 44898
+// Gustavo Jardim nº 48483
+// Henrique Lopes nº 52840
+
+#ifndef _TREE_SHARD_PRIVATE_H
+#define _TREE_SHARD_PRIVATE_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "tree.h"
+
+struct entry_t;
+
+/*
+ * Sharded store used by the server: the keys are hash partitioned over n independent trees, each with its own lock,
+ * so writes (and reads) of keys on different shards don't wait for each other.
+ *
+ * Every function takes the locks it needs. Operations on one key lock only its shard. Operations over the whole store
+ * lock every shard, always in index order, and merge the shards in key order, so they see one consistent state and
+ * return the same as the tree.h function over a single tree (except tree_shards_height, see below).
+ *
+ * The locks are reader-writer locks: reads (gets, sizes, key listings, scans) share them and never wait for each
+ * other, only for writers. They prefer writers, so a steady stream of reads can't starve the writes.
+ *
+ * Stores of TREE_COW trees only lock for writing: the reads work on snapshots of the shards (entering an epoch on each
+ * shard they touch, see tree_cow-private.h) and never wait for the writers. A read over the whole store then sees each
+ * shard as it was at some point during the read, not every shard at the same instant.
+ *
+ * On TREE_BST/TREE_AVL stores, gets don't take the lock either unless they have to. Writers make the shard's sequence
+ * odd while they change the tree and even again when they are done; a get reads the sequence, looks the key up
+ * without the lock (tree_get_optimistic) and keeps the answer only if the sequence is the same, even, number
+ * afterwards. A get that overlaps a write (or that tree_get_optimistic can't do) is repeated under the read lock, so
+ * gets never write to shared memory unless they conflict.
+ */
+
+// Largest number of shards (the merges keep one cursor per shard on the stack).
+#define TREE_SHARDS_MAX 64
+
+// Size the shards are padded to, so the locks of neighbouring shards don't share a cache line.
+#define TREE_SHARDS_CACHE_LINE 64
+
+/*
+ * Shard.
+ *
+ * Members:
+ *      p_tree: The shard's tree.
+ *      lock: Protects p_tree: read locked by the reads, write locked by the writes (TREE_COW: only the writes).
+ *      sequence: Odd while a writer changes p_tree; changed only with lock write locked.
+ */
+struct tree_shard_t
+{
+    struct tree_t* p_tree;
+    pthread_rwlock_t lock;
+    unsigned long sequence;
+} __attribute__(( aligned( TREE_SHARDS_CACHE_LINE ) ));
+
+/*
+ * Sharded store.
+ *
+ * Members:
+ *      n_shards: Number of shards.
+ *      type: Type of the trees (see tree_create2).
+ *      p_shards: The shards.
+ */
+struct tree_shards_t
+{
+    int n_shards;
+    int type;
+    struct tree_shard_t* p_shards;
+};
+
+/*
+ * Creates a store with n_shards empty trees of the given type.
+ *
+ * Parameters:
+ *      n_shards: Number of shards, 1 to TREE_SHARDS_MAX.
+ *      type: Type of the trees (see tree_create2).
+ *
+ * Returns:
+ *      The new store; NULL on error.
+ */
+struct tree_shards_t* tree_shards_create( int n_shards, int type );
+
+/*
+ * Frees the store and every tree.
+ */
+void tree_shards_destroy( struct tree_shards_t* p_shards );
+
+/*
+ * Shard of a key.
+ *
+ * Returns:
+ *      The shard that holds (or would hold) the key.
+ */
+struct tree_shard_t* tree_shards_of( struct tree_shards_t* p_shards, char* p_key, size_t keysize );
+
+/*
+ * Index of the shard of a key.
+ *
+ * Returns:
+ *      The index (0 to n_shards - 1) of tree_shards_of.
+ */
+int tree_shards_index( struct tree_shards_t* p_shards, char* p_key, size_t keysize );
+
+/*
+ * Same as tree_put_take, on the key's shard.
+ */
+int tree_shards_put_take( struct tree_shards_t* p_shards, char* p_key, size_t keysize, struct data_t* p_value );
+
+/*
+ * Same as tree_get2, on the key's shard. On TREE_BST/TREE_AVL stores it first tries a read validated by the shard's
+ * sequence, without the lock.
+ */
+struct data_t* tree_shards_get2( struct tree_shards_t* p_shards, char* p_key, size_t keysize );
+
+/*
+ * Same as tree_del2, on the key's shard.
+ */
+int tree_shards_del2( struct tree_shards_t* p_shards, char* p_key, size_t keysize );
+
+/*
+ * Write of tree_shards_write_batch.
+ *
+ * Members:
+ *      p_key, keysize: The key (copied by the tree).
+ *      p_value: The value to put, taken like tree_put_take; NULL to remove the key.
+ *      result: Set to the result of the write (0 or -1, as tree_put_take / tree_del2).
+ */
+struct tree_shards_write_t
+{
+    char* p_key;
+    size_t keysize;
+    struct data_t* p_value;
+    int result;
+};
+
+/*
+ * Applies a sequence of puts and removals in order, locking each shard they touch once for all of them (in index
+ * order, like every function that holds several shard locks).
+ *
+ * Returns:
+ *      0 if every write succeeded; -1 otherwise (see the result of each one).
+ */
+int tree_shards_write_batch( struct tree_shards_t* p_shards, struct tree_shards_write_t* p_writes, int n );
+
+/*
+ * Same as tree_put_batch: the entries are split by shard (keeping their order, so the last value of a key still wins)
+ * and each shard applies its part under one acquisition of its lock.
+ */
+int tree_shards_put_batch( struct tree_shards_t* p_shards, struct entry_t** pp_entries, int n );
+
+/*
+ * Same as tree_bulk_load: every shard must be empty. The sorted entries are split by shard (each part is still
+ * sorted) and loaded with tree_bulk_load. On error every shard is left empty.
+ */
+int tree_shards_bulk_load( struct tree_shards_t* p_shards, struct entry_t** pp_entries, int n );
+
+/*
+ * Same as tree_size: the sum of the sizes of the shards.
+ */
+int tree_shards_size( struct tree_shards_t* p_shards );
+
+/*
+ * Height of the tallest shard. Each shard holds about 1/n of the keys, so this is lower than the height of a single
+ * tree with every key.
+ */
+int tree_shards_height( struct tree_shards_t* p_shards );
+
+/*
+ * Same as tree_get_values and tree_get_rank2 over the whole store. The array is freed with tree_free_values.
+ */
+void** tree_shards_get_values( struct tree_shards_t* p_shards );
+int tree_shards_get_rank2( struct tree_shards_t* p_shards, char* p_key, size_t keysize );
+
+/*
+ * Same as tree_scan2 and tree_scan_prefix2 over the whole store. callback runs with every shard read locked (inside an
+ * epoch of every shard on TREE_COW), so it must not call the tree_shards functions that write.
+ */
+int tree_shards_scan2( struct tree_shards_t* p_shards, char* p_start_key, size_t start_keysize, char* p_end_key,
+                       size_t end_keysize, int limit, int (*callback)( struct entry_t* p_entry, void* p_context ),
+                       void* p_context );
+int tree_shards_scan_prefix2( struct tree_shards_t* p_shards, char* p_prefix, size_t prefixsize, int limit,
+                              int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context );
+
+/*
+ * Visits the entries at positions [offset, offset + limit) of the key order of the whole store (limit <= 0 doesn't
+ * limit), like tree_get_key_at / tree_get_keys_page but with a callback, which gets binary keys with their size. The
+ * key at offset is found from the ranks of the shards and the merge starts there, so each shard scans at most limit
+ * entries, not offset + limit. If that search fails (a TREE_COW shard written meanwhile) it merges from the first key.
+ * callback runs inside the read, as on tree_shards_scan2.
+ *
+ * Returns:
+ *      The number of entries visited; -1 on error.
+ */
+int tree_shards_page( struct tree_shards_t* p_shards, size_t offset, int limit,
+                      int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context );
+
+/*
+ * Entries of one shard collected for a merge (pointers to the tree's entries, valid until the read ends).
+ *
+ * Members:
+ *      pp_entries: The entries, in key order.
+ *      n_entries: Number of entries.
+ *      capacity: Size of pp_entries.
+ *      position: Next entry to merge.
+ */
+struct tree_shards_run_t
+{
+    struct entry_t** pp_entries;
+    size_t n_entries;
+    size_t capacity;
+    size_t position;
+};
+
+/*
+ * Visits, in key order over every shard, the entries in [start_key, end_key) (or with the given prefix), skipping the
+ * first skip and stopping after limit (limit <= 0 doesn't limit) or when callback returns != 0 (< 0 is an error, and
+ * the merge fails). Read locks every shard while it runs (TREE_COW: enters an epoch on each one). The keys are set
+ * with entry_key_set (they can be binary).
+ *
+ * Parameters:
+ *      p_start_key, p_end_key: Range, as on tree_scan2 (NULL is unbounded); ignored if p_prefix is set.
+ *      p_prefix: Prefix, as on tree_scan_prefix2; NULL for a range.
+ *      skip: Number of entries skipped before the first one visited.
+ *      limit: Maximum number of entries visited.
+ *
+ * Returns:
+ *      The number of entries visited; -1 on error (including an error of callback).
+ */
+int tree_shards_merge( struct tree_shards_t* p_shards, struct entry_t* p_start_key, struct entry_t* p_end_key,
+                       struct entry_t* p_prefix, size_t skip, int limit,
+                       int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context );
+
+/*
+ * tree_scan callback used by tree_shards_merge: appends the entry to a struct tree_shards_run_t.
+ *
+ * Returns:
+ *      0 to continue; -1 if there was no memory.
+ */
+int tree_shards_run_append( struct entry_t* p_entry, void* p_run );
+
+/*
+ * Read lock / write lock / unlock every shard, in index order.
+ */
+void tree_shards_rdlock_all( struct tree_shards_t* p_shards );
+void tree_shards_wrlock_all( struct tree_shards_t* p_shards );
+void tree_shards_unlock_all( struct tree_shards_t* p_shards );
+
+#endif
@@ -7,16 +7,60 @@
 #define _TREE_SKEL_PRIVATE_H
 
 #include <malloc.h>
+#include <stdint.h>
+#include <pthread.h>
 #include "stddef.h"
 
 #define REQUEST_DEL 0
 #define REQUEST_PUT 1
+#define REQUEST_BULK_LOAD 2
+#define REQUEST_PUT_BATCH 3
 
+// Number of shards of the server tree when it is not given (see tree_skel_init3).
+#define TREE_SKEL_DEFAULT_SHARDS 16
+
+// Write requests each worker's deque holds before imvoke waits for the worker (see struct request_deque_t).
+#define TREE_SKEL_QUEUE_CAPACITY 4096
+
+// Backlog of a worker's deque at which imvoke wakes an idle worker up to steal from it (and at each multiple of it).
+#define TREE_SKEL_STEAL_THRESHOLD 64
+
+// Size the deques are padded to, so the locks of neighbouring workers don't share a cache line.
+#define TREE_SKEL_CACHE_LINE 64
+
+// Most writes a worker executes in one batch (holding the shard locks, and updating op_proc, once for all of them).
+#define TREE_SKEL_MAX_BATCH 64
+
+// Failed operations op_proc remembers for verify (the most recent ones).
+#define TREE_SKEL_MAX_FAILED 64
+
+/*
+ * Progress of the write operations.
+ *
+ * Members:
+ *      max_proc: the biggest op_n already executed.
+ *      in_progress_size: number of workers.
+ *      p_in_progress: op_n being executed by each worker (0 if none).
+ *      pending_capacity: size of p_pending (a power of 2).
+ *      n_pending: number of op_n on p_pending.
+ *      p_pending: op_n queued or being executed (open addressing set, 0 on the empty slots).
+ *      n_failed: number of op_n ever added to p_failed.
+ *      p_failed: the last TREE_SKEL_MAX_FAILED op_n that were rejected (e.g. a bulk load of a tree that isn't empty),
+ *                a ring.
+ *
+ * The workers don't finish the operations in op_n order (each one has its own queue), so an operation is done when
+ * it is no longer pending, not when op_n <= max_proc.
+ */
 struct op_proc
 {
     int max_proc;
     size_t in_progress_size;
     int *p_in_progress;
+    size_t pending_capacity;
+    size_t n_pending;
+    int *p_pending;
+    size_t n_failed;
+    int p_failed[TREE_SKEL_MAX_FAILED];
 };
 
 /*
@@ -24,20 +68,141 @@ struct op_proc
  *
  * Parameters:
  *      op_n: numero da operacao.
- *      op: a operação a executar. op = 0 se for um delete, op = 1 se for um put.
+ *      op: a operação a executar (REQUEST_DEL, REQUEST_PUT, REQUEST_BULK_LOAD ou REQUEST_PUT_BATCH).
  *      p_key: a chave a remover ou adicionar.
+ *      keysize: o tamanho da chave (pode ser binaria).
  *      p_data: os dados a adicionar em caso de put, ou NULL em caso de delete.
- *      p_next: a proxima tarefa na fila de tarefas.
+ *      pp_entries: as entradas a carregar (bulk load) ou a adicionar (put batch), ou NULL.
+ *      n_entries: o numero de entradas de pp_entries.
+ *      n_references: o numero de filas onde o pedido ainda esta (e destruido quando chega a 0).
+ *      n_arrivals: o numero de workers que ainda nao chegaram ao pedido (pedidos com varias chaves).
+ *      is_done: 1 depois de um pedido com varias chaves ser executado.
+ *      is_superseded: 1 se uma escrita posterior da mesma chave o substituiu antes de ser executado (ver
+ *                     tree_skel_set_coalescing); o worker ignora-o.
+ *      shard: o shard da chave (pedidos de uma chave), -1 nos outros.
+ *
+ * Os pedidos de uma chave (REQUEST_PUT, REQUEST_DEL) vao para a fila do worker dono do shard da chave, por isso as
+ * escritas de uma chave sao executadas pela ordem de op_n (um worker que rouba um shard leva as escritas dele que
+ * estavam na fila, ver struct request_deque_t). Os pedidos com varias chaves (REQUEST_BULK_LOAD,
+ * REQUEST_PUT_BATCH) vao para a fila de todos os workers: o ultimo a chegar executa-o, os outros esperam por ele.
  */
 struct request_t
 {
     int op_n;
     int op;
     char *p_key;
+    size_t keysize;
     struct data_t *p_data;
-    struct request_t *p_next;
+    struct entry_t **pp_entries;
+    size_t n_entries;
+    int n_references;
+    int n_arrivals;
+    int is_done;
+    int is_superseded;
+    int shard;
 };
 
+/*
+ * Write requests waiting for a worker: a ring, in op_n order, with the ones of the shards the worker owns and the
+ * requests with several keys.
+ *
+ * The worker takes batches from the front. A worker with nothing to do steals from the busiest one: it takes every
+ * request of one shard (the shard of the newest request that can move) and the ownership of the shard, under the
+ * locks of both deques, so the writes of a key are always on one deque (or batch) and keep their order. A shard can't
+ * move while its owner is executing a batch with it, nor if it has requests behind a request with several keys.
+ *
+ * Members:
+ *      lock: protects the deque.
+ *      not_empty: where the worker sleeps (also woken up to steal, see is_woken).
+ *      not_full: where imvoke waits for room.
+ *      pp_requests: the ring.
+ *      mask: size of the ring - 1 (a power of 2).
+ *      head: position of the first request.
+ *      n_requests: number of requests (read without the lock to choose whom to steal from).
+ *      busy_shards: shards of the batch the worker is executing (bit per shard; all of them for a request with
+ *                   several keys).
+ *      is_idle: 1 while the worker has nothing to do.
+ *      is_woken: set by imvoke to wake an idle worker up to steal.
+ *      is_closed: set when the server is shutting down.
+ */
+struct request_deque_t
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    struct request_t **pp_requests;
+    size_t mask;
+    size_t head;
+    size_t n_requests;
+    uint64_t busy_shards;
+    int is_idle;
+    int is_woken;
+    int is_closed;
+} __attribute__(( aligned( TREE_SKEL_CACHE_LINE ) ));
+
+/*
+ * Slot of the coalescing table.
+ *
+ * Members:
+ *      hash: tree_index_hash of the key of the request.
+ *      p_request: pending request; NULL if the slot is empty.
+ */
+struct coalesce_slot_t
+{
+    uint64_t hash;
+    struct request_t *p_request;
+};
+
+/*
+ * Coalescing table: the last write (REQUEST_PUT or REQUEST_DEL) of each key that no worker took yet. Open addressing
+ * with linear probing and backward shift deletion, like the hash index of the tree.
+ *
+ * Members:
+ *      capacity: number of slots (a power of 2).
+ *      n_requests: number of requests on the table.
+ *      p_slots: the slots.
+ *      n_coalesced: number of requests superseded.
+ */
+struct coalesce_t
+{
+    size_t capacity;
+    size_t n_requests;
+    struct coalesce_slot_t *p_slots;
+    unsigned long n_coalesced;
+};
+
+/*
+ * Bulk load being received (OP_BULKLOAD) on one connection: the entries of every chunk so far, in ascending key
+ * order. It is queued as a REQUEST_BULK_LOAD when the last chunk arrives. Each connection has its own (see imvoke2),
+ * cleared with bulk_load_clear when the connection closes.
+ *
+ * Members:
+ *      n_entries: number of entries received.
+ *      capacity: size of the pp_entries array.
+ *      pp_entries: the entries received.
+ */
+struct bulk_load_t
+{
+    size_t n_entries;
+    size_t capacity;
+    struct entry_t **pp_entries;
+};
+
+/*
+ * Turns on (or off) the coalescing of the writes: a REQUEST_PUT or REQUEST_DEL supersedes the write of the same key
+ * still waiting on the queue, which is marked done (verify) and never executed. Must be called before
+ * tree_skel_init3.
+ */
+void tree_skel_set_coalescing( int is_enabled );
+
+/*
+ * Average number of writes executed per batch by the workers so far (see TREE_SKEL_MAX_BATCH).
+ *
+ * Returns:
+ *      The average; 0 if no batch ran yet.
+ */
+double tree_skel_average_batch_size();
+
 /*
  * Termination when a SIGINT is received.
  */
@@ -56,11 +221,12 @@ void tree_skel_request_queue_threads_destroy();
  *
  * Parameters:
  *   in_progress_size: size of the in_progress array.
+ *   max_pending: most operations that can be pending at once.
  *
  * Returns:
  *    NULL if an error occurred, or a pointer to the op_proc struct.
  */
-struct op_proc *op_proc_create(int in_progress_size);
+struct op_proc *op_proc_create(int in_progress_size, size_t max_pending);
 
 /*
  * Destroys a op_proc struct, freeing all the memory it occupies.
@@ -93,6 +259,56 @@ int op_proc_get_max_proc(struct op_proc *p_op_proc);
  */
 void op_proc_set_max_proc(struct op_proc *p_op_proc, int max_proc);
 
+/*
+ * Marks an operation as pending, before its request is queued.
+ *
+ * Returns:
+ *    0 if success, -1 if there are already max_pending operations pending.
+ */
+int op_proc_add_pending( struct op_proc *p_op_proc, int op_n );
+
+/*
+ * Marks a pending operation as done, updating max_proc.
+ *
+ * Returns:
+ *    1 if max_proc changed, 0 otherwise.
+ */
+int op_proc_set_done( struct op_proc *p_op_proc, int op_n );
+
+/*
+ * Marks the operations of a batch as done and the worker as idle, with one acquisition of the lock.
+ *
+ * Parameters:
+ *      index: the worker.
+ *      p_op_ns: the op_n of the batch.
+ *      n: the number of operations of the batch.
+ *
+ * Returns:
+ *    1 if max_proc changed, 0 otherwise.
+ */
+int op_proc_finish( struct op_proc *p_op_proc, int index, int *p_op_ns, int n );
+
+/*
+ * Records that an operation was rejected, before it is marked done, so verify can report it.
+ */
+void op_proc_set_failed( struct op_proc *p_op_proc, int op_n );
+
+/*
+ * Checks if an operation was rejected (only the last TREE_SKEL_MAX_FAILED are remembered).
+ *
+ * Returns:
+ *    1 if it was, 0 otherwise.
+ */
+int op_proc_has_failed( struct op_proc *p_op_proc, int op_n );
+
+/*
+ * Checks if an operation is pending (queued or being executed).
+ *
+ * Returns:
+ *    1 if it is, 0 otherwise.
+ */
+int op_proc_is_pending( struct op_proc *p_op_proc, int op_n );
+
 /*
  * Checks if a request is in progress from the op_proc structure.
  *
@@ -148,7 +364,25 @@ int op_proc_get_in_progress( struct op_proc* p_op_proc, int index );
  * Returns:
  *    NULL if an error occurred, or a pointer to the request struct.
  */
-struct request_t* request_create( int op_n, int op, char *p_key, struct data_t *p_data );
+struct request_t* request_create( int op_n, int op, char *p_key, size_t keysize, struct data_t *p_data );
+
+/*
+ * Same as request_create, but the request takes ownership of the key (malloc'd, or NULL for an empty key) and of the
+ * caller's reference to p_data instead of copying them. Both are released on error.
+ *
+ * Returns:
+ *    NULL if an error occurred, or a pointer to the request struct.
+ */
+struct request_t* request_create_take( int op_n, int op, char *p_key, size_t keysize, struct data_t *p_data );
+
+/*
+ * Same as request_create, for requests over several entries (REQUEST_BULK_LOAD, REQUEST_PUT_BATCH). The request takes ownership of the
+ * array and of the entries; they are destroyed on error.
+ *
+ * Returns:
+ *    NULL if an error occurred, or a pointer to the request struct.
+ */
+struct request_t* request_create_entries( int op_n, int op, struct entry_t **pp_entries, size_t n_entries );
 
 /*
  * Destroys a structure corresponding to a request freeing all the memory it occupies.
@@ -159,7 +393,14 @@ struct request_t* request_create( int op_n, int op, char *p_key, struct data_t *
 void request_destroy( struct request_t *p_request );
 
 /*
- * Adds a request to the queue of requests.
+ * Releases one reference to a request (see n_references), destroying it on the last one.
+ */
+void request_release( struct request_t *p_request );
+
+/*
+ * Marks the request's operation as pending and adds the request to the deque of the worker that owns its key's shard
+ * (or to the deque of every worker, see struct request_t), waiting while the deque is full. If the deque was closed
+ * the request is released.
  *
  * Parameters:
  *      p_request: request to add to the queue of requests.
@@ -167,14 +408,133 @@ void request_destroy( struct request_t *p_request );
 void queue_add_request( struct request_t *p_request );
 
 /*
- * Gets the next request in the queue of requests.
+ * Gets the next batch from the deque of a worker, waiting (or stealing, see struct request_deque_t) while it is empty:
+ * one request with several keys, or the writes of one key at the front, as many as are queued up to
+ * TREE_SKEL_MAX_BATCH. Their shards are busy until queue_batch_done.
+ *
+ * Parameters:
+ *      worker: index of the worker.
+ *      pp_batch: where the requests are put (TREE_SKEL_MAX_BATCH of them).
+ *
+ * Returns:
+ *      The number of requests; 0 once the deque is closed.
+ */
+int queue_get_next_batch( int worker, struct request_t **pp_batch );
+
+/*
+ * Ends the batch of a worker: its shards can be stolen again.
+ */
+void queue_batch_done( int worker );
+
+/*
+ * Worker that executes the writes of a shard: its owner.
  *
  * Returns:
- *      head request from the queue of requests.
+ *      The index of the worker.
  */
-struct request_t *queue_get_next_request();
+int queue_worker_of( int shard );
 
 struct message_t;
+struct entry_t;
+struct MessageT;
+struct MessageT__Entry;
+struct ProtobufCBinaryData;
+
+/*
+ * Entries collected by a tree_scan, to be sent on a response message.
+ *
+ * Members:
+ *      n_entries: number of entries collected.
+ *      capacity: size of the pp_entries array.
+ *      pp_entries: the collected entries (copies).
+ */
+struct scan_result_t
+{
+    size_t n_entries;
+    size_t capacity;
+    struct MessageT__Entry **pp_entries;
+};
+
+/*
+ * tree_scan callback that appends a copy of the entry to a struct scan_result_t.
+ *
+ * Parameters:
+ *      p_entry: entry visited by the scan.
+ *      p_scan_result: struct scan_result_t where the entry is appended.
+ *
+ * Returns:
+ *      0 to continue the scan; -1 if there was no memory (stops the scan).
+ */
+int scan_append_entry( struct entry_t *p_entry, void *p_scan_result );
+
+/*
+ * Keys collected by a tree_shards_page, to be sent on a response message.
+ *
+ * Members:
+ *      n_keys: number of keys collected.
+ *      capacity: size of the p_keys array.
+ *      p_keys: the collected keys (copies, with their size: keys can be binary).
+ */
+struct keys_result_t
+{
+    size_t n_keys;
+    size_t capacity;
+    struct ProtobufCBinaryData *p_keys;
+};
+
+/*
+ * tree_shards_page callback that appends a copy of the key of the entry to a struct keys_result_t.
+ *
+ * Parameters:
+ *      p_entry: entry visited.
+ *      p_keys_result: struct keys_result_t where the key is appended.
+ *
+ * Returns:
+ *      0 to continue; -1 if there was no memory (stops the walk).
+ */
+int keys_append_key( struct entry_t *p_entry, void *p_keys_result );
+
+/*
+ * Creates an entry with the key and data buffers of a message entry, which are left empty on the message.
+ *
+ * Parameters:
+ *      p_msg_entry: the message entry.
+ *
+ * Returns:
+ *      The entry; NULL if there was no memory or the data is empty (the message entry is left unchanged).
+ */
+struct entry_t *message_entry_take( struct MessageT__Entry *p_msg_entry );
+
+/*
+ * Moves the entries of a message to a new array, emptying the message.
+ *
+ * Parameters:
+ *      p_MessageT: the message.
+ *      p_n_entries: set to the number of entries.
+ *
+ * Returns:
+ *      The array (at least one element long), which owns the entries; NULL on error.
+ */
+struct entry_t **message_entries_take( struct MessageT *p_MessageT, size_t *p_n_entries );
+
+/*
+ * Adds the entries of an OP_BULKLOAD chunk to the bulk load being received. The entries move to the bulk load (see
+ * message_entries_take).
+ *
+ * Parameters:
+ *      p_bulk_load: the bulk load of the connection.
+ *      p_MessageT: the OP_BULKLOAD request.
+ *
+ * Returns:
+ *      0 on success; -1 if the keys are not in ascending order (after the ones already received) or there was no
+ *      memory. On error the whole bulk load is discarded.
+ */
+int bulk_load_append( struct bulk_load_t *p_bulk_load, struct MessageT *p_MessageT );
+
+/*
+ * Discards a bulk load being received, destroying its entries.
+ */
+void bulk_load_clear( struct bulk_load_t *p_bulk_load );
 
 /*
  * It is like the invoke() function, but with the method struct message_t exposed.
@@ -182,4 +542,13 @@ struct message_t;
  */
 int imvoke( struct message_t *p_msg );
 
+/*
+ * Same as imvoke, for a message received on a connection.
+ *
+ * Parameters:
+ *      p_bulk_load: the bulk load being received on the connection (see struct bulk_load_t). With NULL, an
+ *                   OP_BULKLOAD must carry the whole load in one message.
+ */
+int imvoke2( struct message_t *p_msg, struct bulk_load_t *p_bulk_load );
+
 #endif
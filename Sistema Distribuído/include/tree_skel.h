@@ -11,6 +11,19 @@
  */
 int tree_skel_init(int n);
 
+/* Igual a tree_skel_init, mas a árvore é criada com tree_create2(type).
+ * Retorna 0 (OK) ou -1 (erro, por exemplo OUT OF MEMORY)
+ */
+int tree_skel_init2(int n, int type);
+
+/* Igual a tree_skel_init2, mas as chaves são repartidas (por hash) por
+ * n_shards árvores, cada uma com o seu lock, para que as escritas de
+ * chaves em shards diferentes possam ser feitas em paralelo pelas n
+ * threads. tree_skel_init2 usa TREE_SKEL_DEFAULT_SHARDS shards.
+ * Retorna 0 (OK) ou -1 (erro, por exemplo OUT OF MEMORY)
+ */
+int tree_skel_init3(int n, int type, int n_shards);
+
 /* Função da thread secundária que vai processar pedidos de escrita.
 */
 void * process_request (void *params);
@@ -26,6 +39,8 @@ void tree_skel_destroy();
 int invoke(struct message_t *msg);
 
 /* Verifica se a operação identificada por op_n foi executada.
+ * Retorna 0 (executada), -1 (ainda não executada) ou -2 (executada, mas
+ * rejeitada, por exemplo um bulk load de uma árvore que não está vazia).
 */
 int verify(int op_n);
 
@@ -133,8 +133,9 @@ int rtree_put(struct rtree_t *p_rtree, struct entry_t *p_entry) {
 
     ProtobufCBinaryData data_temp;
 
-    entry_temp.key = (char *)malloc( sizeof( char ) * ( strlen( p_entry->key ) + 1 ) );
-    strcpy( entry_temp.key, p_entry->key );
+    // Key is sent as is (keysize bytes, may be binary).
+    entry_temp.key.data = (uint8_t *)p_entry->key;
+    entry_temp.key.len = p_entry->keysize;
 
     data_temp.len = p_entry->value->datasize;
     data_temp.data = calloc( sizeof( void ), data_temp.len );
@@ -151,14 +152,12 @@ int rtree_put(struct rtree_t *p_rtree, struct entry_t *p_entry) {
     {
         fprintf( stderr, "%s : error sending/receving to/from server.\n", strerror( errno ) );
         free( data_temp.data );
-        free( entry_temp.key );
         free(p_msg);
         return -1;
     };
 
-    // Clean temp entry and data.
+    // Clean temp data.
     free( data_temp.data );
-    free( entry_temp.key );
 
     int result = p_msg->p_MessageT->result;
 
@@ -170,6 +169,10 @@ int rtree_put(struct rtree_t *p_rtree, struct entry_t *p_entry) {
 }
 
 struct data_t *rtree_get(struct rtree_t *p_rtree, char *p_key) {
+    return rtree_get2( p_rtree, p_key, p_key ? strlen( p_key ) : 0 );
+}
+
+struct data_t *rtree_get2(struct rtree_t *p_rtree, char *p_key, size_t keysize) {
     if ( !p_rtree || !p_key )
     {
         errno = EINVAL;
@@ -186,8 +189,8 @@ struct data_t *rtree_get(struct rtree_t *p_rtree, char *p_key) {
     msg.c_type = CT_KEY;
 
     // Key to send.
-    msg.key = (char *)malloc( sizeof( char) * ( strlen( p_key ) + 1 ) );
-    strcpy( msg.key, p_key );
+    msg.key.data = (uint8_t *)p_key;
+    msg.key.len = keysize;
 
     struct message_t* p_msg = (struct message_t*) malloc( sizeof( struct message_t ) );
     p_msg->p_MessageT = p_MessageT;
@@ -196,7 +199,6 @@ struct data_t *rtree_get(struct rtree_t *p_rtree, char *p_key) {
     if ((p_msg = network_send_receive(p_rtree, p_msg )) == NULL )
     {
         fprintf( stderr, "%s : error sending/receving to/from server.\n", strerror( errno ) );
-        free( msg.key );
         free(p_msg);
         return NULL;
     }
@@ -204,7 +206,6 @@ struct data_t *rtree_get(struct rtree_t *p_rtree, char *p_key) {
     if(p_msg->p_MessageT->data.len == 0){
         message_t__free_unpacked( p_msg->p_MessageT, NULL );
         free(p_msg);
-        free(msg.key);
     	return NULL;
     }
 
@@ -213,13 +214,16 @@ struct data_t *rtree_get(struct rtree_t *p_rtree, char *p_key) {
 
     // Clean memory.
     message_t__free_unpacked( p_msg->p_MessageT, NULL );
-    free( msg.key );
     free( p_msg );
 
     return p_data_result;
 }
 
 int rtree_del(struct rtree_t *p_rtree, char *p_key) {
+    return rtree_del2( p_rtree, p_key, p_key ? strlen( p_key ) : 0 );
+}
+
+int rtree_del2(struct rtree_t *p_rtree, char *p_key, size_t keysize) {
 
 	if ( !p_rtree || !p_key )
     {
@@ -237,8 +241,8 @@ int rtree_del(struct rtree_t *p_rtree, char *p_key) {
     msg.c_type = CT_KEY;
 
     // Key to send.
-    msg.key = (char *)malloc( sizeof( char ) * (strlen( p_key ) + 1)  );
-    strcpy( msg.key, p_key );
+    msg.key.data = (uint8_t *)p_key;
+    msg.key.len = keysize;
 
     struct message_t* p_msg = (struct message_t*) malloc( sizeof( struct message_t ) );
     p_msg->p_MessageT = p_MessageT;
@@ -255,7 +259,6 @@ int rtree_del(struct rtree_t *p_rtree, char *p_key) {
 
     // Clean memory.
     message_t__free_unpacked( p_msg->p_MessageT, NULL );
-    free( msg.key );
     free( p_msg );
 
     return result;
@@ -375,10 +378,10 @@ char **rtree_get_keys(struct rtree_t *p_rtree) {
     char **pp_keys = (char **) malloc(sizeof(char *) * ( num_keys + 1 ));
     pp_keys[num_keys] = NULL;
 
-    // Iterate through all strings on the message.
+    // Iterate through all keys on the message (copied with a '\0' after them).
     for ( int i = 0; i < num_keys; i++ )
     {
-        pp_keys[i] = strdup( p_msg->p_MessageT->keys[i] );
+        pp_keys[i] = message_key_dup( &p_msg->p_MessageT->keys[i] );
     }
 
     // Clean memory.
@@ -435,6 +438,337 @@ void **rtree_get_values(struct rtree_t *p_rtree) {
     return pp_values;
 }
 
+char *rtree_get_key_at( struct rtree_t *p_rtree, int index )
+{
+    if ( !p_rtree || index < 0 )
+    {
+        errno = EINVAL;
+        fprintf( stderr, "%s : rtree_get_key_at has an invalid argument.\n", strerror( errno ) );
+        return NULL;
+    }
+
+    MessageT msg;
+    message_t__init( &msg );
+    MessageT *p_MessageT = &msg;
+
+    // Command codes.
+    msg.opcode = OP_GETKEYAT;
+    msg.c_type = CT_RESULT;
+    msg.result = index;
+
+    struct message_t* p_msg = (struct message_t*) malloc( sizeof( struct message_t ) );
+    p_msg->p_MessageT = p_MessageT;
+
+    // Send and receive answer.
+    if ((p_msg = network_send_receive(p_rtree, p_msg )) == NULL )
+    {
+        fprintf( stderr, "%s : error sending/receving to/from server.\n", strerror( errno ) );
+        free(p_msg);
+        return NULL;
+    }
+
+    char *p_key = NULL;
+
+    // Index out of bounds.
+    if ( p_msg->p_MessageT->opcode != OP_ERROR )
+        p_key = message_key_dup( &p_msg->p_MessageT->key );
+
+    // Clean memory.
+    message_t__free_unpacked( p_msg->p_MessageT, NULL );
+    free( p_msg );
+
+    return p_key;
+}
+
+int rtree_get_rank( struct rtree_t *p_rtree, char *p_key )
+{
+    return rtree_get_rank2( p_rtree, p_key, p_key ? strlen( p_key ) : 0 );
+}
+
+int rtree_get_rank2( struct rtree_t *p_rtree, char *p_key, size_t keysize )
+{
+    if ( !p_rtree || !p_key )
+    {
+        errno = EINVAL;
+        fprintf( stderr, "%s : rtree_get_rank at least one null argument found.\n", strerror( errno ) );
+        return -1;
+    }
+
+    MessageT msg;
+    message_t__init( &msg );
+    MessageT *p_MessageT = &msg;
+
+    // Command codes.
+    msg.opcode = OP_GETRANK;
+    msg.c_type = CT_KEY;
+
+    // Key to send.
+    msg.key.data = (uint8_t *)p_key;
+    msg.key.len = keysize;
+
+    struct message_t* p_msg = (struct message_t*) malloc( sizeof( struct message_t ) );
+    p_msg->p_MessageT = p_MessageT;
+
+    // Send and receive answer.
+    if ((p_msg = network_send_receive(p_rtree, p_msg )) == NULL )
+    {
+        fprintf( stderr, "%s : error sending/receving to/from server.\n", strerror( errno ) );
+        free(p_msg);
+        return -1;
+    }
+
+    int result = p_msg->p_MessageT->opcode == OP_ERROR ? -1 : (int)p_msg->p_MessageT->result;
+
+    // Clean memory.
+    message_t__free_unpacked( p_msg->p_MessageT, NULL );
+    free( p_msg );
+
+    return result;
+}
+
+char **rtree_get_keys_page( struct rtree_t *p_rtree, int offset, int limit )
+{
+    if ( !p_rtree || offset < 0 || limit < 0 )
+    {
+        errno = EINVAL;
+        fprintf( stderr, "%s : rtree_get_keys_page has an invalid argument.\n", strerror( errno ) );
+        return NULL;
+    }
+
+    MessageT msg;
+    message_t__init( &msg );
+    MessageT *p_MessageT = &msg;
+
+    // Command codes.
+    msg.opcode = OP_GETKEYSPAGE;
+    msg.c_type = CT_NONE;
+    msg.offset = offset;
+    msg.limit = limit;
+
+    struct message_t* p_msg = (struct message_t*) malloc( sizeof( struct message_t ) );
+    p_msg->p_MessageT = p_MessageT;
+
+    // Send and receive answer.
+    if ((p_msg = network_send_receive(p_rtree, p_msg )) == NULL )
+    {
+        fprintf( stderr, "%s : error sending/receving to/from server.\n", strerror( errno ) );
+        free(p_msg);
+        return NULL;
+    }
+
+    int num_keys = p_msg->p_MessageT->n_keys;
+    char **pp_keys = (char **) malloc(sizeof(char *) * ( num_keys + 1 ));
+    pp_keys[num_keys] = NULL;
+
+    // Iterate through all keys on the message (copied with a '\0' after them).
+    for ( int i = 0; i < num_keys; i++ )
+    {
+        pp_keys[i] = message_key_dup( &p_msg->p_MessageT->keys[i] );
+    }
+
+    // Clean memory.
+    message_t__free_unpacked( p_msg->p_MessageT, NULL );
+    free( p_msg );
+
+    return pp_keys;
+}
+
+struct entry_t **rtree_scan( struct rtree_t *p_rtree, char *p_start_key, char *p_end_key, int limit )
+{
+    return rtree_scan2( p_rtree, p_start_key, p_start_key ? strlen( p_start_key ) : 0, p_end_key,
+                        p_end_key ? strlen( p_end_key ) : 0, limit );
+}
+
+struct entry_t **rtree_scan2( struct rtree_t *p_rtree, char *p_start_key, size_t start_keysize, char *p_end_key,
+                              size_t end_keysize, int limit )
+{
+    if ( !p_rtree )
+    {
+        errno = EINVAL;
+        fprintf( stderr, "%s : rtree_scan has a null argument.\n", strerror( errno ) );
+        return NULL;
+    }
+
+    MessageT msg;
+    message_t__init( &msg );
+
+    // Command codes.
+    msg.opcode = OP_SCAN;
+    msg.c_type = CT_KEY;
+
+    // Range to send. Unbounded ends are sent empty.
+    msg.key.data = (uint8_t *)p_start_key;
+    msg.key.len = p_start_key ? start_keysize : 0;
+    msg.end_key.data = (uint8_t *)p_end_key;
+    msg.end_key.len = p_end_key ? end_keysize : 0;
+    msg.limit = limit > 0 ? limit : 0;
+
+    struct message_t msg_wrapper = { .p_MessageT = &msg, .p_value_ref = NULL };
+
+    return rtree_send_receive_entries( p_rtree, &msg_wrapper );
+}
+
+struct entry_t **rtree_scan_prefix( struct rtree_t *p_rtree, char *p_prefix, int limit )
+{
+    return rtree_scan_prefix2( p_rtree, p_prefix, p_prefix ? strlen( p_prefix ) : 0, limit );
+}
+
+struct entry_t **rtree_scan_prefix2( struct rtree_t *p_rtree, char *p_prefix, size_t prefixsize, int limit )
+{
+    if ( !p_rtree || !p_prefix )
+    {
+        errno = EINVAL;
+        fprintf( stderr, "%s : rtree_scan_prefix at least one null argument found.\n", strerror( errno ) );
+        return NULL;
+    }
+
+    MessageT msg;
+    message_t__init( &msg );
+
+    // Command codes.
+    msg.opcode = OP_SCANPREFIX;
+    msg.c_type = CT_KEY;
+
+    // Prefix to send.
+    msg.key.data = (uint8_t *)p_prefix;
+    msg.key.len = prefixsize;
+    msg.limit = limit > 0 ? limit : 0;
+
+    struct message_t msg_wrapper = { .p_MessageT = &msg, .p_value_ref = NULL };
+    struct entry_t **pp_entries = rtree_send_receive_entries( p_rtree, &msg_wrapper );
+
+    return pp_entries;
+}
+
+int rtree_send_entries( struct rtree_t *p_rtree, int opcode, struct entry_t **pp_entries, int n, int result )
+{
+    MessageT__Entry *p_msg_entries = NULL;
+    MessageT__Entry **pp_msg_entries = NULL;
+
+    if ( !(p_msg_entries = (MessageT__Entry *) malloc( sizeof( MessageT__Entry ) * (n ? n : 1) )) ||
+         !(pp_msg_entries = (MessageT__Entry **) malloc( sizeof( MessageT__Entry * ) * (n ? n : 1) )) )
+    {
+        fprintf( stderr, "%s: it was not possible to malloc().\n", strerror( errno ) );
+        free( p_msg_entries );
+        return -1;
+    }
+
+    MessageT msg;
+    message_t__init( &msg );
+
+    // Command codes.
+    msg.opcode = opcode;
+    msg.c_type = CT_ENTRIES;
+    msg.result = result;
+
+    // Keys and values are sent as they are, without copies.
+    for ( int i = 0; i < n; i++ )
+    {
+        message_t__entry__init( &p_msg_entries[i] );
+        p_msg_entries[i].key.data = (uint8_t *)pp_entries[i]->key;
+        p_msg_entries[i].key.len = pp_entries[i]->keysize;
+        p_msg_entries[i].data.data = (uint8_t *)pp_entries[i]->value->data;
+        p_msg_entries[i].data.len = pp_entries[i]->value->datasize;
+        pp_msg_entries[i] = &p_msg_entries[i];
+    }
+
+    msg.n_entries = n;
+    msg.entries = pp_msg_entries;
+
+    struct message_t msg_wrapper = { .p_MessageT = &msg, .p_value_ref = NULL };
+    struct message_t *p_msg = network_send_receive( p_rtree, &msg_wrapper );
+
+    free( pp_msg_entries );
+    free( p_msg_entries );
+
+    // Send and receive answer.
+    if ( !p_msg )
+    {
+        fprintf( stderr, "%s : error sending/receving to/from server.\n", strerror( errno ) );
+        return -1;
+    }
+
+    int answer = p_msg->p_MessageT->opcode == OP_ERROR ? -1 : (int)p_msg->p_MessageT->result;
+
+    message_t__free_unpacked( p_msg->p_MessageT, NULL );
+
+    return answer;
+}
+
+int rtree_bulk_load( struct rtree_t *p_rtree, struct entry_t **pp_entries, int n )
+{
+    if ( !p_rtree || n < 0 || (n > 0 && !pp_entries) )
+    {
+        errno = EINVAL;
+        fprintf( stderr, "%s : rtree_bulk_load has an invalid argument.\n", strerror( errno ) );
+        return -1;
+    }
+
+    int sent = 0;
+    int result = -1;
+
+    // An empty load is still sent, as a single last chunk. result marks the last chunk.
+    do
+    {
+        int chunk_size = n - sent < BULK_LOAD_CHUNK_SIZE ? n - sent : BULK_LOAD_CHUNK_SIZE;
+        int is_last = sent + chunk_size == n;
+
+        if ( (result = rtree_send_entries( p_rtree, OP_BULKLOAD, &pp_entries[sent], chunk_size, is_last )) < 0 )
+            return -1;
+
+        sent += chunk_size;
+    } while ( sent < n );
+
+    return result;
+}
+
+int rtree_put_batch( struct rtree_t *p_rtree, struct entry_t **pp_entries, int n )
+{
+    if ( !p_rtree || n < 0 || (n > 0 && !pp_entries) )
+    {
+        errno = EINVAL;
+        fprintf( stderr, "%s : rtree_put_batch has an invalid argument.\n", strerror( errno ) );
+        return -1;
+    }
+
+    return rtree_send_entries( p_rtree, OP_PUTBATCH, pp_entries, n, 0 );
+}
+
+struct entry_t **rtree_send_receive_entries( struct rtree_t *p_rtree, struct message_t *p_msg )
+{
+    // Send and receive answer.
+    if ((p_msg = network_send_receive(p_rtree, p_msg )) == NULL )
+    {
+        fprintf( stderr, "%s : error sending/receving to/from server.\n", strerror( errno ) );
+        return NULL;
+    }
+
+    if ( p_msg->p_MessageT->opcode == OP_ERROR )
+    {
+        message_t__free_unpacked( p_msg->p_MessageT, NULL );
+        return NULL;
+    }
+
+    int num_entries = p_msg->p_MessageT->n_entries;
+    struct entry_t **pp_entries = (struct entry_t **) malloc(sizeof(struct entry_t *) * ( num_entries + 1 ));
+    pp_entries[num_entries] = NULL;
+
+    // Iterate through all entries on the message.
+    for ( int i = 0; i < num_entries; i++ )
+    {
+        MessageT__Entry *p_msg_entry = p_msg->p_MessageT->entries[i];
+
+        struct data_t *p_data = data_create( p_msg_entry->data.len );
+        memcpy( p_data->data, p_msg_entry->data.data, p_data->datasize );
+        pp_entries[i] = entry_create2( message_key_dup( &p_msg_entry->key ), p_msg_entry->key.len, p_data );
+    }
+
+    // Clean memory.
+    message_t__free_unpacked( p_msg->p_MessageT, NULL );
+
+    return pp_entries;
+}
+
 int rtree_verify( struct rtree_t *p_rtree, int op_n )
 {
     if ( p_rtree == NULL || op_n < 0 )
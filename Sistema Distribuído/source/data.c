@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "data.h"
+#include "slab.h"
 
 struct data_t* data_create( int data_size )
 {
@@ -12,16 +13,17 @@ struct data_t* data_create( int data_size )
 
     // Allocate memory for new data_t.
     struct data_t* p_data = NULL;
-    if ( !(p_data = (struct data_t*)malloc( sizeof( struct data_t ) )) )
+    if ( !(p_data = (struct data_t*)slab_alloc( sizeof( struct data_t ) )) )
         return NULL;
 
     // Initialize data_t structure items.
     p_data->datasize = data_size;
+    p_data->refcount = 1;
 
-    // All bits initially to zero with calloc.
-    if ( !(p_data->data = calloc( sizeof( void ), data_size )) )
+    // All bits initially to zero.
+    if ( !(p_data->data = slab_calloc( data_size )) )
     {
-        free( p_data );
+        slab_free( p_data );
         return NULL;
     }
 
@@ -34,10 +36,11 @@ struct data_t* data_create2( int data_size, void* p_data )
         return NULL;
 
     struct data_t* p_new_data = NULL;
-    if ( !(p_new_data = (struct data_t*)malloc( sizeof( struct data_t ) )) )
+    if ( !(p_new_data = (struct data_t*)slab_alloc( sizeof( struct data_t ) )) )
         return NULL;
 
     p_new_data->datasize = data_size;
+    p_new_data->refcount = 1;
     p_new_data->data = p_data;
 
     return p_new_data;
@@ -45,11 +48,12 @@ struct data_t* data_create2( int data_size, void* p_data )
 
 void data_destroy( struct data_t* p_data )
 {
-    if ( p_data )
-    {
-        if ( p_data->data ) free( p_data->data );
-        free( p_data );
-    }
+    // Other references still use the data.
+    if ( !p_data || __atomic_sub_fetch( &p_data->refcount, 1, __ATOMIC_ACQ_REL ) > 0 )
+        return;
+
+    if ( p_data->data ) slab_free( p_data->data );
+    slab_free( p_data );
 }
 
 struct data_t* data_dup( struct data_t* p_data )
@@ -58,14 +62,15 @@ struct data_t* data_dup( struct data_t* p_data )
         return NULL;
 
     struct data_t* p_data_dup = NULL;
-    if ( !(p_data_dup = (struct data_t*)malloc( sizeof( struct data_t ) )) )
+    if ( !(p_data_dup = (struct data_t*)slab_alloc( sizeof( struct data_t ) )) )
         return NULL;
 
     /* Duplicate items. */
     p_data_dup->datasize = p_data->datasize;
+    p_data_dup->refcount = 1;
 
-    if ( !(p_data_dup->data = malloc( sizeof( void ) * p_data_dup->datasize )) ) {
-        free( p_data_dup );
+    if ( !(p_data_dup->data = slab_alloc( sizeof( void ) * p_data_dup->datasize )) ) {
+        slab_free( p_data_dup );
         return NULL;
     }
 
@@ -74,12 +79,26 @@ struct data_t* data_dup( struct data_t* p_data )
     return p_data_dup;
 }
 
+struct data_t* data_share( struct data_t* p_data )
+{
+    if ( !p_data )
+        return NULL;
+
+    // Readers of a TREE_COW tree share the same value concurrently.
+    if ( __atomic_load_n( &p_data->refcount, __ATOMIC_RELAXED ) == 0 )
+        return data_dup( p_data );
+
+    __atomic_add_fetch( &p_data->refcount, 1, __ATOMIC_RELAXED );
+
+    return p_data;
+}
+
 void data_replace( struct data_t* p_data, int new_data_size, void* p_new_data )
 {
     if ( !p_data || new_data_size <= 0 )
         return;
 
     p_data->datasize = new_data_size;
-    if ( p_data->data) free( p_data->data );
+    if ( p_data->data) slab_free( p_data->data );
     p_data->data = p_new_data;
 }
\ No newline at end of file
@@ -3,16 +3,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include "entry.h"
+#include "entry-private.h"
 #include "data.h"
+#include "slab.h"
 
 struct entry_t* entry_create( char* p_key, struct data_t* p_data )
+{
+    return entry_create2( p_key, p_key ? strlen( p_key ) : 0, p_data );
+}
+
+struct entry_t* entry_create2( char* p_key, size_t keysize, struct data_t* p_data )
 {
     struct entry_t* p_entry = NULL;
-    if ( !(p_entry = (struct entry_t*)malloc( sizeof( struct entry_t ) )) )
+    if ( !(p_entry = (struct entry_t*)slab_alloc( sizeof( struct entry_t ) )) )
         return NULL;
 
     // Entry structure can have key and data members NULL.
-    p_entry->key = p_key;
+    entry_key_set( p_entry, p_key, keysize );
     p_entry->value = p_data;
 
     return p_entry;
@@ -22,9 +29,9 @@ void entry_destroy( struct entry_t* p_entry )
 {
     if ( p_entry )
     {
-        if ( p_entry->key ) free( p_entry->key );
+        if ( p_entry->key ) slab_free( p_entry->key );
         data_destroy( p_entry->value );
-        free( p_entry );
+        slab_free( p_entry );
     }
 }
 
@@ -34,15 +41,24 @@ struct entry_t* entry_dup( struct entry_t* p_entry )
         return NULL;
 
     struct entry_t* p_entry_copy;
-    if ( !(p_entry_copy = (struct entry_t*)malloc( sizeof( struct entry_t ) )) )
+    if ( !(p_entry_copy = (struct entry_t*)slab_alloc( sizeof( struct entry_t ) )) )
         return NULL;
 
-    char* p_key_copy;
-    if ( !(p_key_copy = (char*)malloc( (strlen( p_entry->key ) + 1) * sizeof( char ) )) ) return NULL;
-
-    strcpy( p_key_copy, p_entry->key );
+    char* p_key_copy = NULL;
+    if ( p_entry->key )
+    {
+        // Binary keys can hold '\0': copy keysize bytes and terminate the copy.
+        if ( !(p_key_copy = (char*)slab_alloc( p_entry->keysize + 1 )) )
+        {
+            slab_free( p_entry_copy );
+            return NULL;
+        }
+
+        memcpy( p_key_copy, p_entry->key, p_entry->keysize );
+        p_key_copy[p_entry->keysize] = '\0';
+    }
 
-    p_entry_copy->key = p_entry->key ? p_key_copy : NULL;
+    entry_key_set( p_entry_copy, p_key_copy, p_entry->keysize );
     p_entry_copy->value = data_dup( p_entry->value );
 
     return p_entry_copy;
@@ -55,11 +71,11 @@ void entry_replace( struct entry_t* p_entry, char* p_new_key, struct data_t* p_n
         return;
 
     // frees old items
-    if ( p_entry->key ) free( p_entry->key );
+    if ( p_entry->key ) slab_free( p_entry->key );
     data_destroy( p_entry->value );
 
     // replaces items
-    p_entry->key = p_new_key;
+    entry_key_set( p_entry, p_new_key, p_new_key ? strlen( p_new_key ) : 0 );
     p_entry->value = p_new_value;
 }
 
@@ -81,8 +97,11 @@ int entry_compare( struct entry_t* p_entry1, struct entry_t* p_entry2 )
     if ( p_entry1->key && !p_entry2->key )
         return 1;
 
-    // Compare datas.
-    // strcmp returns 0 if both parameters are NULL
-    int compare_value = strcmp( p_entry1->key, p_entry2->key );
+    // Both keys NULL.
+    if ( !p_entry1->key )
+        return 0;
+
+    // Compare keys.
+    int compare_value = entry_key_compare( p_entry1, p_entry2 );
     return compare_value == 0 ? compare_value : (compare_value > 0 ? 1 : -1);
 }
\ No newline at end of file
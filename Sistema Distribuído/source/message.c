@@ -89,6 +89,41 @@ size_t write_all(int sockfd, char *p_buffer, size_t len)
     return buffer_size;
 }
 
+void message_destroy( struct message_t *p_msg )
+{
+    if ( !p_msg )
+        return;
+
+    // The data buffer belongs to the value reference, not to the message.
+    if ( p_msg->p_value_ref )
+    {
+        p_msg->p_MessageT->data.data = NULL;
+        p_msg->p_MessageT->data.len = 0;
+        data_destroy( p_msg->p_value_ref );
+    }
+
+    message_t__free_unpacked( p_msg->p_MessageT, NULL );
+    free( p_msg );
+}
+
+char *message_key_dup( ProtobufCBinaryData *p_key )
+{
+    char *p_key_copy;
+
+    if ( !(p_key_copy = (char *)malloc( p_key->len + 1 )) )
+    {
+        fprintf(stderr, "%s : error allocating memory for the key.\n", strerror(errno));
+        return NULL;
+    }
+
+    if ( p_key->len )
+        memcpy( p_key_copy, p_key->data, p_key->len );
+
+    p_key_copy[p_key->len] = '\0';
+
+    return p_key_copy;
+}
+
 const char *opcode_name( int opcode_value )
 {
 #define NAME(OPCODE) case OPCODE: return #OPCODE;
@@ -103,6 +138,13 @@ const char *opcode_name( int opcode_value )
         NAME(OP_GETVALUES)
         NAME(OP_VERIFY)
         NAME(OP_ERROR)
+        NAME(OP_GETKEYAT)
+        NAME(OP_GETRANK)
+        NAME(OP_GETKEYSPAGE)
+        NAME(OP_SCAN)
+        NAME(OP_SCANPREFIX)
+        NAME(OP_BULKLOAD)
+        NAME(OP_PUTBATCH)
         default:
             return "UNKNOWN_OPCODE";
     }
@@ -121,6 +163,7 @@ const char *ctype_name( int ctype_value )
         NAME(CT_VALUES)
         NAME(CT_RESULT)
         NAME(CT_NONE)
+        NAME(CT_ENTRIES)
         default:
             return "UNKNOWN_CTYPE";
     }
@@ -153,7 +196,7 @@ void print_message( struct message_t *p_msg, unsigned int is_received_msg )
     switch ( c_type )
     {
         case CT_KEY:
-            printf("%s", p_msg->p_MessageT->key);
+            printf("%.*s", (int)p_msg->p_MessageT->key.len, (char *)p_msg->p_MessageT->key.data);
             break;
         case CT_RESULT:
             printf("%d", p_msg->p_MessageT->result);
@@ -169,7 +212,7 @@ void print_message( struct message_t *p_msg, unsigned int is_received_msg )
             break;
         }
         case CT_ENTRY:
-            printf("[key: %s ", p_msg->p_MessageT->entry->key);
+            printf("[key: %.*s ", (int)p_msg->p_MessageT->entry->key.len, (char *)p_msg->p_MessageT->entry->key.data);
 
             ProtobufCBinaryData data_temp = p_msg->p_MessageT->entry->data;
             char *p_str = malloc( sizeof( char ) * (data_temp.len + 1 ) );
@@ -183,16 +226,32 @@ void print_message( struct message_t *p_msg, unsigned int is_received_msg )
         case CT_KEYS:
         {
             printf("<KEYS_BELOW>\n");
-            for( int i = 0; i < p_msg->p_MessageT->n_keys; i++ )
+            for( size_t i = 0; i < p_msg->p_MessageT->n_keys; i++ )
             {
-                printf("%s\n", p_msg->p_MessageT->keys[i] );
+                printf("%.*s\n", (int)p_msg->p_MessageT->keys[i].len, (char *)p_msg->p_MessageT->keys[i].data );
+            }
+            break;
+        }
+        case CT_ENTRIES:
+        {
+            printf("<ENTRIES_BELOW>\n");
+            for( size_t i = 0; i < p_msg->p_MessageT->n_entries; i++ )
+            {
+                MessageT__Entry *p_entry_temp = p_msg->p_MessageT->entries[i];
+
+                char *p_str = malloc( sizeof( char ) * (p_entry_temp->data.len + 1 ) );
+                p_str[p_entry_temp->data.len] = '\0';
+                memcpy(p_str, p_entry_temp->data.data, p_entry_temp->data.len);
+                printf("[key: %.*s {datasize: %zu; data: %s}]\n", (int)p_entry_temp->key.len, (char *)p_entry_temp->key.data,
+                       p_entry_temp->data.len, p_str );
+                free(p_str);
             }
             break;
         }
         case CT_VALUES:
         {
             printf("<VALUES_BELOW>\n");
-            for( int i = 0; i < p_msg->p_MessageT->n_datas; i++ )
+            for( size_t i = 0; i < p_msg->p_MessageT->n_datas; i++ )
             {
                 ProtobufCBinaryData *p_data_temp = &p_msg->p_MessageT->datas[i];
 
@@ -80,6 +80,8 @@ int network_main_loop( int listening_sockfd )
 
     struct pollfd connections[NFDESC];
     int socket_ids[NFDESC];
+    // Bulk load being received on each connection (see imvoke2).
+    struct bulk_load_t bulk_loads[NFDESC];
     int nfds, kfds, i;
 
     struct sockaddr_in client;
@@ -88,6 +90,7 @@ int network_main_loop( int listening_sockfd )
 
     // Initialize array of connections.
     memset( connections, 0, sizeof( connections ));
+    memset( bulk_loads, 0, sizeof( bulk_loads ));
 
     for ( i = 1; i < NFDESC; i++ )
     {
@@ -152,17 +155,15 @@ int network_main_loop( int listening_sockfd )
                 if ( p_msg->p_MessageT->opcode == OP_BAD )
                 {
                     printf( "Connection with client closed.\n" );
-                    message_t__free_unpacked( p_msg->p_MessageT, NULL);
-                    free( p_msg );
+                    message_destroy( p_msg );
                     goto connection_close;
                 }
 
                 // Invoke message received
-                if ( imvoke( p_msg ) < 0 )
+                if ( imvoke2( p_msg, &bulk_loads[i] ) < 0 )
                 {
                     fprintf( stderr, "%s : error invoking received message command.\n", strerror(errno));
-                    message_t__free_unpacked( p_msg->p_MessageT, NULL);
-                    free( p_msg );
+                    message_destroy( p_msg );
                     goto connection_close;
                 }
 
@@ -170,15 +171,13 @@ int network_main_loop( int listening_sockfd )
                 if ( network_send( connections[i].fd, p_msg ) < 0 )
                 {
                     fprintf( stderr, "%s : error sending response to client.\n", strerror(errno));
-                    message_t__free_unpacked( p_msg->p_MessageT, NULL);
-                    free( p_msg );
+                    message_destroy( p_msg );
                     goto connection_close;
                 }
 
                 // Print sent message
                 print_message( p_msg, 0 );
-                message_t__free_unpacked( p_msg->p_MessageT, NULL);
-                free( p_msg );
+                message_destroy( p_msg );
             }
         }
         // Connection closed.
@@ -192,6 +191,9 @@ int network_main_loop( int listening_sockfd )
 
             close( connections[i].fd );
 
+            // A bulk load the client didn't finish is discarded.
+            bulk_load_clear( &bulk_loads[i] );
+
             int current_socket_number = socket_ids[i];
 
             // Remove connection from array. Shift all connections after it.
@@ -199,15 +201,20 @@ int network_main_loop( int listening_sockfd )
             {
                 connections[j] = connections[j + 1];
                 socket_ids[j] = socket_ids[j + 1];
+                bulk_loads[j] = bulk_loads[j + 1];
             }
 
             connections[NFDESC - 1].fd = -1;
             socket_ids[NFDESC - 1] = current_socket_number;
+            memset( &bulk_loads[NFDESC - 1], 0, sizeof( struct bulk_load_t ));
             nfds--;
         }
 
     }
 
+    for ( i = 1; i < nfds; i++ )
+        bulk_load_clear( &bulk_loads[i] );
+
     return 0;
 }
 
@@ -261,6 +268,7 @@ struct message_t *network_receive( int client_sockfd )
         return NULL;
 
     p_msg->p_MessageT = p_MessageT;
+    p_msg->p_value_ref = NULL;
 
     return p_msg;
 }
@@ -64,11 +64,11 @@ static const ProtobufCFieldDescriptor message_t__entry__field_descriptors[2] =
     "key",
     1,
     PROTOBUF_C_LABEL_NONE,
-    PROTOBUF_C_TYPE_STRING,
+    PROTOBUF_C_TYPE_BYTES,
     0,   /* quantifier_offset */
     offsetof(MessageT__Entry, key),
     NULL,
-    &protobuf_c_empty_string,
+    NULL,
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
@@ -109,7 +109,7 @@ const ProtobufCMessageDescriptor message_t__entry__descriptor =
   (ProtobufCMessageInit) message_t__entry__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCEnumValue message_t__opcode__enum_values_by_number[10] =
+static const ProtobufCEnumValue message_t__opcode__enum_values_by_number[17] =
 {
   { "OP_BAD", "MESSAGE_T__OPCODE__OP_BAD", 0 },
   { "OP_SIZE", "MESSAGE_T__OPCODE__OP_SIZE", 10 },
@@ -121,20 +121,34 @@ static const ProtobufCEnumValue message_t__opcode__enum_values_by_number[10] =
   { "OP_GETVALUES", "MESSAGE_T__OPCODE__OP_GETVALUES", 70 },
   { "OP_VERIFY", "MESSAGE_T__OPCODE__OP_VERIFY", 80 },
   { "OP_ERROR", "MESSAGE_T__OPCODE__OP_ERROR", 99 },
+  { "OP_GETKEYAT", "MESSAGE_T__OPCODE__OP_GETKEYAT", 100 },
+  { "OP_GETRANK", "MESSAGE_T__OPCODE__OP_GETRANK", 110 },
+  { "OP_GETKEYSPAGE", "MESSAGE_T__OPCODE__OP_GETKEYSPAGE", 120 },
+  { "OP_SCAN", "MESSAGE_T__OPCODE__OP_SCAN", 130 },
+  { "OP_SCANPREFIX", "MESSAGE_T__OPCODE__OP_SCANPREFIX", 140 },
+  { "OP_BULKLOAD", "MESSAGE_T__OPCODE__OP_BULKLOAD", 150 },
+  { "OP_PUTBATCH", "MESSAGE_T__OPCODE__OP_PUTBATCH", 160 },
 };
 static const ProtobufCIntRange message_t__opcode__value_ranges[] = {
-{0, 0},{10, 1},{20, 2},{30, 3},{40, 4},{50, 5},{60, 6},{70, 7},{80, 8},{99, 9},{0, 10}
+{0, 0},{10, 1},{20, 2},{30, 3},{40, 4},{50, 5},{60, 6},{70, 7},{80, 8},{99, 9},{110, 11},{120, 12},{130, 13},{140, 14},{150, 15},{160, 16},{0, 17}
 };
-static const ProtobufCEnumValueIndex message_t__opcode__enum_values_by_name[10] =
+static const ProtobufCEnumValueIndex message_t__opcode__enum_values_by_name[17] =
 {
   { "OP_BAD", 0 },
+  { "OP_BULKLOAD", 15 },
   { "OP_DEL", 3 },
   { "OP_ERROR", 9 },
   { "OP_GET", 4 },
+  { "OP_GETKEYAT", 10 },
   { "OP_GETKEYS", 6 },
+  { "OP_GETKEYSPAGE", 12 },
+  { "OP_GETRANK", 11 },
   { "OP_GETVALUES", 7 },
   { "OP_HEIGHT", 2 },
   { "OP_PUT", 5 },
+  { "OP_PUTBATCH", 16 },
+  { "OP_SCAN", 13 },
+  { "OP_SCANPREFIX", 14 },
   { "OP_SIZE", 1 },
   { "OP_VERIFY", 8 },
 };
@@ -145,15 +159,15 @@ const ProtobufCEnumDescriptor message_t__opcode__descriptor =
   "Opcode",
   "MessageT__Opcode",
   "",
-  10,
+  17,
   message_t__opcode__enum_values_by_number,
-  10,
+  17,
   message_t__opcode__enum_values_by_name,
-  10,
+  16,
   message_t__opcode__value_ranges,
   NULL,NULL,NULL,NULL   /* reserved[1234] */
 };
-static const ProtobufCEnumValue message_t__c_type__enum_values_by_number[8] =
+static const ProtobufCEnumValue message_t__c_type__enum_values_by_number[9] =
 {
   { "CT_BAD", "MESSAGE_T__C_TYPE__CT_BAD", 0 },
   { "CT_KEY", "MESSAGE_T__C_TYPE__CT_KEY", 10 },
@@ -163,13 +177,15 @@ static const ProtobufCEnumValue message_t__c_type__enum_values_by_number[8] =
   { "CT_VALUES", "MESSAGE_T__C_TYPE__CT_VALUES", 50 },
   { "CT_RESULT", "MESSAGE_T__C_TYPE__CT_RESULT", 60 },
   { "CT_NONE", "MESSAGE_T__C_TYPE__CT_NONE", 70 },
+  { "CT_ENTRIES", "MESSAGE_T__C_TYPE__CT_ENTRIES", 80 },
 };
 static const ProtobufCIntRange message_t__c_type__value_ranges[] = {
-{0, 0},{10, 1},{20, 2},{30, 3},{40, 4},{50, 5},{60, 6},{70, 7},{0, 8}
+{0, 0},{10, 1},{20, 2},{30, 3},{40, 4},{50, 5},{60, 6},{70, 7},{80, 8},{0, 9}
 };
-static const ProtobufCEnumValueIndex message_t__c_type__enum_values_by_name[8] =
+static const ProtobufCEnumValueIndex message_t__c_type__enum_values_by_name[9] =
 {
   { "CT_BAD", 0 },
+  { "CT_ENTRIES", 8 },
   { "CT_ENTRY", 3 },
   { "CT_KEY", 1 },
   { "CT_KEYS", 4 },
@@ -185,15 +201,15 @@ const ProtobufCEnumDescriptor message_t__c_type__descriptor =
   "C_type",
   "MessageT__CType",
   "",
-  8,
+  9,
   message_t__c_type__enum_values_by_number,
-  8,
+  9,
   message_t__c_type__enum_values_by_name,
-  8,
+  9,
   message_t__c_type__value_ranges,
   NULL,NULL,NULL,NULL   /* reserved[1234] */
 };
-static const ProtobufCFieldDescriptor message_t__field_descriptors[8] =
+static const ProtobufCFieldDescriptor message_t__field_descriptors[12] =
 {
   {
     "opcode",
@@ -223,11 +239,11 @@ static const ProtobufCFieldDescriptor message_t__field_descriptors[8] =
     "key",
     3,
     PROTOBUF_C_LABEL_NONE,
-    PROTOBUF_C_TYPE_STRING,
+    PROTOBUF_C_TYPE_BYTES,
     0,   /* quantifier_offset */
     offsetof(MessageT, key),
     NULL,
-    &protobuf_c_empty_string,
+    NULL,
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
@@ -235,11 +251,11 @@ static const ProtobufCFieldDescriptor message_t__field_descriptors[8] =
     "keys",
     4,
     PROTOBUF_C_LABEL_REPEATED,
-    PROTOBUF_C_TYPE_STRING,
+    PROTOBUF_C_TYPE_BYTES,
     offsetof(MessageT, n_keys),
     offsetof(MessageT, keys),
     NULL,
-    &protobuf_c_empty_string,
+    NULL,
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
@@ -291,21 +307,73 @@ static const ProtobufCFieldDescriptor message_t__field_descriptors[8] =
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "offset",
+    9,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT32,
+    0,   /* quantifier_offset */
+    offsetof(MessageT, offset),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "limit",
+    10,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT32,
+    0,   /* quantifier_offset */
+    offsetof(MessageT, limit),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "end_key",
+    11,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_BYTES,
+    0,   /* quantifier_offset */
+    offsetof(MessageT, end_key),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "entries",
+    12,
+    PROTOBUF_C_LABEL_REPEATED,
+    PROTOBUF_C_TYPE_MESSAGE,
+    offsetof(MessageT, n_entries),
+    offsetof(MessageT, entries),
+    &message_t__entry__descriptor,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned message_t__field_indices_by_name[] = {
   1,   /* field[1] = c_type */
   4,   /* field[4] = data */
   5,   /* field[5] = datas */
+  10,   /* field[10] = end_key */
+  11,   /* field[11] = entries */
   6,   /* field[6] = entry */
   2,   /* field[2] = key */
   3,   /* field[3] = keys */
+  9,   /* field[9] = limit */
+  8,   /* field[8] = offset */
   0,   /* field[0] = opcode */
   7,   /* field[7] = result */
 };
 static const ProtobufCIntRange message_t__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 8 }
+  { 0, 12 }
 };
 const ProtobufCMessageDescriptor message_t__descriptor =
 {
@@ -315,7 +383,7 @@ const ProtobufCMessageDescriptor message_t__descriptor =
   "MessageT",
   "",
   sizeof(MessageT),
-  8,
+  12,
   message_t__field_descriptors,
   message_t__field_indices_by_name,
   1,  message_t__number_ranges,
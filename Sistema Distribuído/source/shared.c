@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <limits.h>
 
+#include "tree.h"
+
 short parse_port(char *p_input_str)
 {
     char *p_additional_chars = NULL;
@@ -56,4 +58,26 @@ int parse_int(char *p_input_str)
     }
 
     return (int) parsed_int;
-}
\ No newline at end of file
+}
+
+int parse_tree_type( char *p_input_str )
+{
+    if ( strcmp( p_input_str, "bst" ) == 0 )
+        return TREE_BST;
+
+    if ( strcmp( p_input_str, "avl" ) == 0 )
+        return TREE_AVL | TREE_HASH_INDEX;
+
+    if ( strcmp( p_input_str, "art" ) == 0 )
+        return TREE_ART;
+
+    if ( strcmp( p_input_str, "bptree" ) == 0 )
+        return TREE_BPLUS;
+
+    if ( strcmp( p_input_str, "cow" ) == 0 )
+        return TREE_COW;
+
+    errno = EINVAL;
+    fprintf( stderr, "%s : <tree_type> must be bst, avl, art, bptree or cow: %s \n", strerror( errno ), p_input_str );
+    return -1;
+}
@@ -0,0 +1,355 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "slab.h"
+
+/*
+ * Header at the start of every page. The rest of the page is cut in blocks of the page size class.
+ */
+struct slab_page_t
+{
+    int class_index;
+};
+
+/*
+ * Free block. The link is kept inside the block itself.
+ */
+struct slab_block_t
+{
+    struct slab_block_t *p_next;
+};
+
+/*
+ * Free blocks of one size class.
+ */
+struct slab_free_list_t
+{
+    struct slab_block_t *p_head;
+    size_t count;
+};
+
+/*
+ * Counters of one thread not yet added to g_slab_stats.
+ */
+struct slab_thread_stats_t
+{
+    size_t allocs[SLAB_N_CLASSES];
+    size_t frees[SLAB_N_CLASSES];
+    size_t large_allocs;
+    size_t large_frees;
+};
+
+static const size_t g_SLAB_CLASS_SIZES[SLAB_N_CLASSES] = { 16, 32, 48, 64, 96, 128, 160, 192, 256 };
+
+// Reserved region. Pages are carved from it with a bump pointer.
+static char *gp_slab_region = NULL;
+static size_t g_slab_region_used = 0;
+static pthread_once_t g_slab_region_once = PTHREAD_ONCE_INIT;
+
+// Global free lists, protected by g_slab_lock.
+static pthread_mutex_t g_slab_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct slab_free_list_t g_slab_free_lists[SLAB_N_CLASSES];
+
+// Totals of the counters folded so far, protected by g_slab_lock.
+static struct slab_stats_t g_slab_stats;
+
+// Per thread cache and counters.
+static __thread struct slab_free_list_t g_slab_thread_cache[SLAB_N_CLASSES];
+static __thread struct slab_thread_stats_t g_slab_thread_stats;
+
+static void slab_region_init()
+{
+    // Over-reserve one page so the region can be aligned to SLAB_PAGE_SIZE.
+    void *p_region = mmap( NULL, SLAB_REGION_SIZE + SLAB_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+
+    // Without a region every request is served by malloc.
+    if ( p_region == MAP_FAILED )
+        return;
+
+    uintptr_t aligned = ((uintptr_t)p_region + SLAB_PAGE_SIZE - 1) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1);
+    gp_slab_region = (char *)aligned;
+}
+
+static int slab_class_index( size_t size )
+{
+    for ( int i = 0; i < SLAB_N_CLASSES; i++ )
+    {
+        if ( size <= g_SLAB_CLASS_SIZES[i] )
+            return i;
+    }
+
+    return -1;
+}
+
+static int slab_owns( void *p_block )
+{
+    return gp_slab_region && (char *)p_block >= gp_slab_region &&
+           (char *)p_block < gp_slab_region + SLAB_REGION_SIZE;
+}
+
+/*
+ * Adds the counters of the calling thread to g_slab_stats and resets them. Must hold g_slab_lock.
+ */
+static void slab_thread_stats_fold()
+{
+    struct slab_thread_stats_t *p_local = &g_slab_thread_stats;
+
+    for ( int i = 0; i < SLAB_N_CLASSES; i++ )
+    {
+        g_slab_stats.classes[i].allocs += p_local->allocs[i];
+        g_slab_stats.classes[i].frees += p_local->frees[i];
+    }
+
+    g_slab_stats.large_allocs += p_local->large_allocs;
+    g_slab_stats.large_frees += p_local->large_frees;
+
+    memset( p_local, 0, sizeof( *p_local ) );
+}
+
+/*
+ * Folds the counters of the calling thread once they count a batch of large blocks, which never go through the
+ * thread cache (and so never fold on a refill or release).
+ */
+static void slab_thread_stats_fold_large()
+{
+    if ( g_slab_thread_stats.large_allocs + g_slab_thread_stats.large_frees < SLAB_CACHE_BATCH )
+        return;
+
+    pthread_mutex_lock( &g_slab_lock );
+    slab_thread_stats_fold();
+    pthread_mutex_unlock( &g_slab_lock );
+}
+
+/*
+ * Carves a new page for a size class and adds its blocks to the global free list. Must hold g_slab_lock.
+ */
+static int slab_page_carve( int class_index )
+{
+    if ( !gp_slab_region || g_slab_region_used + SLAB_PAGE_SIZE > SLAB_REGION_SIZE )
+        return -1;
+
+    struct slab_page_t *p_page = (struct slab_page_t *)(gp_slab_region + g_slab_region_used);
+    g_slab_region_used += SLAB_PAGE_SIZE;
+
+    p_page->class_index = class_index;
+
+    size_t block_size = g_SLAB_CLASS_SIZES[class_index];
+    struct slab_free_list_t *p_list = &g_slab_free_lists[class_index];
+
+    // First block starts after the header, keeping the blocks 16 byte aligned.
+    for ( size_t offset = 16; offset + block_size <= SLAB_PAGE_SIZE; offset += block_size )
+    {
+        struct slab_block_t *p_block = (struct slab_block_t *)((char *)p_page + offset);
+        p_block->p_next = p_list->p_head;
+        p_list->p_head = p_block;
+        p_list->count++;
+    }
+
+    g_slab_stats.classes[class_index].pages++;
+
+    return 0;
+}
+
+/*
+ * Moves up to SLAB_CACHE_BATCH blocks from the global free list to the thread cache, folding the thread counters.
+ */
+static void slab_cache_refill( int class_index )
+{
+    struct slab_free_list_t *p_cache = &g_slab_thread_cache[class_index];
+    struct slab_free_list_t *p_list = &g_slab_free_lists[class_index];
+
+    pthread_mutex_lock( &g_slab_lock );
+
+    if ( p_list->count < SLAB_CACHE_BATCH )
+        slab_page_carve( class_index );
+
+    for ( int i = 0; i < SLAB_CACHE_BATCH && p_list->p_head; i++ )
+    {
+        struct slab_block_t *p_block = p_list->p_head;
+        p_list->p_head = p_block->p_next;
+        p_list->count--;
+
+        p_block->p_next = p_cache->p_head;
+        p_cache->p_head = p_block;
+        p_cache->count++;
+    }
+
+    slab_thread_stats_fold();
+
+    pthread_mutex_unlock( &g_slab_lock );
+}
+
+/*
+ * Moves n blocks from the thread cache back to the global free list, folding the thread counters.
+ */
+static void slab_cache_release( int class_index, size_t n )
+{
+    struct slab_free_list_t *p_cache = &g_slab_thread_cache[class_index];
+    struct slab_free_list_t *p_list = &g_slab_free_lists[class_index];
+
+    pthread_mutex_lock( &g_slab_lock );
+
+    for ( size_t i = 0; i < n && p_cache->p_head; i++ )
+    {
+        struct slab_block_t *p_block = p_cache->p_head;
+        p_cache->p_head = p_block->p_next;
+        p_cache->count--;
+
+        p_block->p_next = p_list->p_head;
+        p_list->p_head = p_block;
+        p_list->count++;
+    }
+
+    slab_thread_stats_fold();
+
+    pthread_mutex_unlock( &g_slab_lock );
+}
+
+void *slab_alloc( size_t size )
+{
+    int class_index = slab_class_index( size );
+
+    pthread_once( &g_slab_region_once, slab_region_init );
+
+    if ( class_index >= 0 )
+    {
+        struct slab_free_list_t *p_cache = &g_slab_thread_cache[class_index];
+
+        if ( !p_cache->p_head )
+            slab_cache_refill( class_index );
+
+        struct slab_block_t *p_block = p_cache->p_head;
+
+        if ( p_block )
+        {
+            p_cache->p_head = p_block->p_next;
+            p_cache->count--;
+
+            g_slab_thread_stats.allocs[class_index]++;
+            return p_block;
+        }
+    }
+
+    // Too big for a size class or region exhausted.
+    g_slab_thread_stats.large_allocs++;
+    slab_thread_stats_fold_large();
+
+    return malloc( size );
+}
+
+void *slab_calloc( size_t size )
+{
+    void *p_block = slab_alloc( size );
+
+    if ( p_block )
+        memset( p_block, 0, size );
+
+    return p_block;
+}
+
+char *slab_strdup( const char *p_str )
+{
+    if ( !p_str )
+        return NULL;
+
+    size_t size = strlen( p_str ) + 1;
+    char *p_copy = (char *)slab_alloc( size );
+
+    if ( p_copy )
+        memcpy( p_copy, p_str, size );
+
+    return p_copy;
+}
+
+void slab_free( void *p_block )
+{
+    if ( !p_block )
+        return;
+
+    // Not a slab block.
+    if ( !slab_owns( p_block ) )
+    {
+        g_slab_thread_stats.large_frees++;
+        slab_thread_stats_fold_large();
+
+        free( p_block );
+        return;
+    }
+
+    struct slab_page_t *p_page = (struct slab_page_t *)((uintptr_t)p_block & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+    int class_index = p_page->class_index;
+    struct slab_free_list_t *p_cache = &g_slab_thread_cache[class_index];
+
+    struct slab_block_t *p_free_block = (struct slab_block_t *)p_block;
+    p_free_block->p_next = p_cache->p_head;
+    p_cache->p_head = p_free_block;
+    p_cache->count++;
+
+    g_slab_thread_stats.frees[class_index]++;
+
+    // Keep the cache bounded: give a batch back once it holds two.
+    if ( p_cache->count >= 2 * SLAB_CACHE_BATCH )
+        slab_cache_release( class_index, SLAB_CACHE_BATCH );
+}
+
+int slab_contains( const void *p_block, size_t size )
+{
+    return slab_owns( (void *)p_block ) && size <= SLAB_REGION_SIZE &&
+           (const char *)p_block - gp_slab_region <= (ptrdiff_t)(SLAB_REGION_SIZE - size);
+}
+
+void slab_thread_cache_flush()
+{
+    for ( int i = 0; i < SLAB_N_CLASSES; i++ )
+        slab_cache_release( i, g_slab_thread_cache[i].count );
+}
+
+void slab_get_stats( struct slab_stats_t *p_stats )
+{
+    if ( !p_stats )
+        return;
+
+    pthread_mutex_lock( &g_slab_lock );
+
+    // The counters of the calling thread are current; those of other threads are added on their next fold.
+    slab_thread_stats_fold();
+
+    for ( int i = 0; i < SLAB_N_CLASSES; i++ )
+    {
+        p_stats->classes[i].block_size = g_SLAB_CLASS_SIZES[i];
+        p_stats->classes[i].pages = g_slab_stats.classes[i].pages;
+        p_stats->classes[i].allocs = g_slab_stats.classes[i].allocs;
+        p_stats->classes[i].frees = g_slab_stats.classes[i].frees;
+    }
+
+    p_stats->large_allocs = g_slab_stats.large_allocs;
+    p_stats->large_frees = g_slab_stats.large_frees;
+    p_stats->region_used = g_slab_region_used;
+
+    pthread_mutex_unlock( &g_slab_lock );
+}
+
+void slab_print_stats( FILE *p_stream )
+{
+    struct slab_stats_t stats;
+    slab_get_stats( &stats );
+
+    fprintf( p_stream, "Slab allocator statistics:\n" );
+    fprintf( p_stream, "%10s %8s %12s %12s %12s\n", "block size", "pages", "allocs", "frees", "in use" );
+
+    for ( int i = 0; i < SLAB_N_CLASSES; i++ )
+    {
+        struct slab_class_stats_t *p_class = &stats.classes[i];
+
+        fprintf( p_stream, "%10zu %8zu %12zu %12zu %12zu\n", p_class->block_size, p_class->pages,
+                 p_class->allocs, p_class->frees, p_class->allocs - p_class->frees );
+    }
+
+    fprintf( p_stream, "Large allocs: %zu; non slab frees: %zu; region used: %zu KB\n",
+             stats.large_allocs, stats.large_frees, stats.region_used / 1024 );
+}
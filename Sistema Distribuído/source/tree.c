@@ -1,13 +1,34 @@
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "tree.h"
 #include "tree-private.h"
 #include "entry.h"
+#include "entry-private.h"
+#include "tree_index-private.h"
+#include "tree_art-private.h"
+#include "tree_bptree-private.h"
+#include "tree_cow-private.h"
+#include "slab.h"
 
 struct tree_t* tree_create()
 {
+    return tree_create2( TREE_BST );
+}
+
+struct tree_t* tree_create2( int type )
+{
+    int engine = type & ~TREE_HASH_INDEX;
+
+    if ( engine != TREE_BST && engine != TREE_AVL && engine != TREE_ART && engine != TREE_BPLUS && engine != TREE_COW )
+        return NULL;
+
+    // The hash index points at node_t nodes.
+    if ( !TREE_USES_NODES( engine ) && (type & TREE_HASH_INDEX) )
+        return NULL;
+
     struct tree_t* p_new_tree = NULL;
 
     if ( !(p_new_tree = (struct tree_t*)malloc( sizeof( struct tree_t ) )) )
@@ -15,6 +36,18 @@ struct tree_t* tree_create()
 
     p_new_tree->size = 0;
     p_new_tree->p_root = NULL;
+    p_new_tree->p_art_root = NULL;
+    p_new_tree->p_bpt_root = NULL;
+    p_new_tree->p_cow = NULL;
+    p_new_tree->type = engine;
+    p_new_tree->p_index = NULL;
+
+    if ( ((type & TREE_HASH_INDEX) && !(p_new_tree->p_index = tree_index_create())) ||
+         (engine == TREE_COW && !(p_new_tree->p_cow = tree_cow_create())) )
+    {
+        free( p_new_tree );
+        return NULL;
+    }
 
     return p_new_tree;
 }
@@ -25,320 +58,1379 @@ void tree_destroy( struct tree_t* p_tree )
         return;
 
     if ( p_tree->p_root )
-        node_destroy_recursive( p_tree->p_root );
+        node_destroy_subtree( p_tree->p_root );
 
+    tree_art_destroy( p_tree->p_art_root );
+    tree_bpt_destroy( p_tree->p_bpt_root );
+    tree_cow_destroy( p_tree->p_cow );
+    tree_index_destroy( p_tree->p_index );
 
     free( p_tree );
 }
 
-struct node_t* node_create( struct entry_t* p_entry )
+struct node_t* node_create( char* p_key, size_t keysize, struct data_t* p_value )
 {
     struct node_t* p_node = NULL;
 
-    if ( !(p_node = (struct node_t*)malloc( sizeof( struct node_t ) )) )
+    if ( !(p_node = (struct node_t*)slab_alloc( sizeof( struct node_t ) )) )
         return NULL;
 
-    p_node->p_entry = p_entry;
     p_node->p_left = NULL;
     p_node->p_right = NULL;
+    p_node->height = 1;
+    p_node->size = 1;
+
+    entry_key_set( &p_node->entry, NULL, 0 );
+    p_node->entry.value = &p_node->value;
+    p_node->value.datasize = 0;
+    p_node->value.refcount = 0;
+    p_node->value.data = p_node->value_inline;
+
+    if ( node_set_key( p_node, p_key, keysize ) < 0 || node_set_value( p_node, p_value ) < 0 )
+    {
+        node_destroy( p_node );
+        return NULL;
+    }
 
     return p_node;
 }
 
-void node_destroy( struct node_t* p_node )
+int node_set_key( struct node_t* p_node, char* p_key, size_t keysize )
 {
-    if ( p_node )
-    {
-        if ( p_node->p_entry )
-            entry_destroy( p_node->p_entry );
+    char* p_new_key = p_node->key_inline;
 
-        free( p_node );
-    }
+    // Long keys are kept out of the node. The copy is always '\0' terminated.
+    if ( keysize + 1 > NODE_INLINE_KEY_SIZE && !(p_new_key = (char*)slab_alloc( keysize + 1 )) )
+        return -1;
+
+    memcpy( p_new_key, p_key, keysize );
+    p_new_key[keysize] = '\0';
+
+    if ( p_node->entry.key != p_node->key_inline )
+        slab_free( p_node->entry.key );
+
+    entry_key_set( &p_node->entry, p_new_key, keysize );
+
+    return 0;
 }
 
-void node_destroy_recursive( struct node_t* p_node )
+int node_set_value( struct node_t* p_node, struct data_t* p_value )
 {
-    if ( !p_node )
-        return;
+    if ( !p_value || p_value->datasize <= 0 || !p_value->data )
+        return -1;
+
+    struct data_t* p_old_value = p_node->entry.value;
+
+    // Big values are kept out of the node, on a data_t that tree_get shares instead of copying.
+    if ( (size_t)p_value->datasize > NODE_INLINE_VALUE_SIZE )
+    {
+        struct data_t* p_new_value = NULL;
 
-    if ( !p_node->p_entry )
-        entry_destroy( p_node->p_entry );
+        if ( !(p_new_value = data_share( p_value )) )
+            return -1;
 
-    node_destroy_recursive( p_node->p_left );
-    node_destroy_recursive( p_node->p_right );
+        p_node->entry.value = p_new_value;
+    }
+    else
+    {
+        memcpy( p_node->value_inline, p_value->data, p_value->datasize );
+        p_node->value.datasize = p_value->datasize;
+        p_node->entry.value = &p_node->value;
+    }
 
-    free( p_node );
+    // Readers may still hold a reference to the old value.
+    if ( p_old_value != &p_node->value )
+        data_destroy( p_old_value );
+
+    return 0;
 }
 
-int tree_put( struct tree_t* p_tree, char* p_key, struct data_t* p_value )
+void node_destroy( struct node_t* p_node )
 {
-    if ( !p_tree || !p_key || !p_value )
-        return -1;
+    if ( p_node )
+    {
+        // Only out of line keys/values were allocated apart from the node.
+        if ( p_node->entry.key != p_node->key_inline )
+            slab_free( p_node->entry.key );
 
-    char* p_key_dup = strdup( p_key );
-    struct data_t* p_value_copy = data_dup( p_value );
+        if ( p_node->entry.value != &p_node->value )
+            data_destroy( p_node->entry.value );
 
-    struct node_t** pp_next_node = &p_tree->p_root;
-    struct node_t* p_current_node = p_tree->p_root;
+        slab_free( p_node );
+    }
+}
 
-    while ( p_current_node )
+void node_destroy_subtree( struct node_t* p_node )
+{
+    while ( p_node )
     {
-        int compare_value = strcmp( p_key_dup, p_current_node->p_entry->key );
+        struct node_t* p_left_node = p_node->p_left;
 
-        // Left branch.
-        if ( compare_value < 0 )
-        {
-            pp_next_node = &p_current_node->p_left;
-            p_current_node = p_current_node->p_left;
-        }
-            // Right branch.
-        else if ( compare_value > 0 )
+        // Rotate the left child up until the node has none; then it can go, and its right subtree is next.
+        if ( p_left_node )
         {
-            pp_next_node = &p_current_node->p_right;
-            p_current_node = p_current_node->p_right;
+            p_node->p_left = p_left_node->p_right;
+            p_left_node->p_right = p_node;
+            p_node = p_left_node;
         }
-            // Node with same key.
         else
         {
-            entry_replace( p_current_node->p_entry, p_key_dup, p_value_copy );
-            return 0;
+            struct node_t* p_right_node = p_node->p_right;
+
+            node_destroy( p_node );
+            p_node = p_right_node;
         }
     }
+}
 
-    // No node found. Create new one.
-    struct node_t* p_new_node = NULL;
+int tree_put( struct tree_t* p_tree, char* p_key, struct data_t* p_value )
+{
+    if ( !p_key )
+        return -1;
+
+    return tree_put2( p_tree, p_key, strlen( p_key ), p_value );
+}
 
-    if ( !(p_new_node = node_create( entry_create( p_key_dup, p_value_copy ) )) )
+int tree_put2( struct tree_t* p_tree, char* p_key, size_t keysize, struct data_t* p_value )
+{
+    if ( !p_tree || !p_key || !p_value )
         return -1;
 
-    *pp_next_node = p_new_node;
-    p_tree->size++;
-    return 0;
+    // The engines keep a data_share of the value; a view with refcount 0 makes them copy it, so the caller keeps
+    // its data_t to itself.
+    struct data_t value_view = { p_value->datasize, 0, p_value->data };
+
+    return tree_put_value( p_tree, p_key, keysize, &value_view );
 }
 
+int tree_put_take( struct tree_t* p_tree, char* p_key, size_t keysize, struct data_t* p_value )
+{
+    if ( !p_value )
+        return -1;
 
-struct data_t* tree_get( struct tree_t* p_tree, char* p_key )
+    int result = -1;
+
+    // The engines keep a data_share of the value (no copy), then the caller's reference is released.
+    if ( p_tree && p_key )
+        result = tree_put_value( p_tree, p_key, keysize, p_value );
+
+    data_destroy( p_value );
+
+    return result;
+}
+
+int tree_put_value( struct tree_t* p_tree, char* p_key, size_t keysize, struct data_t* p_value )
 {
-    if ( !p_tree || !p_key )
-        return NULL;
 
+    struct entry_t search_key;
+    entry_key_set( &search_key, p_key, keysize );
+
+    if ( p_tree->type == TREE_ART )
+        return tree_art_put( p_tree, &search_key, p_value );
+
+    if ( p_tree->type == TREE_BPLUS )
+        return tree_bpt_put( p_tree, &search_key, p_value );
+
+    if ( p_tree->type == TREE_COW )
+        return tree_cow_put( p_tree, &search_key, p_value );
+
+    uint64_t hash = 0;
+
+    if ( p_tree->p_index )
+    {
+        hash = tree_index_hash( p_key, keysize );
+
+        // Existing key: replace the value without descending the tree.
+        struct node_t* p_node = tree_index_find( p_tree->p_index, &search_key, hash );
+        if ( p_node )
+            return node_set_value( p_node, p_value );
+
+        // Make room before changing the tree, so the index is always in sync with it.
+        if ( tree_index_reserve( p_tree->p_index, p_tree->size + 1 ) < 0 )
+            return -1;
+    }
+
+    int result = 0;
+    struct node_t* p_new_node = NULL;
+
+    if ( p_tree->type == TREE_AVL )
+        p_tree->p_root = tree_put_node_avl( p_tree, p_tree->p_root, &search_key, p_value, &p_new_node, &result );
+    else
+        result = tree_put_node_bst( p_tree, &search_key, p_value, &p_new_node );
+
+    if ( p_new_node && p_tree->p_index )
+        tree_index_insert( p_tree->p_index, p_new_node, hash );
+
+    return result;
+}
+
+int tree_put_node_bst( struct tree_t* p_tree, struct entry_t* p_key, struct data_t* p_value,
+                       struct node_t** pp_new_node )
+{
+    struct node_t** pp_next_node = &p_tree->p_root;
     struct node_t* p_current_node = p_tree->p_root;
+    int depth = 1;
 
     while ( p_current_node )
     {
-        int compare_value = strcmp( p_key, p_current_node->p_entry->key );
+        int compare_value = entry_key_compare( p_key, &p_current_node->entry );
 
         // Left branch.
         if ( compare_value < 0 )
         {
+            pp_next_node = &p_current_node->p_left;
             p_current_node = p_current_node->p_left;
         }
-
             // Right branch.
         else if ( compare_value > 0 )
         {
+            pp_next_node = &p_current_node->p_right;
             p_current_node = p_current_node->p_right;
         }
-            // Found node.
+            // Node with same key.
         else
         {
-            return data_dup( p_current_node->p_entry->value );
+            return node_set_value( p_current_node, p_value );
         }
+
+        depth++;
     }
 
-    // Didn't find node.
-    struct data_t* p_returned_data = data_create2( 0, NULL );
-    return p_returned_data;
-}
+    // No node found. Create new one.
+    struct node_t* p_new_node = NULL;
 
-int tree_del( struct tree_t* p_tree, char* p_key )
-{
-    if ( !p_tree || !p_key || !p_tree->p_root )
+    if ( !(p_new_node = node_create( p_key->key, p_key->keysize, p_value )) )
         return -1;
 
-    size_t tree_size_before = p_tree->size;
-    p_tree->p_root = tree_del_node( p_tree, p_tree->p_root, p_key );
+    // Update the subtree metadata of every node on the path to the new leaf. The node at depth i is now at least
+    // (depth - i + 1) high, so this can be done top-down without keeping the path.
+    p_current_node = p_tree->p_root;
 
-    // Tree size didn't change. Node wasn't found/error.
-    if ( tree_size_before == p_tree->size )
-        return -1;
+    for ( int i = 1; p_current_node; i++ )
+    {
+        p_current_node->size++;
+
+        if ( p_current_node->height < depth - i + 1 )
+            p_current_node->height = depth - i + 1;
+
+        p_current_node = entry_key_compare( p_key, &p_current_node->entry ) < 0 ?
+                         p_current_node->p_left : p_current_node->p_right;
+    }
 
+    *pp_next_node = p_new_node;
+    *pp_new_node = p_new_node;
+    p_tree->size++;
     return 0;
 }
 
-struct node_t* tree_del_node( struct tree_t* p_tree, struct node_t* p_node, char* p_key )
+struct node_t* tree_put_node_avl( struct tree_t* p_tree, struct node_t* p_node, struct entry_t* p_key,
+                                  struct data_t* p_value, struct node_t** pp_new_node, int* p_result )
 {
-    if ( !p_tree || !p_node || !p_key )
-        return NULL;
+    // No node found. Create new one.
+    if ( !p_node )
+    {
+        struct node_t* p_new_node = NULL;
+
+        if ( !(p_new_node = node_create( p_key->key, p_key->keysize, p_value )) )
+        {
+            *p_result = -1;
+            return NULL;
+        }
+
+        p_tree->size++;
+        *pp_new_node = p_new_node;
+        return p_new_node;
+    }
 
-    int compare_value = strcmp( p_key, p_node->p_entry->key );
+    int compare_value = entry_key_compare( p_key, &p_node->entry );
 
     // Left branch.
     if ( compare_value < 0 )
     {
-        p_node->p_left = tree_del_node( p_tree, p_node->p_left, p_key );
+        p_node->p_left = tree_put_node_avl( p_tree, p_node->p_left, p_key, p_value, pp_new_node, p_result );
     }
         // Right branch.
     else if ( compare_value > 0 )
     {
-        p_node->p_right = tree_del_node( p_tree, p_node->p_right, p_key );
+        p_node->p_right = tree_put_node_avl( p_tree, p_node->p_right, p_key, p_value, pp_new_node, p_result );
     }
-        // Found key.
+        // Node with same key. Shape doesn't change.
     else
     {
-        p_tree->size--;
-
-        // No children.
-        if ( !p_node->p_left && !p_node->p_right )
-        {
-            node_destroy( p_node );
-            return NULL;
-        }
+        if ( node_set_value( p_node, p_value ) < 0 )
+            *p_result = -1;
 
-        // One child.
-        if ( !p_node->p_left || !p_node->p_right )
-        {
-            struct node_t* p_node_aux;
-            p_node_aux = p_node->p_left == NULL ? p_node->p_right : p_node->p_left;
+        return p_node;
+    }
 
-            node_destroy( p_node );
-            return p_node_aux;
-        }
+    return node_rebalance( p_tree, p_node );
+}
 
-        // Has two children.
-        // Get the node of the lowest value key on the right branch of the current node.
-        struct node_t* p_minimum_node = p_node->p_right;
+int tree_bulk_load( struct tree_t* p_tree, struct entry_t** pp_entries, int n )
+{
+    if ( !p_tree || n < 0 || (n > 0 && !pp_entries) || p_tree->size > 0 )
+        return -1;
 
-        while ( p_minimum_node && p_minimum_node->p_left != NULL )
-            p_minimum_node = p_minimum_node->p_left;
+    // Entries must be valid and strictly ascending.
+    for ( int i = 0; i < n; i++ )
+    {
+        struct entry_t* p_entry = pp_entries[i];
 
-        // Substitute the entry of the current node with the node found on the cicle above.
-        char* p_key_copy = strdup( p_minimum_node->p_entry->key );
-        struct data_t* p_data_copy = data_dup( p_minimum_node->p_entry->value );
-        entry_replace( p_node->p_entry, p_key_copy, p_data_copy );
+        if ( !p_entry || !p_entry->key || !p_entry->value || p_entry->value->datasize <= 0 || !p_entry->value->data )
+            return -1;
 
-        p_tree->size++;
-        p_node->p_right = tree_del_node( p_tree, p_node->p_right, p_minimum_node->p_entry->key );
+        if ( i > 0 && entry_key_compare( pp_entries[i - 1], p_entry ) >= 0 )
+            return -1;
     }
 
-    return p_node;
-}
+    if ( n == 0 )
+        return 0;
 
-int tree_size( struct tree_t* p_tree )
-{
-    if ( !p_tree )
-        return -1;
+    if ( p_tree->type == TREE_BPLUS )
+        return tree_bpt_bulk_load( p_tree, pp_entries, n );
 
-    return (int)p_tree->size;
-}
+    if ( p_tree->type == TREE_COW )
+        return tree_cow_bulk_load( p_tree, pp_entries, n );
+
+    if ( p_tree->type == TREE_ART )
+    {
+        // The shape of a radix tree doesn't depend on the insertion order: plain puts already build it.
+        for ( int i = 0; i < n; i++ )
+        {
+            if ( tree_art_put( p_tree, pp_entries[i], pp_entries[i]->value ) < 0 )
+            {
+                tree_art_destroy( p_tree->p_art_root );
+                p_tree->p_art_root = NULL;
+                p_tree->size = 0;
+                return -1;
+            }
+        }
 
-int tree_height( struct tree_t* p_tree )
-{
-    if ( !p_tree )
         return 0;
+    }
 
-    return tree_height_recursive( p_tree->p_root );
+    return tree_bulk_load_nodes( p_tree, pp_entries, n );
 }
 
-int tree_height_recursive( struct node_t* p_node )
+int tree_bulk_load_nodes( struct tree_t* p_tree, struct entry_t** pp_entries, int n )
 {
-    if ( !p_node )
-        return 0;
+    struct node_t** pp_nodes = NULL;
 
-    int left_branch = tree_height_recursive( p_node->p_left );
-    int right_branch = tree_height_recursive( p_node->p_right );
+    if ( !(pp_nodes = (struct node_t**)malloc( sizeof( struct node_t* ) * n )) )
+        return -1;
 
-    return left_branch > right_branch ? left_branch + 1 : right_branch + 1;
-}
+    if ( p_tree->p_index && tree_index_reserve( p_tree->p_index, n ) < 0 )
+    {
+        free( pp_nodes );
+        return -1;
+    }
 
-char** tree_get_keys( struct tree_t* p_tree )
-{
-    if ( !p_tree )
-        return NULL;
+    for ( int i = 0; i < n; i++ )
+    {
+        if ( !(pp_nodes[i] = node_create( pp_entries[i]->key, pp_entries[i]->keysize, pp_entries[i]->value )) )
+        {
+            while ( i-- > 0 )
+                node_destroy( pp_nodes[i] );
 
-    size_t size = p_tree->size;
-    char** pp_keys = (char**)calloc( sizeof( char* ), (size + 1) );
-    pp_keys[size] = NULL;
+            free( pp_nodes );
+            return -1;
+        }
+    }
 
-    int index = 0;
-    int* p_index = &index;
+    p_tree->p_root = node_build_balanced( pp_nodes, n );
+    p_tree->size = n;
 
-    inorder_append_keys( p_tree->p_root, pp_keys, p_index );
+    if ( p_tree->p_index )
+    {
+        for ( int i = 0; i < n; i++ )
+            tree_index_insert( p_tree->p_index, pp_nodes[i],
+                               tree_index_hash( pp_nodes[i]->entry.key, pp_nodes[i]->entry.keysize ) );
+    }
 
-    return pp_keys;
+    free( pp_nodes );
+
+    return 0;
 }
 
-void** tree_get_values( struct tree_t* p_tree )
+struct node_t* node_build_balanced( struct node_t** pp_nodes, size_t n )
 {
-    if ( !p_tree )
+    if ( n == 0 )
         return NULL;
 
+    // The middle node is the root; the recursion is only log2(n) deep.
+    size_t middle = n / 2;
+    struct node_t* p_node = pp_nodes[middle];
 
-    size_t size = p_tree->size;
-    void** pp_values = (void**)calloc( sizeof( void* ), (size + 1) );
-    pp_values[size] = NULL;
+    p_node->p_left = node_build_balanced( pp_nodes, middle );
+    p_node->p_right = node_build_balanced( pp_nodes + middle + 1, n - middle - 1 );
+    node_update( p_node );
+
+    return p_node;
+}
 
-    int index = 0;
-    int* p_index = &index;
+/*
+ * qsort comparator of struct tree_batch_item_t: key order and, for the same key, batch order.
+ */
+static int tree_batch_item_compare( const void* p_item1, const void* p_item2 )
+{
+    const struct tree_batch_item_t* p_batch_item1 = (const struct tree_batch_item_t*)p_item1;
+    const struct tree_batch_item_t* p_batch_item2 = (const struct tree_batch_item_t*)p_item2;
 
-    inorder_append_values( p_tree->p_root, pp_values, p_index );
+    int compare_value = entry_key_compare( p_batch_item1->p_entry, p_batch_item2->p_entry );
 
-    return pp_values;
+    if ( compare_value )
+        return compare_value;
+
+    return p_batch_item1->position < p_batch_item2->position ? -1 : p_batch_item1->position > p_batch_item2->position;
 }
 
-void inorder_append_keys( struct node_t* p_node, char** pp_keys, int* p_index )
+struct tree_batch_item_t* tree_batch_sort( struct entry_t** pp_entries, int n )
 {
-    if ( !p_node )
-        return;
+    struct tree_batch_item_t* p_items = NULL;
+
+    if ( !(p_items = (struct tree_batch_item_t*)malloc( sizeof( struct tree_batch_item_t ) * (n > 0 ? n : 1) )) )
+        return NULL;
 
-    inorder_append_keys( p_node->p_left, pp_keys, p_index );
+    for ( int i = 0; i < n; i++ )
+    {
+        p_items[i].p_entry = pp_entries[i];
+        p_items[i].position = i;
+    }
 
-    pp_keys[*p_index] = strdup( p_node->p_entry->key );
-    (*p_index)++;
+    qsort( p_items, n, sizeof( struct tree_batch_item_t ), tree_batch_item_compare );
 
-    inorder_append_keys( p_node->p_right, pp_keys, p_index );
+    return p_items;
 }
 
-void inorder_append_values( struct node_t* p_node, void** pp_values, int* p_index )
+int tree_put_batch( struct tree_t* p_tree, struct entry_t** pp_entries, int n )
 {
-    if ( !p_node )
-        return;
+    if ( !p_tree || n < 0 || (n > 0 && !pp_entries) )
+        return -1;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        if ( !pp_entries[i] || !pp_entries[i]->key || !pp_entries[i]->value )
+            return -1;
+    }
+
+    struct tree_batch_item_t* p_items = NULL;
+
+    if ( !(p_items = tree_batch_sort( pp_entries, n )) )
+        return -1;
 
-    inorder_append_values( p_node->p_left, pp_values, p_index );
+    int result = 0;
 
-    pp_values[*p_index] = data_dup( p_node->p_entry->value );
+    // In key order consecutive puts walk the same path down the tree, which stays in cache.
+    for ( int i = 0; i < n; i++ )
+    {
+        struct entry_t* p_entry = p_items[i].p_entry;
+
+        if ( tree_put_value( p_tree, p_entry->key, p_entry->keysize, p_entry->value ) < 0 )
+            result = -1;
+    }
 
-    (*p_index)++;
+    free( p_items );
 
-    inorder_append_values( p_node->p_right, pp_values, p_index );
+    return result;
 }
 
-void tree_free_keys( char** pp_keys )
+int tree_del_batch( struct tree_t* p_tree, struct entry_t** pp_keys, int n )
 {
-    if ( !pp_keys )
-        return;
+    if ( !p_tree || n < 0 || (n > 0 && !pp_keys) )
+        return -1;
 
-    int i = 0;
-    while ( pp_keys[i] )
+    for ( int i = 0; i < n; i++ )
     {
-        free( pp_keys[i] );
-        i++;
+        if ( !pp_keys[i] || !pp_keys[i]->key )
+            return -1;
     }
 
-    free( pp_keys );
+    struct tree_batch_item_t* p_items = NULL;
+
+    if ( !(p_items = tree_batch_sort( pp_keys, n )) )
+        return -1;
+
+    int n_removed = 0;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        if ( tree_del2( p_tree, p_items[i].p_entry->key, p_items[i].p_entry->keysize ) == 0 )
+            n_removed++;
+    }
+
+    free( p_items );
+
+    return n_removed;
 }
 
-void tree_free_values( void** pp_values )
+struct data_t* tree_get( struct tree_t* p_tree, char* p_key )
 {
-   if ( !pp_values )
-       return;
+    if ( !p_key )
+        return NULL;
 
-   int i = 0;
-   while ( pp_values[i] )
-   {
-       data_destroy( pp_values[i] );
-       i++;
-   }
+    return tree_get2( p_tree, p_key, strlen( p_key ) );
+}
 
-   free( pp_values );
-}
\ No newline at end of file
+struct data_t* tree_get2( struct tree_t* p_tree, char* p_key, size_t keysize )
+{
+    if ( !p_tree || !p_key )
+        return NULL;
+
+    struct entry_t search_key;
+    entry_key_set( &search_key, p_key, keysize );
+
+    // The snapshot may only be read inside the engine: it shares the value before leaving it.
+    if ( p_tree->type == TREE_COW )
+        return tree_cow_get( p_tree, &search_key );
+
+    if ( !TREE_USES_NODES( p_tree->type ) )
+    {
+        struct entry_t* p_entry = p_tree->type == TREE_ART ? tree_art_find( p_tree, &search_key )
+                                                           : tree_bpt_find( p_tree, &search_key );
+        return p_entry ? data_share( p_entry->value ) : data_create2( 0, NULL );
+    }
+
+    // Exact match lookups go to the hash index when there is one.
+    if ( p_tree->p_index )
+    {
+        struct node_t* p_node = tree_index_find( p_tree->p_index, &search_key, tree_index_hash( p_key, keysize ) );
+        return p_node ? data_share( p_node->entry.value ) : data_create2( 0, NULL );
+    }
+
+    struct node_t* p_current_node = p_tree->p_root;
+
+    while ( p_current_node )
+    {
+        int compare_value = entry_key_compare( &search_key, &p_current_node->entry );
+
+        // Left branch.
+        if ( compare_value < 0 )
+        {
+            p_current_node = p_current_node->p_left;
+        }
+
+            // Right branch.
+        else if ( compare_value > 0 )
+        {
+            p_current_node = p_current_node->p_right;
+        }
+            // Found node.
+        else
+        {
+            return data_share( p_current_node->entry.value );
+        }
+    }
+
+    // Didn't find node.
+    struct data_t* p_returned_data = data_create2( 0, NULL );
+    return p_returned_data;
+}
+
+int node_key_compare_optimistic( struct node_t* p_node, struct entry_t* p_key, int* p_compare )
+{
+    if ( !slab_contains( p_node, sizeof( struct node_t ) ) )
+        return -1;
+
+    struct entry_t node_key;
+    node_key.key = __atomic_load_n( &p_node->entry.key, __ATOMIC_RELAXED );
+    node_key.keysize = __atomic_load_n( &p_node->entry.keysize, __ATOMIC_RELAXED );
+    node_key.key_prefix = __atomic_load_n( &p_node->entry.key_prefix, __ATOMIC_RELAXED );
+
+    // The key and its size may not match: they only have to keep the compare inside readable memory.
+    if ( node_key.key == p_node->key_inline ? node_key.keysize >= NODE_INLINE_KEY_SIZE
+                                            : !slab_contains( node_key.key, node_key.keysize ) )
+        return -1;
+
+    *p_compare = entry_key_compare( p_key, &node_key );
+
+    return 0;
+}
+
+/*
+ * Copies the value of a node found by tree_get_optimistic.
+ *
+ * Returns:
+ *      1 (copied) or -1 if the value isn't stored inside the node.
+ */
+static int node_value_copy_optimistic( struct node_t* p_node, char* p_value, int* p_value_size )
+{
+    struct data_t* p_node_value = __atomic_load_n( &p_node->entry.value, __ATOMIC_RELAXED );
+    int value_size = __atomic_load_n( &p_node->value.datasize, __ATOMIC_RELAXED );
+
+    // Big values are shared (data_share), which can't be done on a node that may already be gone.
+    if ( p_node_value != &p_node->value || value_size <= 0 || value_size > NODE_INLINE_VALUE_SIZE )
+        return -1;
+
+    memcpy( p_value, p_node->value_inline, value_size );
+    *p_value_size = value_size;
+
+    return 1;
+}
+
+int tree_get_optimistic( struct tree_t* p_tree, char* p_key, size_t keysize, char* p_value, int* p_value_size )
+{
+    struct entry_t search_key;
+    entry_key_set( &search_key, p_key, keysize );
+
+    if ( p_tree->p_index )
+    {
+        struct node_t* p_node = NULL;
+        int found = tree_index_find_optimistic( p_tree->p_index, &search_key, tree_index_hash( p_key, keysize ),
+                                                &p_node );
+
+        return found == 1 ? node_value_copy_optimistic( p_node, p_value, p_value_size ) : found;
+    }
+
+    struct node_t* p_node = __atomic_load_n( &p_tree->p_root, __ATOMIC_RELAXED );
+
+    // Links read half way through a rotation may form a cycle: the walk is bounded by the height of any AVL tree.
+    for ( int steps = 0; p_node; steps++ )
+    {
+        int compare_value;
+
+        if ( steps == TREE_DEL_PATH_SIZE || node_key_compare_optimistic( p_node, &search_key, &compare_value ) < 0 )
+            return -1;
+
+        if ( compare_value == 0 )
+            return node_value_copy_optimistic( p_node, p_value, p_value_size );
+
+        p_node = __atomic_load_n( compare_value < 0 ? &p_node->p_left : &p_node->p_right, __ATOMIC_RELAXED );
+    }
+
+    return 0;
+}
+
+int tree_del( struct tree_t* p_tree, char* p_key )
+{
+    if ( !p_key )
+        return -1;
+
+    return tree_del2( p_tree, p_key, strlen( p_key ) );
+}
+
+int tree_del2( struct tree_t* p_tree, char* p_key, size_t keysize )
+{
+    if ( !p_tree || !p_key )
+        return -1;
+
+    struct entry_t search_key;
+    entry_key_set( &search_key, p_key, keysize );
+
+    if ( p_tree->type == TREE_ART )
+        return tree_art_del( p_tree, &search_key );
+
+    if ( p_tree->type == TREE_BPLUS )
+        return tree_bpt_del( p_tree, &search_key );
+
+    if ( p_tree->type == TREE_COW )
+        return tree_cow_del( p_tree, &search_key );
+
+    if ( !p_tree->p_root )
+        return -1;
+
+    uint64_t hash = 0;
+
+    if ( p_tree->p_index )
+    {
+        hash = tree_index_hash( p_key, keysize );
+
+        // Missing keys are found without descending the tree.
+        if ( !tree_index_find( p_tree->p_index, &search_key, hash ) )
+            return -1;
+    }
+
+    return tree_del_node( p_tree, &search_key, hash );
+}
+
+int tree_del_node( struct tree_t* p_tree, struct entry_t* p_key, uint64_t hash )
+{
+    if ( !p_tree || !p_key )
+        return -1;
+
+    // Nodes from the root down to the parent of the removed position, to be updated/rebalanced bottom-up. The tree
+    // height bounds the path; only degenerate trees need it on the heap.
+    struct node_t* p_path_stack[TREE_DEL_PATH_SIZE];
+    struct node_t** pp_path = p_path_stack;
+    int max_depth = node_height( p_tree->p_root );
+
+    if ( max_depth > TREE_DEL_PATH_SIZE &&
+         !(pp_path = (struct node_t**)malloc( sizeof( struct node_t* ) * max_depth )) )
+        return -1;
+
+    int depth = 0;
+    int compare_value = 0;
+    struct node_t* p_node = p_tree->p_root;
+
+    while ( p_node && (compare_value = entry_key_compare( p_key, &p_node->entry )) != 0 )
+    {
+        pp_path[depth++] = p_node;
+        p_node = compare_value < 0 ? p_node->p_left : p_node->p_right;
+    }
+
+    // Key not found.
+    if ( !p_node )
+    {
+        if ( pp_path != p_path_stack )
+            free( pp_path );
+
+        return -1;
+    }
+
+    // Nothing fails from here on, so the index and the tree always change together. The node leaves the index before
+    // it is destroyed (the readers that don't lock find nodes through the index).
+    if ( p_tree->p_index )
+        tree_index_remove( p_tree->p_index, p_node, hash );
+
+    struct node_t* p_parent_node = depth > 0 ? pp_path[depth - 1] : NULL;
+    struct node_t* p_replacement_node = NULL;
+
+    // Has two children: the node of the lowest key on the right branch takes its place.
+    if ( p_node->p_left && p_node->p_right )
+    {
+        int node_depth = depth++;
+        struct node_t* p_minimum_node = p_node->p_right;
+
+        while ( p_minimum_node->p_left )
+        {
+            pp_path[depth++] = p_minimum_node;
+            p_minimum_node = p_minimum_node->p_left;
+        }
+
+        // Unlink the minimum node from its parent (the removed node itself, if it is the right child).
+        if ( depth - 1 == node_depth )
+            p_node->p_right = p_minimum_node->p_right;
+        else
+            pp_path[depth - 1]->p_left = p_minimum_node->p_right;
+
+        p_minimum_node->p_left = p_node->p_left;
+        p_minimum_node->p_right = p_node->p_right;
+
+        pp_path[node_depth] = p_minimum_node;
+        p_replacement_node = p_minimum_node;
+    }
+        // One or no children.
+    else
+    {
+        p_replacement_node = p_node->p_left ? p_node->p_left : p_node->p_right;
+    }
+
+    if ( !p_parent_node )
+        p_tree->p_root = p_replacement_node;
+    else if ( p_parent_node->p_left == p_node )
+        p_parent_node->p_left = p_replacement_node;
+    else
+        p_parent_node->p_right = p_replacement_node;
+
+    node_destroy( p_node );
+    p_tree->size--;
+
+    // Update the path bottom-up, linking each rebalanced subtree back to its parent.
+    for ( int i = depth - 1; i >= 0; i-- )
+    {
+        struct node_t* p_old_root = pp_path[i];
+        struct node_t* p_new_root = node_rebalance( p_tree, p_old_root );
+
+        if ( i == 0 )
+            p_tree->p_root = p_new_root;
+        else if ( pp_path[i - 1]->p_left == p_old_root )
+            pp_path[i - 1]->p_left = p_new_root;
+        else
+            pp_path[i - 1]->p_right = p_new_root;
+    }
+
+    if ( pp_path != p_path_stack )
+        free( pp_path );
+
+    return 0;
+}
+
+int node_height( struct node_t* p_node )
+{
+    return p_node ? p_node->height : 0;
+}
+
+size_t node_size( struct node_t* p_node )
+{
+    return p_node ? p_node->size : 0;
+}
+
+void node_update( struct node_t* p_node )
+{
+    int left_height = node_height( p_node->p_left );
+    int right_height = node_height( p_node->p_right );
+
+    p_node->height = left_height > right_height ? left_height + 1 : right_height + 1;
+    p_node->size = node_size( p_node->p_left ) + node_size( p_node->p_right ) + 1;
+}
+
+struct node_t* node_rotate_left( struct node_t* p_node )
+{
+    struct node_t* p_new_root = p_node->p_right;
+
+    p_node->p_right = p_new_root->p_left;
+    p_new_root->p_left = p_node;
+
+    node_update( p_node );
+    node_update( p_new_root );
+
+    return p_new_root;
+}
+
+struct node_t* node_rotate_right( struct node_t* p_node )
+{
+    struct node_t* p_new_root = p_node->p_left;
+
+    p_node->p_left = p_new_root->p_right;
+    p_new_root->p_right = p_node;
+
+    node_update( p_node );
+    node_update( p_new_root );
+
+    return p_new_root;
+}
+
+struct node_t* node_rebalance( struct tree_t* p_tree, struct node_t* p_node )
+{
+    if ( !p_node )
+        return p_node;
+
+    node_update( p_node );
+
+    if ( p_tree->type != TREE_AVL )
+        return p_node;
+
+    int balance = node_height( p_node->p_left ) - node_height( p_node->p_right );
+
+    // Left heavy.
+    if ( balance > 1 )
+    {
+        // Left-right case.
+        if ( node_height( p_node->p_left->p_left ) < node_height( p_node->p_left->p_right ) )
+            p_node->p_left = node_rotate_left( p_node->p_left );
+
+        return node_rotate_right( p_node );
+    }
+
+    // Right heavy.
+    if ( balance < -1 )
+    {
+        // Right-left case.
+        if ( node_height( p_node->p_right->p_right ) < node_height( p_node->p_right->p_left ) )
+            p_node->p_right = node_rotate_right( p_node->p_right );
+
+        return node_rotate_left( p_node );
+    }
+
+    return p_node;
+}
+
+int tree_size( struct tree_t* p_tree )
+{
+    if ( !p_tree )
+        return -1;
+
+    // p_tree->size belongs to the writer; readers of a TREE_COW tree use their snapshot.
+    if ( p_tree->type == TREE_COW )
+        return (int)tree_cow_size( p_tree );
+
+    return (int)p_tree->size;
+}
+
+int tree_height( struct tree_t* p_tree )
+{
+    if ( !p_tree )
+        return 0;
+
+    if ( p_tree->type == TREE_ART )
+        return tree_art_height( p_tree->p_art_root );
+
+    if ( p_tree->type == TREE_BPLUS )
+        return tree_bpt_height( p_tree );
+
+    if ( p_tree->type == TREE_COW )
+        return tree_cow_height( p_tree );
+
+    return node_height( p_tree->p_root );
+}
+
+char** tree_get_keys( struct tree_t* p_tree )
+{
+    if ( !p_tree )
+        return NULL;
+
+    if ( p_tree->type == TREE_COW )
+        return (char**)tree_cow_collect( p_tree, 0, SIZE_MAX, tree_append_key, NULL );
+
+    size_t size = p_tree->size;
+    char** pp_keys = (char**)calloc( sizeof( char* ), (size + 1) );
+    pp_keys[size] = NULL;
+
+    if ( !TREE_USES_NODES( p_tree->type ) )
+    {
+        struct tree_append_t append = { (void**)pp_keys, 0, size, NULL };
+        tree_engine_walk( p_tree, NULL, 0, tree_append_key, &append );
+        return pp_keys;
+    }
+
+    struct tree_append_t append = { (void**)pp_keys, 0, size, NULL };
+    tree_node_walk( p_tree, tree_append_key, &append );
+
+    return pp_keys;
+}
+
+void** tree_get_values( struct tree_t* p_tree )
+{
+    if ( !p_tree )
+        return NULL;
+
+    if ( p_tree->type == TREE_COW )
+        return tree_cow_collect( p_tree, 0, SIZE_MAX, tree_append_value, NULL );
+
+    size_t size = p_tree->size;
+    void** pp_values = (void**)calloc( sizeof( void* ), (size + 1) );
+    pp_values[size] = NULL;
+
+    if ( !TREE_USES_NODES( p_tree->type ) )
+    {
+        struct tree_append_t append = { pp_values, 0, size, NULL };
+        tree_engine_walk( p_tree, NULL, 0, tree_append_value, &append );
+        return pp_values;
+    }
+
+    struct tree_append_t append = { pp_values, 0, size, NULL };
+    tree_node_walk( p_tree, tree_append_value, &append );
+
+    return pp_values;
+}
+
+/*
+ * Copy of a key of keysize bytes, terminated by a '\0' (binary keys can hold '\0').
+ */
+static char* tree_key_copy( struct entry_t* p_entry, size_t* p_keysize )
+{
+    char* p_key_copy;
+
+    if ( !(p_key_copy = (char*)malloc( p_entry->keysize + 1 )) )
+        return NULL;
+
+    memcpy( p_key_copy, p_entry->key, p_entry->keysize );
+    p_key_copy[p_entry->keysize] = '\0';
+
+    if ( p_keysize )
+        *p_keysize = p_entry->keysize;
+
+    return p_key_copy;
+}
+
+int tree_append_key( struct entry_t* p_entry, void* p_append )
+{
+    struct tree_append_t* p_state = (struct tree_append_t*)p_append;
+    size_t* p_keysize = p_state->p_keysizes ? &p_state->p_keysizes[p_state->n_items] : NULL;
+
+    p_state->pp_items[p_state->n_items++] = tree_key_copy( p_entry, p_keysize );
+
+    return p_state->n_items >= p_state->limit;
+}
+
+int tree_append_value( struct entry_t* p_entry, void* p_append )
+{
+    struct tree_append_t* p_state = (struct tree_append_t*)p_append;
+
+    p_state->pp_items[p_state->n_items++] = data_share( p_entry->value );
+
+    return p_state->n_items >= p_state->limit;
+}
+
+int tree_node_walk( struct tree_t* p_tree, int (*callback)( struct entry_t* p_entry, void* p_context ),
+                    void* p_context )
+{
+    struct tree_iter_t iter;
+    if ( tree_iter_init_at( &iter, p_tree, 0 ) < 0 )
+        return -1;
+
+    int stopped = 0;
+    struct node_t* p_node = NULL;
+
+    while ( !stopped && (p_node = tree_iter_next( &iter )) )
+        stopped = callback( &p_node->entry, p_context );
+
+    tree_iter_destroy( &iter );
+
+    return stopped;
+}
+
+char* tree_get_key_at( struct tree_t* p_tree, int index )
+{
+    return tree_get_key_at2( p_tree, index, NULL );
+}
+
+char* tree_get_key_at2( struct tree_t* p_tree, int index, size_t* p_keysize )
+{
+    if ( p_tree && p_tree->type == TREE_COW )
+        return index < 0 ? NULL : tree_cow_key_at( p_tree, (size_t)index, p_keysize );
+
+    if ( !p_tree || index < 0 || (size_t)index >= p_tree->size )
+        return NULL;
+
+    if ( !TREE_USES_NODES( p_tree->type ) )
+    {
+        struct entry_t* p_entry = p_tree->type == TREE_ART ? tree_art_entry_at( p_tree, index )
+                                                           : tree_bpt_entry_at( p_tree, index );
+        return p_entry ? tree_key_copy( p_entry, p_keysize ) : NULL;
+    }
+
+    struct node_t* p_current_node = p_tree->p_root;
+
+    while ( p_current_node )
+    {
+        size_t left_size = node_size( p_current_node->p_left );
+
+        // Left branch.
+        if ( (size_t)index < left_size )
+        {
+            p_current_node = p_current_node->p_left;
+        }
+            // Right branch. Skip the left subtree and the current node.
+        else if ( (size_t)index > left_size )
+        {
+            index -= (int)left_size + 1;
+            p_current_node = p_current_node->p_right;
+        }
+            // Found node.
+        else
+        {
+            return tree_key_copy( &p_current_node->entry, p_keysize );
+        }
+    }
+
+    return NULL;
+}
+
+int tree_get_rank( struct tree_t* p_tree, char* p_key )
+{
+    return p_key ? tree_get_rank2( p_tree, p_key, strlen( p_key ) ) : -1;
+}
+
+int tree_get_rank2( struct tree_t* p_tree, char* p_key, size_t keysize )
+{
+    if ( !p_tree || !p_key )
+        return -1;
+
+    struct entry_t search_key;
+    entry_key_set( &search_key, p_key, keysize );
+
+    if ( p_tree->type == TREE_ART )
+        return (int)tree_art_rank( p_tree, &search_key );
+
+    if ( p_tree->type == TREE_BPLUS )
+        return (int)tree_bpt_rank( p_tree, &search_key );
+
+    if ( p_tree->type == TREE_COW )
+        return (int)tree_cow_rank( p_tree, &search_key );
+
+    struct node_t* p_current_node = p_tree->p_root;
+    size_t rank = 0;
+
+    while ( p_current_node )
+    {
+        int compare_value = entry_key_compare( &search_key, &p_current_node->entry );
+
+        // Left branch.
+        if ( compare_value < 0 )
+        {
+            p_current_node = p_current_node->p_left;
+        }
+            // Right branch. Every key on the left subtree and the current one are smaller.
+        else if ( compare_value > 0 )
+        {
+            rank += node_size( p_current_node->p_left ) + 1;
+            p_current_node = p_current_node->p_right;
+        }
+            // Found key.
+        else
+        {
+            rank += node_size( p_current_node->p_left );
+            break;
+        }
+    }
+
+    return (int)rank;
+}
+
+char** tree_get_keys_page( struct tree_t* p_tree, int offset, int limit )
+{
+    return tree_get_keys_page2( p_tree, offset, limit, NULL );
+}
+
+char** tree_get_keys_page2( struct tree_t* p_tree, int offset, int limit, size_t* p_keysizes )
+{
+    if ( !p_tree || offset < 0 || limit < 0 )
+        return NULL;
+
+    if ( p_tree->type == TREE_COW )
+        return (char**)tree_cow_collect( p_tree, (size_t)offset, (size_t)limit, tree_append_key, p_keysizes );
+
+    // Number of keys actually in the page.
+    size_t size = (size_t)offset < p_tree->size ? p_tree->size - offset : 0;
+    if ( size > (size_t)limit )
+        size = limit;
+
+    char** pp_keys = NULL;
+    if ( !(pp_keys = (char**)calloc( sizeof( char* ), (size + 1) )) )
+        return NULL;
+
+    if ( !TREE_USES_NODES( p_tree->type ) )
+    {
+        struct tree_append_t append = { (void**)pp_keys, 0, size, p_keysizes };
+
+        if ( size )
+            tree_engine_walk( p_tree, NULL, offset, tree_append_key, &append );
+
+        return pp_keys;
+    }
+
+    struct tree_iter_t iter;
+    if ( tree_iter_init_at( &iter, p_tree, offset ) < 0 )
+    {
+        free( pp_keys );
+        return NULL;
+    }
+
+    struct node_t* p_node;
+    for ( size_t i = 0; i < size && (p_node = tree_iter_next( &iter )); i++ )
+        pp_keys[i] = tree_key_copy( &p_node->entry, p_keysizes ? &p_keysizes[i] : NULL );
+
+    tree_iter_destroy( &iter );
+
+    return pp_keys;
+}
+
+int tree_scan( struct tree_t* p_tree, char* p_start_key, char* p_end_key, int limit,
+               int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    return tree_scan2( p_tree, p_start_key, p_start_key ? strlen( p_start_key ) : 0, p_end_key,
+                       p_end_key ? strlen( p_end_key ) : 0, limit, callback, p_context );
+}
+
+int tree_scan2( struct tree_t* p_tree, char* p_start_key, size_t start_keysize, char* p_end_key, size_t end_keysize,
+                int limit, int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    if ( !p_tree || !callback )
+        return -1;
+
+    struct entry_t start_key;
+    if ( p_start_key )
+        entry_key_set( &start_key, p_start_key, start_keysize );
+
+    struct entry_t end_key;
+    if ( p_end_key )
+        entry_key_set( &end_key, p_end_key, end_keysize );
+
+    struct tree_scan_t scan = { p_end_key ? &end_key : NULL, NULL, 0, limit, 0, callback, p_context };
+
+    return tree_scan_run( p_tree, p_start_key ? &start_key : NULL, &scan );
+}
+
+int tree_scan_prefix( struct tree_t* p_tree, char* p_prefix, int limit,
+                      int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    return p_prefix ? tree_scan_prefix2( p_tree, p_prefix, strlen( p_prefix ), limit, callback, p_context ) : -1;
+}
+
+int tree_scan_prefix2( struct tree_t* p_tree, char* p_prefix, size_t prefixsize, int limit,
+                       int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    if ( !p_tree || !p_prefix || !callback )
+        return -1;
+
+    struct entry_t start_key;
+    entry_key_set( &start_key, p_prefix, prefixsize );
+
+    struct tree_scan_t scan = { NULL, p_prefix, prefixsize, limit, 0, callback, p_context };
+
+    // Keys with the prefix are contiguous and start on the first key >= prefix.
+    return tree_scan_run( p_tree, &start_key, &scan );
+}
+
+int tree_scan_run( struct tree_t* p_tree, struct entry_t* p_start_key, struct tree_scan_t* p_scan )
+{
+    if ( !TREE_USES_NODES( p_tree->type ) )
+    {
+        tree_engine_walk( p_tree, p_start_key, 0, tree_scan_visit, p_scan );
+
+        return p_scan->count;
+    }
+
+    struct tree_iter_t iter;
+    if ( tree_iter_init_from_key( &iter, p_tree, p_start_key ) < 0 )
+        return -1;
+
+    struct node_t* p_node;
+    while ( (p_node = tree_iter_next( &iter )) && !tree_scan_visit( &p_node->entry, p_scan ) )
+        ;
+
+    tree_iter_destroy( &iter );
+
+    return p_scan->count;
+}
+
+int tree_engine_walk( struct tree_t* p_tree, struct entry_t* p_start_key, size_t skip,
+                      int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    if ( p_tree->type == TREE_ART )
+        return tree_art_walk( p_tree, p_start_key, skip, callback, p_context );
+
+    if ( p_tree->type == TREE_COW )
+        return tree_cow_walk( p_tree, p_start_key, skip, callback, p_context );
+
+    return tree_bpt_walk( p_tree, p_start_key, skip, callback, p_context );
+}
+
+int tree_scan_visit( struct entry_t* p_entry, void* p_scan )
+{
+    struct tree_scan_t* p_state = (struct tree_scan_t*)p_scan;
+
+    if ( p_state->limit > 0 && p_state->count >= p_state->limit )
+        return 1;
+
+    // Past the end of the range.
+    if ( p_state->p_end_key && entry_key_compare( p_entry, p_state->p_end_key ) >= 0 )
+        return 1;
+
+    // Keys with the prefix are contiguous. The first one without it ends the scan.
+    if ( p_state->p_prefix && (p_entry->keysize < p_state->prefix_len ||
+                               memcmp( p_entry->key, p_state->p_prefix, p_state->prefix_len ) != 0) )
+        return 1;
+
+    p_state->count++;
+
+    return p_state->callback( p_entry, p_state->p_context ) ? 1 : 0;
+}
+
+void tree_free_keys( char** pp_keys )
+{
+    if ( !pp_keys )
+        return;
+
+    int i = 0;
+    while ( pp_keys[i] )
+    {
+        free( pp_keys[i] );
+        i++;
+    }
+
+    free( pp_keys );
+}
+
+void tree_free_values( void** pp_values )
+{
+   if ( !pp_values )
+       return;
+
+   int i = 0;
+   while ( pp_values[i] )
+   {
+       data_destroy( pp_values[i] );
+       i++;
+   }
+
+   free( pp_values );
+}
+
+int tree_iter_init_at( struct tree_iter_t* p_iter, struct tree_t* p_tree, size_t index )
+{
+    if ( !p_iter || !p_tree )
+        return -1;
+
+    p_iter->top = 0;
+
+    // The stack never holds more nodes than the height of the tree.
+    if ( !(p_iter->pp_stack = (struct node_t**)malloc( sizeof( struct node_t* ) * (node_height( p_tree->p_root ) + 1) )) )
+        return -1;
+
+    struct node_t* p_current_node = p_tree->p_root;
+
+    while ( p_current_node )
+    {
+        size_t left_size = node_size( p_current_node->p_left );
+
+        // Node will be visited after its left subtree.
+        if ( index < left_size )
+        {
+            p_iter->pp_stack[p_iter->top++] = p_current_node;
+            p_current_node = p_current_node->p_left;
+        }
+            // Node and its left subtree come before index.
+        else if ( index > left_size )
+        {
+            index -= left_size + 1;
+            p_current_node = p_current_node->p_right;
+        }
+            // First node to visit.
+        else
+        {
+            p_iter->pp_stack[p_iter->top++] = p_current_node;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+int tree_iter_init_from_key( struct tree_iter_t* p_iter, struct tree_t* p_tree, struct entry_t* p_key )
+{
+    if ( !p_key )
+        return tree_iter_init_at( p_iter, p_tree, 0 );
+
+    if ( !p_iter || !p_tree )
+        return -1;
+
+    p_iter->top = 0;
+
+    if ( !(p_iter->pp_stack = (struct node_t**)malloc( sizeof( struct node_t* ) * (node_height( p_tree->p_root ) + 1) )) )
+        return -1;
+
+    struct node_t* p_current_node = p_tree->p_root;
+
+    while ( p_current_node )
+    {
+        // Node is in range. It will be visited after the smaller keys of its left subtree.
+        if ( entry_key_compare( p_key, &p_current_node->entry ) <= 0 )
+        {
+            p_iter->pp_stack[p_iter->top++] = p_current_node;
+            p_current_node = p_current_node->p_left;
+        }
+            // Node and its left subtree are before the key.
+        else
+        {
+            p_current_node = p_current_node->p_right;
+        }
+    }
+
+    return 0;
+}
+
+struct node_t* tree_iter_next( struct tree_iter_t* p_iter )
+{
+    if ( !p_iter || p_iter->top == 0 )
+        return NULL;
+
+    struct node_t* p_node = p_iter->pp_stack[--p_iter->top];
+
+    // Next nodes are the leftmost path of the right subtree.
+    struct node_t* p_current_node = p_node->p_right;
+
+    while ( p_current_node )
+    {
+        p_iter->pp_stack[p_iter->top++] = p_current_node;
+        p_current_node = p_current_node->p_left;
+    }
+
+    return p_node;
+}
+
+void tree_iter_destroy( struct tree_iter_t* p_iter )
+{
+    if ( p_iter )
+        free( p_iter->pp_stack );
+}
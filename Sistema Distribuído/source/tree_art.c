@@ -0,0 +1,1023 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree-private.h"
+#include "tree_art-private.h"
+#include "entry-private.h"
+#include "slab.h"
+
+#define ART_MIN( a, b ) ((a) < (b) ? (a) : (b))
+
+/*
+ * State of a tree_art_walk.
+ */
+struct art_walk_t
+{
+    struct entry_t* p_start_key;
+    size_t skip;
+    int (*callback)( struct entry_t* p_entry, void* p_context );
+    void* p_context;
+};
+
+static struct art_leaf_t* art_leaf_create( struct entry_t* p_key, struct data_t* p_value )
+{
+    struct art_leaf_t* p_leaf = NULL;
+
+    if ( !(p_leaf = (struct art_leaf_t*)slab_alloc( sizeof( struct art_leaf_t ) + p_key->keysize + 1 )) )
+        return NULL;
+
+    if ( !(p_leaf->entry.value = data_share( p_value )) )
+    {
+        slab_free( p_leaf );
+        return NULL;
+    }
+
+    memcpy( p_leaf->key, p_key->key, p_key->keysize );
+    p_leaf->key[p_key->keysize] = '\0';
+    entry_key_set( &p_leaf->entry, p_leaf->key, p_key->keysize );
+
+    return p_leaf;
+}
+
+static void art_leaf_destroy( struct art_leaf_t* p_leaf )
+{
+    data_destroy( p_leaf->entry.value );
+    slab_free( p_leaf );
+}
+
+static int art_leaf_set_value( struct art_leaf_t* p_leaf, struct data_t* p_value )
+{
+    struct data_t* p_new_value = NULL;
+
+    if ( !(p_new_value = data_share( p_value )) )
+        return -1;
+
+    // Readers may still hold a reference to the old value.
+    data_destroy( p_leaf->entry.value );
+    p_leaf->entry.value = p_new_value;
+
+    return 0;
+}
+
+static struct art_node_t* art_node_create( int type )
+{
+    size_t size;
+
+    switch ( type )
+    {
+        case ART_NODE4: size = sizeof( struct art_node4_t ); break;
+        case ART_NODE16: size = sizeof( struct art_node16_t ); break;
+        case ART_NODE48: size = sizeof( struct art_node48_t ); break;
+        default: size = sizeof( struct art_node256_t ); break;
+    }
+
+    struct art_node_t* p_node = NULL;
+
+    if ( !(p_node = (struct art_node_t*)slab_calloc( size )) )
+        return NULL;
+
+    p_node->type = type;
+
+    return p_node;
+}
+
+/*
+ * Copies the header of a node to a node of another size.
+ */
+static void art_node_copy_header( struct art_node_t* p_dest, struct art_node_t* p_src )
+{
+    p_dest->n_children = p_src->n_children;
+    p_dest->prefix_len = p_src->prefix_len;
+    p_dest->size = p_src->size;
+    p_dest->p_end_leaf = p_src->p_end_leaf;
+    memcpy( p_dest->prefix, p_src->prefix, ART_MAX_PREFIX_LEN );
+}
+
+void tree_art_destroy( struct art_node_t* p_node )
+{
+    if ( !p_node )
+        return;
+
+    if ( ART_IS_LEAF( p_node ) )
+    {
+        art_leaf_destroy( ART_LEAF( p_node ) );
+        return;
+    }
+
+    if ( p_node->p_end_leaf )
+        art_leaf_destroy( p_node->p_end_leaf );
+
+    switch ( p_node->type )
+    {
+        case ART_NODE4:
+            for ( int i = 0; i < p_node->n_children; i++ )
+                tree_art_destroy( ((struct art_node4_t*)p_node)->p_children[i] );
+            break;
+        case ART_NODE16:
+            for ( int i = 0; i < p_node->n_children; i++ )
+                tree_art_destroy( ((struct art_node16_t*)p_node)->p_children[i] );
+            break;
+        case ART_NODE48:
+            for ( int i = 0; i < 48; i++ )
+                tree_art_destroy( ((struct art_node48_t*)p_node)->p_children[i] );
+            break;
+        case ART_NODE256:
+            for ( int i = 0; i < 256; i++ )
+                tree_art_destroy( ((struct art_node256_t*)p_node)->p_children[i] );
+            break;
+    }
+
+    slab_free( p_node );
+}
+
+/*
+ * Number of keys below a child (1 for a leaf).
+ */
+static size_t art_child_size( struct art_node_t* p_child )
+{
+    return ART_IS_LEAF( p_child ) ? 1 : p_child->size;
+}
+
+/*
+ * Returns the reference to the child of a byte; NULL if there is none.
+ */
+static struct art_node_t** art_find_child( struct art_node_t* p_node, unsigned char byte )
+{
+    switch ( p_node->type )
+    {
+        case ART_NODE4:
+        {
+            struct art_node4_t* p_node4 = (struct art_node4_t*)p_node;
+
+            for ( int i = 0; i < p_node->n_children; i++ )
+            {
+                if ( p_node4->keys[i] == byte )
+                    return &p_node4->p_children[i];
+            }
+
+            return NULL;
+        }
+        case ART_NODE16:
+        {
+            struct art_node16_t* p_node16 = (struct art_node16_t*)p_node;
+
+            for ( int i = 0; i < p_node->n_children; i++ )
+            {
+                if ( p_node16->keys[i] == byte )
+                    return &p_node16->p_children[i];
+            }
+
+            return NULL;
+        }
+        case ART_NODE48:
+        {
+            struct art_node48_t* p_node48 = (struct art_node48_t*)p_node;
+            int index = p_node48->child_index[byte];
+
+            return index ? &p_node48->p_children[index - 1] : NULL;
+        }
+        default:
+        {
+            struct art_node256_t* p_node256 = (struct art_node256_t*)p_node;
+
+            return p_node256->p_children[byte] ? &p_node256->p_children[byte] : NULL;
+        }
+    }
+}
+
+/*
+ * Returns the first child with a byte >= from (storing its byte on p_byte); NULL if there is none. Used to visit
+ * the children in key order.
+ */
+static struct art_node_t* art_next_child( struct art_node_t* p_node, int from, unsigned char* p_byte )
+{
+    switch ( p_node->type )
+    {
+        case ART_NODE4:
+        case ART_NODE16:
+        {
+            unsigned char* p_keys = p_node->type == ART_NODE4 ? ((struct art_node4_t*)p_node)->keys :
+                                    ((struct art_node16_t*)p_node)->keys;
+            struct art_node_t** pp_children = p_node->type == ART_NODE4 ? ((struct art_node4_t*)p_node)->p_children :
+                                              ((struct art_node16_t*)p_node)->p_children;
+
+            for ( int i = 0; i < p_node->n_children; i++ )
+            {
+                if ( p_keys[i] >= from )
+                {
+                    *p_byte = p_keys[i];
+                    return pp_children[i];
+                }
+            }
+
+            return NULL;
+        }
+        case ART_NODE48:
+        {
+            struct art_node48_t* p_node48 = (struct art_node48_t*)p_node;
+
+            for ( int byte = from; byte < 256; byte++ )
+            {
+                if ( p_node48->child_index[byte] )
+                {
+                    *p_byte = byte;
+                    return p_node48->p_children[p_node48->child_index[byte] - 1];
+                }
+            }
+
+            return NULL;
+        }
+        default:
+        {
+            struct art_node256_t* p_node256 = (struct art_node256_t*)p_node;
+
+            for ( int byte = from; byte < 256; byte++ )
+            {
+                if ( p_node256->p_children[byte] )
+                {
+                    *p_byte = byte;
+                    return p_node256->p_children[byte];
+                }
+            }
+
+            return NULL;
+        }
+    }
+}
+
+/*
+ * Leaf with the smallest key below a node.
+ */
+static struct art_leaf_t* art_minimum( struct art_node_t* p_node )
+{
+    unsigned char byte;
+
+    while ( !ART_IS_LEAF( p_node ) )
+    {
+        if ( p_node->p_end_leaf )
+            return p_node->p_end_leaf;
+
+        p_node = art_next_child( p_node, 0, &byte );
+    }
+
+    return ART_LEAF( p_node );
+}
+
+/*
+ * Byte i of the compressed path of a node found at depth.
+ */
+static unsigned char art_prefix_at( struct art_node_t* p_node, size_t depth, size_t i )
+{
+    if ( i < ART_MAX_PREFIX_LEN )
+        return p_node->prefix[i];
+
+    return (unsigned char)art_minimum( p_node )->key[depth + i];
+}
+
+/*
+ * Number of leading bytes of the compressed path of a node found at depth that match the key (checks the whole
+ * path, reading it from a leaf when it's longer than the stored part).
+ */
+static size_t art_prefix_mismatch( struct art_node_t* p_node, struct entry_t* p_key, size_t depth )
+{
+    size_t max = ART_MIN( (size_t)p_node->prefix_len, p_key->keysize - depth );
+    size_t stored = ART_MIN( max, ART_MAX_PREFIX_LEN );
+    size_t i;
+
+    for ( i = 0; i < stored; i++ )
+    {
+        if ( p_node->prefix[i] != (unsigned char)p_key->key[depth + i] )
+            return i;
+    }
+
+    if ( i < max )
+    {
+        struct art_leaf_t* p_leaf = art_minimum( p_node );
+
+        for ( ; i < max; i++ )
+        {
+            if ( p_leaf->key[depth + i] != p_key->key[depth + i] )
+                return i;
+        }
+    }
+
+    return i;
+}
+
+/*
+ * Adds a child to a node with room for it.
+ */
+static void art_node_add_child_in_place( struct art_node_t* p_node, unsigned char byte, struct art_node_t* p_child )
+{
+    switch ( p_node->type )
+    {
+        case ART_NODE4:
+        case ART_NODE16:
+        {
+            unsigned char* p_keys = p_node->type == ART_NODE4 ? ((struct art_node4_t*)p_node)->keys :
+                                    ((struct art_node16_t*)p_node)->keys;
+            struct art_node_t** pp_children = p_node->type == ART_NODE4 ? ((struct art_node4_t*)p_node)->p_children :
+                                              ((struct art_node16_t*)p_node)->p_children;
+
+            // Keep the keys sorted.
+            int i = p_node->n_children;
+
+            while ( i > 0 && p_keys[i - 1] > byte )
+            {
+                p_keys[i] = p_keys[i - 1];
+                pp_children[i] = pp_children[i - 1];
+                i--;
+            }
+
+            p_keys[i] = byte;
+            pp_children[i] = p_child;
+            break;
+        }
+        case ART_NODE48:
+        {
+            struct art_node48_t* p_node48 = (struct art_node48_t*)p_node;
+
+            // Removals can leave holes: take the first free position.
+            int position = 0;
+            while ( p_node48->p_children[position] )
+                position++;
+
+            p_node48->p_children[position] = p_child;
+            p_node48->child_index[byte] = position + 1;
+            break;
+        }
+        default:
+            ((struct art_node256_t*)p_node)->p_children[byte] = p_child;
+            break;
+    }
+
+    p_node->n_children++;
+}
+
+/*
+ * Adds a child to a node, replacing it (on *pp_ref) by a bigger node if it's full.
+ *
+ * Returns:
+ *      0 (ok) or -1 on error (the node is unchanged).
+ */
+static int art_node_add_child( struct art_node_t** pp_ref, struct art_node_t* p_node, unsigned char byte,
+                               struct art_node_t* p_child )
+{
+    int capacity = p_node->type == ART_NODE4 ? 4 : p_node->type == ART_NODE16 ? 16 : p_node->type == ART_NODE48 ? 48 : 256;
+
+    if ( p_node->n_children < capacity )
+    {
+        art_node_add_child_in_place( p_node, byte, p_child );
+        return 0;
+    }
+
+    struct art_node_t* p_new_node = NULL;
+
+    if ( !(p_new_node = art_node_create( p_node->type + 1 )) )
+        return -1;
+
+    art_node_copy_header( p_new_node, p_node );
+    p_new_node->n_children = 0;
+
+    // Move every child to the new node.
+    unsigned char child_byte;
+    struct art_node_t* p_current_child;
+
+    for ( int from = 0; (p_current_child = art_next_child( p_node, from, &child_byte )); from = child_byte + 1 )
+        art_node_add_child_in_place( p_new_node, child_byte, p_current_child );
+
+    art_node_add_child_in_place( p_new_node, byte, p_child );
+
+    slab_free( p_node );
+    *pp_ref = p_new_node;
+
+    return 0;
+}
+
+/*
+ * Adds a leaf to a node whose keys all match the leaf key up to depth: as the end leaf if the key ends there, as
+ * the child of its next byte otherwise.
+ */
+static int art_node_add_leaf( struct art_node_t** pp_ref, struct art_node_t* p_node, size_t depth,
+                              struct art_leaf_t* p_leaf )
+{
+    if ( p_leaf->entry.keysize == depth )
+    {
+        p_node->p_end_leaf = p_leaf;
+        return 0;
+    }
+
+    return art_node_add_child( pp_ref, p_node, (unsigned char)p_leaf->key[depth], ART_TAG_LEAF( p_leaf ) );
+}
+
+/*
+ * Replaces a node that has too few children by a smaller node, or by its only child/leaf.
+ */
+static void art_node_shrink( struct art_node_t** pp_ref )
+{
+    struct art_node_t* p_node = *pp_ref;
+
+    int new_type = 0;
+
+    if ( p_node->type == ART_NODE256 && p_node->n_children <= 37 )
+        new_type = ART_NODE48;
+    else if ( p_node->type == ART_NODE48 && p_node->n_children <= 12 )
+        new_type = ART_NODE16;
+    else if ( p_node->type == ART_NODE16 && p_node->n_children <= 3 )
+        new_type = ART_NODE4;
+
+    if ( new_type )
+    {
+        struct art_node_t* p_new_node = NULL;
+
+        // Without memory the bigger node is kept, which is still valid.
+        if ( !(p_new_node = art_node_create( new_type )) )
+            return;
+
+        art_node_copy_header( p_new_node, p_node );
+        p_new_node->n_children = 0;
+
+        unsigned char child_byte;
+        struct art_node_t* p_child;
+
+        for ( int from = 0; (p_child = art_next_child( p_node, from, &child_byte )); from = child_byte + 1 )
+            art_node_add_child_in_place( p_new_node, child_byte, p_child );
+
+        slab_free( p_node );
+        *pp_ref = p_node = p_new_node;
+    }
+
+    if ( p_node->type != ART_NODE4 )
+        return;
+
+    struct art_node4_t* p_node4 = (struct art_node4_t*)p_node;
+
+    // Only the end leaf is left.
+    if ( p_node->n_children == 0 )
+    {
+        *pp_ref = p_node->p_end_leaf ? ART_TAG_LEAF( p_node->p_end_leaf ) : NULL;
+        slab_free( p_node );
+        return;
+    }
+
+    // One child and no end leaf: merge the node into its child.
+    if ( p_node->n_children == 1 && !p_node->p_end_leaf )
+    {
+        struct art_node_t* p_child = p_node4->p_children[0];
+
+        if ( !ART_IS_LEAF( p_child ) )
+        {
+            // New path = node path + child byte + child path (only the first ART_MAX_PREFIX_LEN bytes are kept).
+            unsigned char prefix[ART_MAX_PREFIX_LEN];
+            size_t len = ART_MIN( (size_t)p_node->prefix_len, ART_MAX_PREFIX_LEN );
+
+            memcpy( prefix, p_node->prefix, len );
+
+            if ( len < ART_MAX_PREFIX_LEN )
+                prefix[len++] = p_node4->keys[0];
+
+            size_t child_len = ART_MIN( (size_t)p_child->prefix_len, ART_MAX_PREFIX_LEN - len );
+            memcpy( prefix + len, p_child->prefix, child_len );
+            len += child_len;
+
+            memcpy( p_child->prefix, prefix, len );
+            p_child->prefix_len += p_node->prefix_len + 1;
+        }
+
+        *pp_ref = p_child;
+        slab_free( p_node );
+    }
+}
+
+/*
+ * Removes the child of a byte and shrinks the node if needed.
+ */
+static void art_node_remove_child( struct art_node_t** pp_ref, struct art_node_t* p_node, unsigned char byte )
+{
+    switch ( p_node->type )
+    {
+        case ART_NODE4:
+        case ART_NODE16:
+        {
+            unsigned char* p_keys = p_node->type == ART_NODE4 ? ((struct art_node4_t*)p_node)->keys :
+                                    ((struct art_node16_t*)p_node)->keys;
+            struct art_node_t** pp_children = p_node->type == ART_NODE4 ? ((struct art_node4_t*)p_node)->p_children :
+                                              ((struct art_node16_t*)p_node)->p_children;
+
+            int i = 0;
+            while ( p_keys[i] != byte )
+                i++;
+
+            for ( ; i < p_node->n_children - 1; i++ )
+            {
+                p_keys[i] = p_keys[i + 1];
+                pp_children[i] = pp_children[i + 1];
+            }
+
+            break;
+        }
+        case ART_NODE48:
+        {
+            struct art_node48_t* p_node48 = (struct art_node48_t*)p_node;
+
+            p_node48->p_children[p_node48->child_index[byte] - 1] = NULL;
+            p_node48->child_index[byte] = 0;
+            break;
+        }
+        default:
+            ((struct art_node256_t*)p_node)->p_children[byte] = NULL;
+            break;
+    }
+
+    p_node->n_children--;
+
+    art_node_shrink( pp_ref );
+}
+
+/*
+ * Recursive insert.
+ *
+ * Returns:
+ *      1 if a new key was added; 0 if the value of an existing key was replaced; -1 on error.
+ */
+static int art_insert( struct art_node_t** pp_ref, size_t depth, struct entry_t* p_key, struct data_t* p_value )
+{
+    struct art_node_t* p_node = *pp_ref;
+    struct art_leaf_t* p_new_leaf = NULL;
+
+    // Empty slot.
+    if ( !p_node )
+    {
+        if ( !(p_new_leaf = art_leaf_create( p_key, p_value )) )
+            return -1;
+
+        *pp_ref = ART_TAG_LEAF( p_new_leaf );
+        return 1;
+    }
+
+    // Leaf: same key, or split it with a new node on their common bytes.
+    if ( ART_IS_LEAF( p_node ) )
+    {
+        struct art_leaf_t* p_leaf = ART_LEAF( p_node );
+
+        if ( entry_key_compare( &p_leaf->entry, p_key ) == 0 )
+            return art_leaf_set_value( p_leaf, p_value ) < 0 ? -1 : 0;
+
+        struct art_node_t* p_new_node = NULL;
+
+        if ( !(p_new_leaf = art_leaf_create( p_key, p_value )) )
+            return -1;
+
+        if ( !(p_new_node = art_node_create( ART_NODE4 )) )
+        {
+            art_leaf_destroy( p_new_leaf );
+            return -1;
+        }
+
+        size_t max = ART_MIN( p_leaf->entry.keysize, p_key->keysize );
+        size_t common = depth;
+
+        while ( common < max && p_leaf->key[common] == p_key->key[common] )
+            common++;
+
+        p_new_node->prefix_len = common - depth;
+        memcpy( p_new_node->prefix, p_key->key + depth, ART_MIN( (size_t)p_new_node->prefix_len, ART_MAX_PREFIX_LEN ) );
+        p_new_node->size = 2;
+
+        // A Node4 has room for both.
+        art_node_add_leaf( &p_new_node, p_new_node, common, p_leaf );
+        art_node_add_leaf( &p_new_node, p_new_node, common, p_new_leaf );
+
+        *pp_ref = p_new_node;
+        return 1;
+    }
+
+    // Path differs from the key: split it with a new node on the matching part.
+    if ( p_node->prefix_len )
+    {
+        size_t match = art_prefix_mismatch( p_node, p_key, depth );
+
+        if ( match < p_node->prefix_len )
+        {
+            struct art_node_t* p_new_node = NULL;
+
+            if ( !(p_new_leaf = art_leaf_create( p_key, p_value )) )
+                return -1;
+
+            if ( !(p_new_node = art_node_create( ART_NODE4 )) )
+            {
+                art_leaf_destroy( p_new_leaf );
+                return -1;
+            }
+
+            p_new_node->prefix_len = match;
+            memcpy( p_new_node->prefix, p_node->prefix, ART_MIN( match, ART_MAX_PREFIX_LEN ) );
+            p_new_node->size = p_node->size + 1;
+
+            // The old node keeps the path after the branching byte.
+            unsigned char byte;
+
+            if ( p_node->prefix_len <= ART_MAX_PREFIX_LEN )
+            {
+                byte = p_node->prefix[match];
+                p_node->prefix_len -= match + 1;
+                memmove( p_node->prefix, p_node->prefix + match + 1, p_node->prefix_len );
+            }
+            else
+            {
+                struct art_leaf_t* p_minimum = art_minimum( p_node );
+
+                byte = (unsigned char)p_minimum->key[depth + match];
+                p_node->prefix_len -= match + 1;
+                memcpy( p_node->prefix, p_minimum->key + depth + match + 1,
+                        ART_MIN( (size_t)p_node->prefix_len, ART_MAX_PREFIX_LEN ) );
+            }
+
+            art_node_add_child_in_place( p_new_node, byte, p_node );
+            art_node_add_leaf( &p_new_node, p_new_node, depth + match, p_new_leaf );
+
+            *pp_ref = p_new_node;
+            return 1;
+        }
+
+        depth += p_node->prefix_len;
+    }
+
+    // Key ends at this node.
+    if ( depth == p_key->keysize )
+    {
+        if ( p_node->p_end_leaf )
+            return art_leaf_set_value( p_node->p_end_leaf, p_value ) < 0 ? -1 : 0;
+
+        if ( !(p_node->p_end_leaf = art_leaf_create( p_key, p_value )) )
+            return -1;
+
+        p_node->size++;
+        return 1;
+    }
+
+    unsigned char byte = (unsigned char)p_key->key[depth];
+    struct art_node_t** pp_child = art_find_child( p_node, byte );
+
+    if ( pp_child )
+    {
+        int result = art_insert( pp_child, depth + 1, p_key, p_value );
+
+        if ( result == 1 )
+            p_node->size++;
+
+        return result;
+    }
+
+    if ( !(p_new_leaf = art_leaf_create( p_key, p_value )) )
+        return -1;
+
+    // Size is copied if the node grows.
+    p_node->size++;
+
+    if ( art_node_add_child( pp_ref, p_node, byte, ART_TAG_LEAF( p_new_leaf ) ) < 0 )
+    {
+        p_node->size--;
+        art_leaf_destroy( p_new_leaf );
+        return -1;
+    }
+
+    return 1;
+}
+
+/*
+ * Recursive delete.
+ *
+ * Returns:
+ *      0 if the key was removed; -1 if it isn't on the tree.
+ */
+static int art_delete( struct art_node_t** pp_ref, size_t depth, struct entry_t* p_key )
+{
+    struct art_node_t* p_node = *pp_ref;
+
+    if ( !p_node )
+        return -1;
+
+    if ( ART_IS_LEAF( p_node ) )
+    {
+        if ( entry_key_compare( &ART_LEAF( p_node )->entry, p_key ) != 0 )
+            return -1;
+
+        art_leaf_destroy( ART_LEAF( p_node ) );
+        *pp_ref = NULL;
+        return 0;
+    }
+
+    if ( p_node->prefix_len )
+    {
+        if ( art_prefix_mismatch( p_node, p_key, depth ) != p_node->prefix_len )
+            return -1;
+
+        depth += p_node->prefix_len;
+    }
+
+    if ( depth == p_key->keysize )
+    {
+        if ( !p_node->p_end_leaf )
+            return -1;
+
+        art_leaf_destroy( p_node->p_end_leaf );
+        p_node->p_end_leaf = NULL;
+        p_node->size--;
+
+        art_node_shrink( pp_ref );
+        return 0;
+    }
+
+    unsigned char byte = (unsigned char)p_key->key[depth];
+    struct art_node_t** pp_child = art_find_child( p_node, byte );
+
+    if ( !pp_child )
+        return -1;
+
+    if ( ART_IS_LEAF( *pp_child ) )
+    {
+        if ( entry_key_compare( &ART_LEAF( *pp_child )->entry, p_key ) != 0 )
+            return -1;
+
+        art_leaf_destroy( ART_LEAF( *pp_child ) );
+        p_node->size--;
+
+        art_node_remove_child( pp_ref, p_node, byte );
+        return 0;
+    }
+
+    if ( art_delete( pp_child, depth + 1, p_key ) < 0 )
+        return -1;
+
+    p_node->size--;
+    return 0;
+}
+
+int tree_art_put( struct tree_t* p_tree, struct entry_t* p_key, struct data_t* p_value )
+{
+    int result = art_insert( &p_tree->p_art_root, 0, p_key, p_value );
+
+    if ( result == 1 )
+        p_tree->size++;
+
+    return result < 0 ? -1 : 0;
+}
+
+struct entry_t* tree_art_find( struct tree_t* p_tree, struct entry_t* p_key )
+{
+    struct art_node_t* p_node = p_tree->p_art_root;
+    size_t depth = 0;
+
+    while ( p_node )
+    {
+        if ( ART_IS_LEAF( p_node ) )
+        {
+            struct art_leaf_t* p_leaf = ART_LEAF( p_node );
+            return entry_key_compare( &p_leaf->entry, p_key ) == 0 ? &p_leaf->entry : NULL;
+        }
+
+        // Only the stored part of the path is checked; the leaf compare checks the whole key.
+        if ( p_node->prefix_len )
+        {
+            if ( p_key->keysize - depth < p_node->prefix_len ||
+                 memcmp( p_node->prefix, p_key->key + depth, ART_MIN( (size_t)p_node->prefix_len, ART_MAX_PREFIX_LEN ) ) )
+                return NULL;
+
+            depth += p_node->prefix_len;
+        }
+
+        if ( depth == p_key->keysize )
+        {
+            struct art_leaf_t* p_leaf = p_node->p_end_leaf;
+            return p_leaf && entry_key_compare( &p_leaf->entry, p_key ) == 0 ? &p_leaf->entry : NULL;
+        }
+
+        struct art_node_t** pp_child = art_find_child( p_node, (unsigned char)p_key->key[depth] );
+
+        if ( !pp_child )
+            return NULL;
+
+        p_node = *pp_child;
+        depth++;
+    }
+
+    return NULL;
+}
+
+int tree_art_del( struct tree_t* p_tree, struct entry_t* p_key )
+{
+    if ( art_delete( &p_tree->p_art_root, 0, p_key ) < 0 )
+        return -1;
+
+    p_tree->size--;
+    return 0;
+}
+
+int tree_art_height( struct art_node_t* p_node )
+{
+    if ( !p_node )
+        return 0;
+
+    if ( ART_IS_LEAF( p_node ) )
+        return 1;
+
+    int max_height = p_node->p_end_leaf ? 1 : 0;
+    unsigned char byte;
+    struct art_node_t* p_child;
+
+    for ( int from = 0; (p_child = art_next_child( p_node, from, &byte )); from = byte + 1 )
+    {
+        int height = tree_art_height( p_child );
+
+        if ( height > max_height )
+            max_height = height;
+    }
+
+    return max_height + 1;
+}
+
+struct entry_t* tree_art_entry_at( struct tree_t* p_tree, size_t index )
+{
+    if ( index >= p_tree->size )
+        return NULL;
+
+    struct art_node_t* p_node = p_tree->p_art_root;
+
+    while ( p_node && !ART_IS_LEAF( p_node ) )
+    {
+        // The end leaf is the first key of the node.
+        if ( p_node->p_end_leaf )
+        {
+            if ( index == 0 )
+                return &p_node->p_end_leaf->entry;
+
+            index--;
+        }
+
+        unsigned char byte;
+        struct art_node_t* p_child;
+
+        for ( int from = 0; (p_child = art_next_child( p_node, from, &byte )); from = byte + 1 )
+        {
+            size_t child_size = art_child_size( p_child );
+
+            if ( index < child_size )
+                break;
+
+            index -= child_size;
+        }
+
+        p_node = p_child;
+    }
+
+    return p_node ? &ART_LEAF( p_node )->entry : NULL;
+}
+
+size_t tree_art_rank( struct tree_t* p_tree, struct entry_t* p_key )
+{
+    struct art_node_t* p_node = p_tree->p_art_root;
+    size_t depth = 0;
+    size_t rank = 0;
+
+    while ( p_node )
+    {
+        if ( ART_IS_LEAF( p_node ) )
+            return rank + (entry_key_compare( &ART_LEAF( p_node )->entry, p_key ) < 0);
+
+        if ( p_node->prefix_len )
+        {
+            size_t match = art_prefix_mismatch( p_node, p_key, depth );
+
+            // Path differs from the key: the whole subtree is either smaller or bigger.
+            if ( match < p_node->prefix_len && depth + match < p_key->keysize )
+                return art_prefix_at( p_node, depth, match ) < (unsigned char)p_key->key[depth + match] ?
+                       rank + p_node->size : rank;
+
+            // Key ends inside the path: every key below is bigger.
+            if ( match < p_node->prefix_len )
+                return rank;
+
+            depth += p_node->prefix_len;
+        }
+
+        // Every key below starts with the key.
+        if ( depth == p_key->keysize )
+            return rank;
+
+        // The end leaf is a prefix of the key.
+        if ( p_node->p_end_leaf )
+            rank++;
+
+        unsigned char key_byte = (unsigned char)p_key->key[depth];
+        unsigned char byte;
+        struct art_node_t* p_child;
+        struct art_node_t* p_next_node = NULL;
+
+        for ( int from = 0; (p_child = art_next_child( p_node, from, &byte )) && byte <= key_byte; from = byte + 1 )
+        {
+            if ( byte == key_byte )
+                p_next_node = p_child;
+            else
+                rank += art_child_size( p_child );
+        }
+
+        p_node = p_next_node;
+        depth++;
+    }
+
+    return rank;
+}
+
+/*
+ * Recursive walk. is_bounded is set while the keys of p_node may still be smaller than the start key.
+ *
+ * Returns:
+ *      Non zero if the callback stopped the walk.
+ */
+static int art_walk( struct art_node_t* p_node, size_t depth, int is_bounded, struct art_walk_t* p_walk )
+{
+    if ( ART_IS_LEAF( p_node ) )
+    {
+        struct art_leaf_t* p_leaf = ART_LEAF( p_node );
+
+        if ( is_bounded && entry_key_compare( &p_leaf->entry, p_walk->p_start_key ) < 0 )
+            return 0;
+
+        if ( p_walk->skip )
+        {
+            p_walk->skip--;
+            return 0;
+        }
+
+        return p_walk->callback( &p_leaf->entry, p_walk->p_context );
+    }
+
+    // Whole subtree is skipped.
+    if ( !is_bounded && p_walk->skip >= p_node->size )
+    {
+        p_walk->skip -= p_node->size;
+        return 0;
+    }
+
+    struct entry_t* p_start_key = p_walk->p_start_key;
+
+    if ( is_bounded && p_node->prefix_len )
+    {
+        size_t match = art_prefix_mismatch( p_node, p_start_key, depth );
+
+        if ( match < p_node->prefix_len && depth + match < p_start_key->keysize )
+        {
+            // Whole subtree is before the start key.
+            if ( art_prefix_at( p_node, depth, match ) < (unsigned char)p_start_key->key[depth + match] )
+                return 0;
+
+            // Whole subtree is after the start key.
+            is_bounded = 0;
+        }
+        else if ( match < p_node->prefix_len )
+        {
+            // Start key ends inside the path.
+            is_bounded = 0;
+        }
+    }
+
+    depth += p_node->prefix_len;
+
+    // Every key below starts with the start key.
+    if ( is_bounded && depth == p_start_key->keysize )
+        is_bounded = 0;
+
+    // The end leaf is a proper prefix of the start key (so smaller) while bounded.
+    if ( p_node->p_end_leaf && !is_bounded )
+    {
+        if ( art_walk( ART_TAG_LEAF( p_node->p_end_leaf ), depth, 0, p_walk ) )
+            return 1;
+    }
+
+    int from = is_bounded ? (unsigned char)p_start_key->key[depth] : 0;
+    unsigned char byte;
+    struct art_node_t* p_child;
+
+    for ( ; (p_child = art_next_child( p_node, from, &byte )); from = byte + 1 )
+    {
+        int is_child_bounded = is_bounded && byte == (unsigned char)p_start_key->key[depth];
+
+        if ( art_walk( p_child, depth + 1, is_child_bounded, p_walk ) )
+            return 1;
+    }
+
+    return 0;
+}
+
+int tree_art_walk( struct tree_t* p_tree, struct entry_t* p_start_key, size_t skip,
+                   int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    if ( !p_tree->p_art_root )
+        return 0;
+
+    struct art_walk_t walk = { p_start_key, skip, callback, p_context };
+
+    return art_walk( p_tree->p_art_root, 0, p_start_key != NULL, &walk );
+}
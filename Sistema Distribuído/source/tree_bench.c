@@ -0,0 +1,284 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "tree.h"
+#include "entry.h"
+#include "data.h"
+#include "slab.h"
+#include "tree_shard-private.h"
+
+#define BENCH_DEFAULT_KEYS 1000000
+#define BENCH_KEY_SIZE 40
+
+// Sorted inserts on the unbalanced tree are O(n^2): above this many keys the run is capped.
+#define BENCH_BST_SORTED_MAX 20000
+
+static double elapsed_ns( struct timespec *p_start, struct timespec *p_end )
+{
+    return (double)(p_end->tv_sec - p_start->tv_sec) * 1e9 + (double)(p_end->tv_nsec - p_start->tv_nsec);
+}
+
+// Scaling runs: thread counts (1, 2, 4, ... BENCH_MAX_THREADS) and share of puts among the operations (1 in N).
+#define BENCH_MAX_THREADS 16
+#define BENCH_PUT_ONE_IN 4
+
+// Key formats. The prefix heavy keys share their first 22 bytes, like the paths of a hierarchical namespace.
+#define BENCH_KEY_FORMAT        "key%010d"
+#define BENCH_PREFIX_KEY_FORMAT "user/profile/settings/%010d"
+
+/*
+ * Creates n keys with the given format and a 10 digit number, in ascending order.
+ */
+static char **bench_keys_create( const char *p_format, int n )
+{
+    char **pp_keys = (char **)malloc( sizeof( char * ) * n );
+
+    for ( int i = 0; i < n; i++ )
+    {
+        pp_keys[i] = (char *)malloc( BENCH_KEY_SIZE );
+        snprintf( pp_keys[i], BENCH_KEY_SIZE, p_format, i );
+    }
+
+    return pp_keys;
+}
+
+static void bench_keys_shuffle( char **pp_keys, int n )
+{
+    for ( int i = n - 1; i > 0; i-- )
+    {
+        int j = rand() % (i + 1);
+        char *p_aux = pp_keys[i];
+        pp_keys[i] = pp_keys[j];
+        pp_keys[j] = p_aux;
+    }
+}
+
+static void bench_keys_destroy( char **pp_keys, int n )
+{
+    for ( int i = 0; i < n; i++ )
+        free( pp_keys[i] );
+
+    free( pp_keys );
+}
+
+static int bench_scan_callback( struct entry_t *p_entry, void *p_context )
+{
+    (void)p_entry;
+
+    (*(int *)p_context)++;
+
+    return 0;
+}
+
+/*
+ * Inserts, looks up and then iterates in order over n keys on a new tree of the given type, printing the average
+ * cost per operation. With is_bulk set the keys (which must be sorted) are inserted with a single tree_bulk_load.
+ */
+static void bench_run( const char *p_name, int type, char **pp_keys, int n, int is_bulk )
+{
+    struct tree_t *p_tree = tree_create2( type );
+    struct data_t *p_value = data_create( 8 );
+    struct entry_t **pp_entries = NULL;
+    struct timespec start, end;
+
+    if ( is_bulk )
+    {
+        pp_entries = (struct entry_t **)malloc( sizeof( struct entry_t * ) * n );
+
+        for ( int i = 0; i < n; i++ )
+            pp_entries[i] = entry_create( pp_keys[i], p_value );
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    if ( is_bulk )
+        tree_bulk_load( p_tree, pp_entries, n );
+    else
+    {
+        for ( int i = 0; i < n; i++ )
+            tree_put( p_tree, pp_keys[i], p_value );
+    }
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    if ( is_bulk )
+    {
+        // The entries only borrowed the keys and the value.
+        for ( int i = 0; i < n; i++ )
+            slab_free( pp_entries[i] );
+
+        free( pp_entries );
+    }
+
+    double put_ns = elapsed_ns( &start, &end ) / n;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for ( int i = 0; i < n; i++ )
+        data_destroy( tree_get( p_tree, pp_keys[i] ) );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    double get_ns = elapsed_ns( &start, &end ) / n;
+
+    int n_scanned = 0;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    tree_scan( p_tree, NULL, NULL, 0, bench_scan_callback, &n_scanned );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    double scan_ns = elapsed_ns( &start, &end ) / n_scanned;
+
+    printf( "%-20s %10d %12.1f %12.1f %12.1f %10d\n", p_name, n, put_ns, get_ns, scan_ns, tree_height( p_tree ) );
+
+    data_destroy( p_value );
+    tree_destroy( p_tree );
+}
+
+/*
+ * Work of one thread of a scaling run.
+ */
+struct bench_thread_t
+{
+    struct tree_shards_t *p_shards;
+    char **pp_keys;
+    int n_keys;
+    int n_ops;
+    unsigned int seed;
+};
+
+static void *bench_thread_run( void *p_params )
+{
+    struct bench_thread_t *p_work = (struct bench_thread_t *)p_params;
+
+    for ( int i = 0; i < p_work->n_ops; i++ )
+    {
+        char *p_key = p_work->pp_keys[rand_r( &p_work->seed ) % p_work->n_keys];
+
+        if ( rand_r( &p_work->seed ) % BENCH_PUT_ONE_IN == 0 )
+            tree_shards_put_take( p_work->p_shards, p_key, strlen( p_key ), data_create( 8 ) );
+        else
+            data_destroy( tree_shards_get2( p_work->p_shards, p_key, strlen( p_key ) ) );
+    }
+
+    slab_thread_cache_flush();
+
+    return NULL;
+}
+
+/*
+ * Runs n operations (random keys, 1 in BENCH_PUT_ONE_IN a put, the rest gets) split over 1 to BENCH_MAX_THREADS
+ * threads on a store with n_shards shards holding the n keys, printing the throughput of each thread count.
+ */
+static void bench_threads_run( const char *p_name, int type, int n_shards, char **pp_keys, int n )
+{
+    struct tree_shards_t *p_shards = tree_shards_create( n_shards, type );
+    struct bench_thread_t work[BENCH_MAX_THREADS];
+    pthread_t threads[BENCH_MAX_THREADS];
+    struct timespec start, end;
+
+    for ( int i = 0; i < n; i++ )
+        tree_shards_put_take( p_shards, pp_keys[i], strlen( pp_keys[i] ), data_create( 8 ) );
+
+    printf( "%-20s %10d", p_name, n_shards );
+
+    for ( int n_threads = 1; n_threads <= BENCH_MAX_THREADS; n_threads *= 2 )
+    {
+        clock_gettime( CLOCK_MONOTONIC, &start );
+
+        for ( int i = 0; i < n_threads; i++ )
+        {
+            work[i] = (struct bench_thread_t){ p_shards, pp_keys, n, n / n_threads, 55 + i };
+            pthread_create( &threads[i], NULL, bench_thread_run, &work[i] );
+        }
+
+        for ( int i = 0; i < n_threads; i++ )
+            pthread_join( threads[i], NULL );
+
+        clock_gettime( CLOCK_MONOTONIC, &end );
+
+        // Millions of operations per second.
+        printf( " %8.2f", (double)(n / n_threads * n_threads) * 1e3 / elapsed_ns( &start, &end ) );
+    }
+
+    printf( "\n" );
+
+    tree_shards_destroy( p_shards );
+}
+
+int main( int argc, char **argv )
+{
+    int n_keys = BENCH_DEFAULT_KEYS;
+
+    if ( argc > 1 && (n_keys = atoi( argv[1] )) <= 0 )
+    {
+        printf( "Usage: ./tree-bench [n_keys]\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    srand( 55 );
+
+    char **pp_keys = bench_keys_create( BENCH_KEY_FORMAT, n_keys );
+    int bst_sorted_keys = n_keys < BENCH_BST_SORTED_MAX ? n_keys : BENCH_BST_SORTED_MAX;
+
+    printf( "%-20s %10s %12s %12s %12s %10s\n", "engine/order", "keys", "put ns/op", "get ns/op", "scan ns/key",
+            "height" );
+
+    bench_run( "bst/sorted", TREE_BST, pp_keys, bst_sorted_keys, 0 );
+    bench_run( "avl/sorted", TREE_AVL, pp_keys, bst_sorted_keys, 0 );
+    bench_run( "avl/sorted", TREE_AVL, pp_keys, n_keys, 0 );
+    bench_run( "art/sorted", TREE_ART, pp_keys, n_keys, 0 );
+    bench_run( "bptree/sorted", TREE_BPLUS, pp_keys, n_keys, 0 );
+    bench_run( "cow/sorted", TREE_COW, pp_keys, n_keys, 0 );
+    bench_run( "bst/bulk", TREE_BST, pp_keys, n_keys, 1 );
+    bench_run( "avl/bulk", TREE_AVL, pp_keys, n_keys, 1 );
+    bench_run( "art/bulk", TREE_ART, pp_keys, n_keys, 1 );
+    bench_run( "bptree/bulk", TREE_BPLUS, pp_keys, n_keys, 1 );
+    bench_run( "cow/bulk", TREE_COW, pp_keys, n_keys, 1 );
+
+    bench_keys_shuffle( pp_keys, n_keys );
+
+    bench_run( "bst/random", TREE_BST, pp_keys, n_keys, 0 );
+    bench_run( "avl/random", TREE_AVL, pp_keys, n_keys, 0 );
+    bench_run( "avl+hash/random", TREE_AVL | TREE_HASH_INDEX, pp_keys, n_keys, 0 );
+    bench_run( "art/random", TREE_ART, pp_keys, n_keys, 0 );
+    bench_run( "bptree/random", TREE_BPLUS, pp_keys, n_keys, 0 );
+    bench_run( "cow/random", TREE_COW, pp_keys, n_keys, 0 );
+
+    bench_keys_destroy( pp_keys, n_keys );
+
+    // Long shared prefix: the binary trees compare it on every node, the radix tree compresses it away.
+    pp_keys = bench_keys_create( BENCH_PREFIX_KEY_FORMAT, n_keys );
+    bench_keys_shuffle( pp_keys, n_keys );
+
+    bench_run( "bst/prefix/random", TREE_BST, pp_keys, n_keys, 0 );
+    bench_run( "avl/prefix/random", TREE_AVL, pp_keys, n_keys, 0 );
+    bench_run( "art/prefix/random", TREE_ART, pp_keys, n_keys, 0 );
+    bench_run( "bptree/prefix/random", TREE_BPLUS, pp_keys, n_keys, 0 );
+
+    bench_keys_destroy( pp_keys, n_keys );
+
+    // One lock for the whole tree (1 shard) against a lock per shard, from 1 to BENCH_MAX_THREADS threads.
+    pp_keys = bench_keys_create( BENCH_KEY_FORMAT, n_keys );
+
+    printf( "\n%-20s %10s", "engine/threads", "shards" );
+    for ( int n_threads = 1; n_threads <= BENCH_MAX_THREADS; n_threads *= 2 )
+        printf( " %8d", n_threads );
+    printf( "   (Mops/s, 1 put in %d)\n", BENCH_PUT_ONE_IN );
+
+    bench_threads_run( "avl+hash", TREE_AVL | TREE_HASH_INDEX, 1, pp_keys, n_keys );
+    bench_threads_run( "avl+hash", TREE_AVL | TREE_HASH_INDEX, 16, pp_keys, n_keys );
+    bench_threads_run( "art", TREE_ART, 1, pp_keys, n_keys );
+    bench_threads_run( "art", TREE_ART, 16, pp_keys, n_keys );
+    bench_threads_run( "bptree", TREE_BPLUS, 1, pp_keys, n_keys );
+    bench_threads_run( "bptree", TREE_BPLUS, 16, pp_keys, n_keys );
+    bench_threads_run( "cow", TREE_COW, 1, pp_keys, n_keys );
+    bench_threads_run( "cow", TREE_COW, 16, pp_keys, n_keys );
+
+    bench_keys_destroy( pp_keys, n_keys );
+
+    printf( "\n" );
+    slab_print_stats( stdout );
+
+    exit( EXIT_SUCCESS );
+}
@@ -0,0 +1,1099 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree-private.h"
+#include "tree_bptree-private.h"
+#include "entry-private.h"
+#include "slab.h"
+
+// Nodes other than the root are rebalanced below these sizes.
+#define BPT_LEAF_MIN ((BPT_LEAF_SLOTS) / 2)
+#define BPT_INNER_MIN_KEYS ((BPT_INNER_SLOTS - 1) / 2)
+
+static struct bpt_leaf_t* bpt_leaf_create()
+{
+    struct bpt_leaf_t* p_leaf = NULL;
+
+    if ( !(p_leaf = (struct bpt_leaf_t*)malloc( sizeof( struct bpt_leaf_t ) )) )
+        return NULL;
+
+    p_leaf->header.is_leaf = 1;
+    p_leaf->header.n = 0;
+    p_leaf->header.prefix_len = 0;
+    p_leaf->p_next = NULL;
+
+    return p_leaf;
+}
+
+static struct bpt_inner_t* bpt_inner_create()
+{
+    struct bpt_inner_t* p_inner = NULL;
+
+    if ( !(p_inner = (struct bpt_inner_t*)malloc( sizeof( struct bpt_inner_t ) )) )
+        return NULL;
+
+    p_inner->header.is_leaf = 0;
+    p_inner->header.n = 0;
+    p_inner->header.prefix_len = 0;
+
+    return p_inner;
+}
+
+/*
+ * Sets p_dest to an owned copy of a key ('\0' terminated).
+ *
+ * Returns:
+ *      0 (ok) or -1 on error.
+ */
+static int bpt_key_copy( struct entry_t* p_dest, struct entry_t* p_key )
+{
+    char* p_copy = NULL;
+
+    if ( !(p_copy = (char*)slab_alloc( p_key->keysize + 1 )) )
+        return -1;
+
+    memcpy( p_copy, p_key->key, p_key->keysize );
+    p_copy[p_key->keysize] = '\0';
+
+    entry_key_set( p_dest, p_copy, p_key->keysize );
+    p_dest->value = NULL;
+
+    return 0;
+}
+
+/*
+ * Head of a key after a node prefix of prefix_len bytes.
+ */
+static uint64_t bpt_key_head( struct entry_t* p_key, size_t prefix_len )
+{
+    return entry_key_prefix( p_key->key + prefix_len, p_key->keysize - prefix_len );
+}
+
+/*
+ * Recomputes the prefix shared by the keys of a node (the common prefix of its first and last keys) and, when it
+ * changed or force is set, the heads of all its keys.
+ *
+ * Parameters:
+ *      p_node: Node.
+ *      p_keys: Sorted keys of the node.
+ *      p_heads: Heads of the keys.
+ *      force: Non zero if the heads must be recomputed (keys came from another node).
+ */
+static void bpt_node_refresh( struct bpt_node_t* p_node, struct entry_t* p_keys, uint64_t* p_heads, int force )
+{
+    int n = p_node->n;
+    size_t prefix_len = 0;
+
+    if ( n > 0 )
+    {
+        struct entry_t* p_first = &p_keys[0];
+        struct entry_t* p_last = &p_keys[n - 1];
+        size_t max_len = p_first->keysize < p_last->keysize ? p_first->keysize : p_last->keysize;
+
+        while ( prefix_len < max_len && p_first->key[prefix_len] == p_last->key[prefix_len] )
+            prefix_len++;
+    }
+
+    if ( !force && prefix_len == p_node->prefix_len )
+        return;
+
+    p_node->prefix_len = prefix_len;
+
+    for ( int i = 0; i < n; i++ )
+        p_heads[i] = bpt_key_head( &p_keys[i], prefix_len );
+}
+
+/*
+ * Position of the first key of a node >= p_key (n if there is none).
+ *
+ * Parameters:
+ *      p_node: Node.
+ *      p_keys: Sorted keys of the node.
+ *      p_heads: Heads of the keys.
+ *      p_key: Key to look for.
+ *      p_found: Set to 1 if the key on the position is p_key, 0 otherwise.
+ */
+static int bpt_node_search( struct bpt_node_t* p_node, struct entry_t* p_keys, uint64_t* p_heads,
+                            struct entry_t* p_key, int* p_found )
+{
+    int n = p_node->n;
+    size_t prefix_len = p_node->prefix_len;
+
+    *p_found = 0;
+
+    if ( n == 0 )
+        return 0;
+
+    // A key without the node prefix is smaller or bigger than all the keys of the node.
+    if ( prefix_len > 0 )
+    {
+        size_t compare_len = p_key->keysize < prefix_len ? p_key->keysize : prefix_len;
+        int compare_value = memcmp( p_key->key, p_keys[0].key, compare_len );
+
+        if ( compare_value < 0 || (compare_value == 0 && p_key->keysize < prefix_len) )
+            return 0;
+
+        if ( compare_value > 0 )
+            return n;
+    }
+
+    uint64_t head = bpt_key_head( p_key, prefix_len );
+
+    // Range of keys with the same head.
+    int low = 0;
+    int high = n;
+
+    while ( low < high )
+    {
+        int middle = (low + high) / 2;
+
+        if ( p_heads[middle] < head )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    high = low;
+
+    while ( high < n && p_heads[high] == head )
+        high++;
+
+    // Only those are compared in full.
+    while ( low < high )
+    {
+        int middle = (low + high) / 2;
+
+        if ( entry_key_compare( &p_keys[middle], p_key ) < 0 )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    *p_found = low < n && p_heads[low] == head && entry_key_compare( &p_keys[low], p_key ) == 0;
+
+    return low;
+}
+
+static int bpt_leaf_search( struct bpt_leaf_t* p_leaf, struct entry_t* p_key, int* p_found )
+{
+    return bpt_node_search( &p_leaf->header, p_leaf->entries, p_leaf->heads, p_key, p_found );
+}
+
+/*
+ * Child of an inner node that holds p_key: the number of separator keys <= p_key.
+ */
+static int bpt_child_index( struct bpt_inner_t* p_inner, struct entry_t* p_key )
+{
+    int found;
+    int position = bpt_node_search( &p_inner->header, p_inner->keys, p_inner->heads, p_key, &found );
+
+    return found ? position + 1 : position;
+}
+
+/*
+ * Number of entries below a node.
+ */
+static size_t bpt_node_size( struct bpt_node_t* p_node )
+{
+    if ( p_node->is_leaf )
+        return p_node->n;
+
+    struct bpt_inner_t* p_inner = (struct bpt_inner_t*)p_node;
+    size_t size = 0;
+
+    for ( int i = 0; i <= p_node->n; i++ )
+        size += p_inner->counts[i];
+
+    return size;
+}
+
+static int bpt_node_is_full( struct bpt_node_t* p_node )
+{
+    return p_node->n == (p_node->is_leaf ? BPT_LEAF_SLOTS : BPT_INNER_SLOTS - 1);
+}
+
+void tree_bpt_destroy( struct bpt_node_t* p_node )
+{
+    if ( !p_node )
+        return;
+
+    if ( p_node->is_leaf )
+    {
+        struct bpt_leaf_t* p_leaf = (struct bpt_leaf_t*)p_node;
+
+        for ( int i = 0; i < p_node->n; i++ )
+        {
+            slab_free( p_leaf->entries[i].key );
+            data_destroy( p_leaf->entries[i].value );
+        }
+    }
+    else
+    {
+        struct bpt_inner_t* p_inner = (struct bpt_inner_t*)p_node;
+
+        for ( int i = 0; i < p_node->n; i++ )
+            slab_free( p_inner->keys[i].key );
+
+        for ( int i = 0; i <= p_node->n; i++ )
+            tree_bpt_destroy( p_inner->p_children[i] );
+    }
+
+    free( p_node );
+}
+
+/*
+ * Copies count entries (with their heads) from p_src[src_position] to p_dest[dest_position]. Both may be the same
+ * leaf. Sizes and heads of entries that changed node are left to the caller.
+ */
+static void bpt_leaf_copy( struct bpt_leaf_t* p_dest, int dest_position, struct bpt_leaf_t* p_src, int src_position,
+                           int count )
+{
+    memmove( &p_dest->heads[dest_position], &p_src->heads[src_position], count * sizeof( uint64_t ) );
+    memmove( &p_dest->entries[dest_position], &p_src->entries[src_position], count * sizeof( struct entry_t ) );
+}
+
+/*
+ * Inserts an entry on a leaf with room for it. The key buffer and the value become owned by the leaf.
+ */
+static void bpt_leaf_insert_at( struct bpt_leaf_t* p_leaf, int position, char* p_key, size_t keysize,
+                                struct data_t* p_value )
+{
+    bpt_leaf_copy( p_leaf, position + 1, p_leaf, position, p_leaf->header.n - position );
+
+    struct entry_t* p_entry = &p_leaf->entries[position];
+
+    entry_key_set( p_entry, p_key, keysize );
+    p_entry->value = p_value;
+    p_leaf->header.n++;
+
+    bpt_node_refresh( &p_leaf->header, p_leaf->entries, p_leaf->heads, 0 );
+    p_leaf->heads[position] = bpt_key_head( p_entry, p_leaf->header.prefix_len );
+}
+
+/*
+ * Moves count entries of a leaf, starting on from, to the end of another leaf.
+ */
+static void bpt_leaf_move( struct bpt_leaf_t* p_dest, struct bpt_leaf_t* p_src, int from, int count )
+{
+    bpt_leaf_copy( p_dest, p_dest->header.n, p_src, from, count );
+    p_dest->header.n += count;
+
+    bpt_leaf_copy( p_src, from, p_src, from + count, p_src->header.n - from - count );
+    p_src->header.n -= count;
+
+    bpt_node_refresh( &p_dest->header, p_dest->entries, p_dest->heads, 1 );
+    bpt_node_refresh( &p_src->header, p_src->entries, p_src->heads, 1 );
+}
+
+/*
+ * Adds or replaces a key on a leaf, splitting it when it is full.
+ *
+ * Parameters:
+ *      p_leaf: Leaf where the key belongs.
+ *      p_key: Key.
+ *      p_value: Value, copied.
+ *      pp_split_node: Set to the new right sibling if the leaf was split.
+ *      p_split_key: Set to the separator of the new sibling (an owned copy of its first key) if the leaf was split.
+ *
+ * Returns:
+ *      1 if the key was added, 0 if its value was replaced, -1 on error (the leaf is left unchanged).
+ */
+static int bpt_leaf_insert( struct bpt_leaf_t* p_leaf, struct entry_t* p_key, struct data_t* p_value,
+                            struct bpt_node_t** pp_split_node, struct entry_t* p_split_key )
+{
+    int found;
+    int position = bpt_leaf_search( p_leaf, p_key, &found );
+
+    struct data_t* p_new_value = NULL;
+
+    if ( !(p_new_value = data_share( p_value )) )
+        return -1;
+
+    if ( found )
+    {
+        // Readers may still hold a reference to the old value.
+        data_destroy( p_leaf->entries[position].value );
+        p_leaf->entries[position].value = p_new_value;
+        return 0;
+    }
+
+    char* p_key_copy = NULL;
+
+    if ( !(p_key_copy = (char*)slab_alloc( p_key->keysize + 1 )) )
+    {
+        data_destroy( p_new_value );
+        return -1;
+    }
+
+    memcpy( p_key_copy, p_key->key, p_key->keysize );
+    p_key_copy[p_key->keysize] = '\0';
+
+    if ( !bpt_node_is_full( &p_leaf->header ) )
+    {
+        bpt_leaf_insert_at( p_leaf, position, p_key_copy, p_key->keysize, p_new_value );
+        return 1;
+    }
+
+    // Split: the left leaf keeps the first half of the BPT_LEAF_SLOTS + 1 entries, the new leaf gets the rest.
+    int left_count = (BPT_LEAF_SLOTS + 1) / 2;
+
+    struct bpt_leaf_t* p_right = NULL;
+
+    if ( !(p_right = bpt_leaf_create()) )
+    {
+        slab_free( p_key_copy );
+        data_destroy( p_new_value );
+        return -1;
+    }
+
+    // First key of the new leaf, taken before anything is moved so a failed copy leaves the leaf unchanged.
+    struct entry_t* p_first_right = position < left_count ? &p_leaf->entries[left_count - 1]
+                                  : position == left_count ? p_key
+                                  : &p_leaf->entries[left_count];
+
+    if ( bpt_key_copy( p_split_key, p_first_right ) < 0 )
+    {
+        free( p_right );
+        slab_free( p_key_copy );
+        data_destroy( p_new_value );
+        return -1;
+    }
+
+    if ( position < left_count )
+    {
+        bpt_leaf_move( p_right, p_leaf, left_count - 1, p_leaf->header.n - (left_count - 1) );
+        bpt_leaf_insert_at( p_leaf, position, p_key_copy, p_key->keysize, p_new_value );
+    }
+    else
+    {
+        bpt_leaf_move( p_right, p_leaf, left_count, p_leaf->header.n - left_count );
+        bpt_leaf_insert_at( p_right, position - left_count, p_key_copy, p_key->keysize, p_new_value );
+    }
+
+    p_right->p_next = p_leaf->p_next;
+    p_leaf->p_next = p_right;
+
+    *pp_split_node = &p_right->header;
+
+    return 1;
+}
+
+/*
+ * Copies count separator keys (with their heads) from p_src[src_position] to p_dest[dest_position]. Both may be
+ * the same node.
+ */
+static void bpt_inner_copy_keys( struct bpt_inner_t* p_dest, int dest_position, struct bpt_inner_t* p_src,
+                                 int src_position, int count )
+{
+    memmove( &p_dest->heads[dest_position], &p_src->heads[src_position], count * sizeof( uint64_t ) );
+    memmove( &p_dest->keys[dest_position], &p_src->keys[src_position], count * sizeof( struct entry_t ) );
+}
+
+/*
+ * Sets a separator key of an inner node (the key isn't copied) and updates the heads.
+ */
+static void bpt_inner_set_key( struct bpt_inner_t* p_inner, int index, struct entry_t* p_key )
+{
+    p_inner->keys[index] = *p_key;
+
+    bpt_node_refresh( &p_inner->header, p_inner->keys, p_inner->heads, 0 );
+    p_inner->heads[index] = bpt_key_head( p_key, p_inner->header.prefix_len );
+}
+
+static int bpt_insert( struct bpt_node_t* p_node, struct entry_t* p_key, struct data_t* p_value,
+                       struct bpt_node_t** pp_split_node, struct entry_t* p_split_key );
+
+/*
+ * Same as bpt_leaf_insert, for inner nodes: when the child splits, its separator and new sibling are added to the
+ * node, which splits in turn when it is full.
+ */
+static int bpt_inner_insert( struct bpt_inner_t* p_inner, struct entry_t* p_key, struct data_t* p_value,
+                             struct bpt_node_t** pp_split_node, struct entry_t* p_split_key )
+{
+    int i = bpt_child_index( p_inner, p_key );
+
+    // A full node must have its sibling ready before the child is changed.
+    struct bpt_inner_t* p_right = NULL;
+
+    if ( bpt_node_is_full( &p_inner->header ) && !(p_right = bpt_inner_create()) )
+        return -1;
+
+    struct bpt_node_t* p_child_split = NULL;
+    struct entry_t child_split_key;
+
+    int result = bpt_insert( p_inner->p_children[i], p_key, p_value, &p_child_split, &child_split_key );
+
+    if ( result == 1 )
+        p_inner->counts[i]++;
+
+    if ( !p_child_split )
+    {
+        free( p_right );
+        return result;
+    }
+
+    size_t split_count = bpt_node_size( p_child_split );
+    p_inner->counts[i] -= split_count;
+
+    int n = p_inner->header.n;
+
+    if ( !p_right )
+    {
+        bpt_inner_copy_keys( p_inner, i + 1, p_inner, i, n - i );
+        memmove( &p_inner->counts[i + 2], &p_inner->counts[i + 1], (n - i) * sizeof( size_t ) );
+        memmove( &p_inner->p_children[i + 2], &p_inner->p_children[i + 1], (n - i) * sizeof( struct bpt_node_t* ) );
+
+        p_inner->counts[i + 1] = split_count;
+        p_inner->p_children[i + 1] = p_child_split;
+        p_inner->header.n++;
+
+        bpt_inner_set_key( p_inner, i, &child_split_key );
+
+        return result;
+    }
+
+    // Split: lay out the BPT_INNER_SLOTS keys and BPT_INNER_SLOTS + 1 children in order, then the middle key goes up.
+    struct entry_t keys[BPT_INNER_SLOTS];
+    size_t counts[BPT_INNER_SLOTS + 1];
+    struct bpt_node_t* p_children[BPT_INNER_SLOTS + 1];
+
+    memcpy( keys, p_inner->keys, i * sizeof( struct entry_t ) );
+    keys[i] = child_split_key;
+    memcpy( &keys[i + 1], &p_inner->keys[i], (n - i) * sizeof( struct entry_t ) );
+
+    memcpy( counts, p_inner->counts, (i + 1) * sizeof( size_t ) );
+    counts[i + 1] = split_count;
+    memcpy( &counts[i + 2], &p_inner->counts[i + 1], (n - i) * sizeof( size_t ) );
+
+    memcpy( p_children, p_inner->p_children, (i + 1) * sizeof( struct bpt_node_t* ) );
+    p_children[i + 1] = p_child_split;
+    memcpy( &p_children[i + 2], &p_inner->p_children[i + 1], (n - i) * sizeof( struct bpt_node_t* ) );
+
+    int middle = BPT_INNER_SLOTS / 2;
+    int right_n = BPT_INNER_SLOTS - middle - 1;
+
+    memcpy( p_inner->keys, keys, middle * sizeof( struct entry_t ) );
+    memcpy( p_inner->counts, counts, (middle + 1) * sizeof( size_t ) );
+    memcpy( p_inner->p_children, p_children, (middle + 1) * sizeof( struct bpt_node_t* ) );
+    p_inner->header.n = middle;
+
+    memcpy( p_right->keys, &keys[middle + 1], right_n * sizeof( struct entry_t ) );
+    memcpy( p_right->counts, &counts[middle + 1], (right_n + 1) * sizeof( size_t ) );
+    memcpy( p_right->p_children, &p_children[middle + 1], (right_n + 1) * sizeof( struct bpt_node_t* ) );
+    p_right->header.n = right_n;
+
+    bpt_node_refresh( &p_inner->header, p_inner->keys, p_inner->heads, 1 );
+    bpt_node_refresh( &p_right->header, p_right->keys, p_right->heads, 1 );
+
+    *p_split_key = keys[middle];
+    *pp_split_node = &p_right->header;
+
+    return result;
+}
+
+static int bpt_insert( struct bpt_node_t* p_node, struct entry_t* p_key, struct data_t* p_value,
+                       struct bpt_node_t** pp_split_node, struct entry_t* p_split_key )
+{
+    if ( p_node->is_leaf )
+        return bpt_leaf_insert( (struct bpt_leaf_t*)p_node, p_key, p_value, pp_split_node, p_split_key );
+
+    return bpt_inner_insert( (struct bpt_inner_t*)p_node, p_key, p_value, pp_split_node, p_split_key );
+}
+
+int tree_bpt_put( struct tree_t* p_tree, struct entry_t* p_key, struct data_t* p_value )
+{
+    if ( !p_tree->p_bpt_root )
+    {
+        struct bpt_leaf_t* p_leaf = NULL;
+
+        if ( !(p_leaf = bpt_leaf_create()) )
+            return -1;
+
+        p_tree->p_bpt_root = &p_leaf->header;
+    }
+
+    struct bpt_node_t* p_root = p_tree->p_bpt_root;
+
+    // A full root may split: its new parent is created before anything changes.
+    struct bpt_inner_t* p_new_root = NULL;
+
+    if ( bpt_node_is_full( p_root ) && !(p_new_root = bpt_inner_create()) )
+        return -1;
+
+    struct bpt_node_t* p_split = NULL;
+    struct entry_t split_key;
+
+    int result = bpt_insert( p_root, p_key, p_value, &p_split, &split_key );
+
+    if ( p_split )
+    {
+        p_new_root->counts[0] = bpt_node_size( p_root );
+        p_new_root->counts[1] = bpt_node_size( p_split );
+        p_new_root->p_children[0] = p_root;
+        p_new_root->p_children[1] = p_split;
+        p_new_root->header.n = 1;
+        bpt_inner_set_key( p_new_root, 0, &split_key );
+
+        p_tree->p_bpt_root = &p_new_root->header;
+    }
+    else
+        free( p_new_root );
+
+    if ( result == 1 )
+        p_tree->size++;
+
+    // Don't keep an empty root leaf created for a failed put.
+    if ( p_tree->size == 0 )
+    {
+        tree_bpt_destroy( p_tree->p_bpt_root );
+        p_tree->p_bpt_root = NULL;
+    }
+
+    return result < 0 ? -1 : 0;
+}
+
+/*
+ * First key below a node.
+ */
+static struct entry_t* bpt_node_first_key( struct bpt_node_t* p_node )
+{
+    while ( !p_node->is_leaf )
+        p_node = ((struct bpt_inner_t*)p_node)->p_children[0];
+
+    return &((struct bpt_leaf_t*)p_node)->entries[0];
+}
+
+/*
+ * Number of nodes of slots entries each needed for count entries. Spreading the entries evenly over them keeps every
+ * node at least half full.
+ */
+static int bpt_nodes_needed( int count, int slots )
+{
+    return (count + slots - 1) / slots;
+}
+
+/*
+ * Creates a leaf with count entries, in order (see tree_bpt_bulk_load).
+ *
+ * Returns:
+ *      The leaf; NULL on error.
+ */
+static struct bpt_leaf_t* bpt_leaf_build( struct entry_t** pp_entries, int count )
+{
+    struct bpt_leaf_t* p_leaf = NULL;
+
+    if ( !(p_leaf = bpt_leaf_create()) )
+        return NULL;
+
+    for ( int i = 0; i < count; i++ )
+    {
+        struct entry_t* p_entry = &p_leaf->entries[i];
+
+        if ( bpt_key_copy( p_entry, pp_entries[i] ) < 0 )
+        {
+            tree_bpt_destroy( &p_leaf->header );
+            return NULL;
+        }
+
+        if ( !(p_entry->value = data_share( pp_entries[i]->value )) )
+        {
+            slab_free( p_entry->key );
+            tree_bpt_destroy( &p_leaf->header );
+            return NULL;
+        }
+
+        p_leaf->header.n++;
+    }
+
+    bpt_node_refresh( &p_leaf->header, p_leaf->entries, p_leaf->heads, 1 );
+
+    return p_leaf;
+}
+
+/*
+ * Creates an inner node over count nodes, in order. The separator of each child but the first is its first key.
+ *
+ * Returns:
+ *      The node, which owns the children; NULL on error (the children are left as they were).
+ */
+static struct bpt_inner_t* bpt_inner_build( struct bpt_node_t** pp_children, int count )
+{
+    struct bpt_inner_t* p_inner = NULL;
+
+    if ( !(p_inner = bpt_inner_create()) )
+        return NULL;
+
+    for ( int i = 1; i < count; i++ )
+    {
+        if ( bpt_key_copy( &p_inner->keys[i - 1], bpt_node_first_key( pp_children[i] ) ) < 0 )
+        {
+            while ( --i > 0 )
+                slab_free( p_inner->keys[i - 1].key );
+
+            free( p_inner );
+            return NULL;
+        }
+    }
+
+    for ( int i = 0; i < count; i++ )
+    {
+        p_inner->p_children[i] = pp_children[i];
+        p_inner->counts[i] = bpt_node_size( pp_children[i] );
+    }
+
+    p_inner->header.n = count - 1;
+    bpt_node_refresh( &p_inner->header, p_inner->keys, p_inner->heads, 1 );
+
+    return p_inner;
+}
+
+int tree_bpt_bulk_load( struct tree_t* p_tree, struct entry_t** pp_entries, int n )
+{
+    // Nodes of the current level, from the leaves up to the root.
+    int n_level = bpt_nodes_needed( n, BPT_LEAF_SLOTS );
+    struct bpt_node_t** pp_level = NULL;
+
+    if ( !(pp_level = (struct bpt_node_t**)malloc( sizeof( struct bpt_node_t* ) * n_level )) )
+        return -1;
+
+    int next_entry = 0;
+
+    for ( int i = 0; i < n_level; i++ )
+    {
+        struct bpt_leaf_t* p_leaf = NULL;
+        int count = (n - next_entry) / (n_level - i);
+
+        if ( !(p_leaf = bpt_leaf_build( &pp_entries[next_entry], count )) )
+        {
+            while ( i-- > 0 )
+                tree_bpt_destroy( pp_level[i] );
+
+            free( pp_level );
+            return -1;
+        }
+
+        if ( i > 0 )
+            ((struct bpt_leaf_t*)pp_level[i - 1])->p_next = p_leaf;
+
+        pp_level[i] = &p_leaf->header;
+        next_entry += count;
+    }
+
+    while ( n_level > 1 )
+    {
+        int n_parents = bpt_nodes_needed( n_level, BPT_INNER_SLOTS );
+        int next_child = 0;
+        struct bpt_node_t** pp_parents = NULL;
+
+        if ( !(pp_parents = (struct bpt_node_t**)malloc( sizeof( struct bpt_node_t* ) * n_parents )) )
+        {
+            for ( int i = 0; i < n_level; i++ )
+                tree_bpt_destroy( pp_level[i] );
+
+            free( pp_level );
+            return -1;
+        }
+
+        for ( int i = 0; i < n_parents; i++ )
+        {
+            struct bpt_inner_t* p_inner = NULL;
+            int count = (n_level - next_child) / (n_parents - i);
+
+            if ( !(p_inner = bpt_inner_build( &pp_level[next_child], count )) )
+            {
+                // The parents built so far own the children before next_child.
+                while ( i-- > 0 )
+                    tree_bpt_destroy( pp_parents[i] );
+
+                for ( int j = next_child; j < n_level; j++ )
+                    tree_bpt_destroy( pp_level[j] );
+
+                free( pp_parents );
+                free( pp_level );
+                return -1;
+            }
+
+            pp_parents[i] = &p_inner->header;
+            next_child += count;
+        }
+
+        free( pp_level );
+        pp_level = pp_parents;
+        n_level = n_parents;
+    }
+
+    p_tree->p_bpt_root = pp_level[0];
+    p_tree->size = n;
+    free( pp_level );
+
+    return 0;
+}
+
+struct entry_t* tree_bpt_find( struct tree_t* p_tree, struct entry_t* p_key )
+{
+    struct bpt_node_t* p_node = p_tree->p_bpt_root;
+
+    if ( !p_node )
+        return NULL;
+
+    while ( !p_node->is_leaf )
+    {
+        struct bpt_inner_t* p_inner = (struct bpt_inner_t*)p_node;
+        p_node = p_inner->p_children[bpt_child_index( p_inner, p_key )];
+    }
+
+    struct bpt_leaf_t* p_leaf = (struct bpt_leaf_t*)p_node;
+
+    int found;
+    int position = bpt_leaf_search( p_leaf, p_key, &found );
+
+    return found ? &p_leaf->entries[position] : NULL;
+}
+
+/*
+ * Removes keys[index] and p_children[index + 1] from an inner node, adding the count of the removed child to the
+ * child on its left. The key isn't freed.
+ */
+static void bpt_inner_remove( struct bpt_inner_t* p_inner, int index )
+{
+    int n = p_inner->header.n;
+
+    p_inner->counts[index] += p_inner->counts[index + 1];
+
+    bpt_inner_copy_keys( p_inner, index, p_inner, index + 1, n - index - 1 );
+    memmove( &p_inner->counts[index + 1], &p_inner->counts[index + 2], (n - index - 1) * sizeof( size_t ) );
+    memmove( &p_inner->p_children[index + 1], &p_inner->p_children[index + 2],
+             (n - index - 1) * sizeof( struct bpt_node_t* ) );
+
+    p_inner->header.n--;
+
+    bpt_node_refresh( &p_inner->header, p_inner->keys, p_inner->heads, 0 );
+}
+
+/*
+ * Fixes an underfull leaf by merging it with a sibling or moving entries from it.
+ *
+ * Parameters:
+ *      p_parent: Parent of both leaves.
+ *      left: Position of the left leaf on the parent; the right one is at left + 1.
+ */
+static void bpt_leaf_rebalance( struct bpt_inner_t* p_parent, int left )
+{
+    struct bpt_leaf_t* p_left = (struct bpt_leaf_t*)p_parent->p_children[left];
+    struct bpt_leaf_t* p_right = (struct bpt_leaf_t*)p_parent->p_children[left + 1];
+    int total = p_left->header.n + p_right->header.n;
+
+    if ( total <= BPT_LEAF_SLOTS )
+    {
+        bpt_leaf_move( p_left, p_right, 0, p_right->header.n );
+        p_left->p_next = p_right->p_next;
+        free( p_right );
+
+        slab_free( p_parent->keys[left].key );
+        bpt_inner_remove( p_parent, left );
+        return;
+    }
+
+    // Even out both leaves; the first key of the right one becomes the new separator.
+    int moved = total / 2 - p_left->header.n;
+    struct entry_t* p_first_right = moved > 0 ? &p_right->entries[moved] : &p_left->entries[p_left->header.n + moved];
+    struct entry_t separator;
+
+    if ( bpt_key_copy( &separator, p_first_right ) < 0 )
+        return;
+
+    if ( moved > 0 )
+        bpt_leaf_move( p_left, p_right, 0, moved );
+    else
+    {
+        // Move the last -moved entries of the left leaf to the front of the right one.
+        int count = -moved;
+
+        bpt_leaf_copy( p_right, count, p_right, 0, p_right->header.n );
+        bpt_leaf_copy( p_right, 0, p_left, p_left->header.n - count, count );
+        p_right->header.n += count;
+        p_left->header.n -= count;
+
+        bpt_node_refresh( &p_left->header, p_left->entries, p_left->heads, 1 );
+        bpt_node_refresh( &p_right->header, p_right->entries, p_right->heads, 1 );
+    }
+
+    p_parent->counts[left] += moved;
+    p_parent->counts[left + 1] -= moved;
+
+    slab_free( p_parent->keys[left].key );
+    bpt_inner_set_key( p_parent, left, &separator );
+}
+
+/*
+ * Same as bpt_leaf_rebalance, for inner nodes. Separators are rotated through the parent, so nothing is allocated.
+ */
+static void bpt_inner_rebalance( struct bpt_inner_t* p_parent, int left )
+{
+    struct bpt_inner_t* p_left = (struct bpt_inner_t*)p_parent->p_children[left];
+    struct bpt_inner_t* p_right = (struct bpt_inner_t*)p_parent->p_children[left + 1];
+    int left_n = p_left->header.n;
+    int right_n = p_right->header.n;
+
+    if ( left_n + right_n + 1 <= BPT_INNER_SLOTS - 1 )
+    {
+        // The separator comes down between the keys of both nodes.
+        p_left->keys[left_n] = p_parent->keys[left];
+        bpt_inner_copy_keys( p_left, left_n + 1, p_right, 0, right_n );
+        memcpy( &p_left->counts[left_n + 1], p_right->counts, (right_n + 1) * sizeof( size_t ) );
+        memcpy( &p_left->p_children[left_n + 1], p_right->p_children, (right_n + 1) * sizeof( struct bpt_node_t* ) );
+        p_left->header.n = left_n + right_n + 1;
+
+        bpt_node_refresh( &p_left->header, p_left->keys, p_left->heads, 1 );
+
+        free( p_right );
+        bpt_inner_remove( p_parent, left );
+        return;
+    }
+
+    struct entry_t separator;
+
+    if ( left_n < right_n )
+    {
+        // First child of the right node moves to the end of the left one.
+        size_t count = p_right->counts[0];
+
+        p_left->keys[left_n] = p_parent->keys[left];
+        p_left->counts[left_n + 1] = count;
+        p_left->p_children[left_n + 1] = p_right->p_children[0];
+        p_left->header.n++;
+
+        separator = p_right->keys[0];
+
+        bpt_inner_copy_keys( p_right, 0, p_right, 1, right_n - 1 );
+        memmove( p_right->counts, &p_right->counts[1], right_n * sizeof( size_t ) );
+        memmove( p_right->p_children, &p_right->p_children[1], right_n * sizeof( struct bpt_node_t* ) );
+        p_right->header.n--;
+
+        p_parent->counts[left] += count;
+        p_parent->counts[left + 1] -= count;
+    }
+    else
+    {
+        // Last child of the left node moves to the front of the right one.
+        size_t count = p_left->counts[left_n];
+
+        bpt_inner_copy_keys( p_right, 1, p_right, 0, right_n );
+        memmove( &p_right->counts[1], p_right->counts, (right_n + 1) * sizeof( size_t ) );
+        memmove( &p_right->p_children[1], p_right->p_children, (right_n + 1) * sizeof( struct bpt_node_t* ) );
+
+        p_right->keys[0] = p_parent->keys[left];
+        p_right->counts[0] = count;
+        p_right->p_children[0] = p_left->p_children[left_n];
+        p_right->header.n++;
+
+        separator = p_left->keys[left_n - 1];
+        p_left->header.n--;
+
+        p_parent->counts[left] -= count;
+        p_parent->counts[left + 1] += count;
+    }
+
+    bpt_node_refresh( &p_left->header, p_left->keys, p_left->heads, 1 );
+    bpt_node_refresh( &p_right->header, p_right->keys, p_right->heads, 1 );
+    bpt_inner_set_key( p_parent, left, &separator );
+}
+
+/*
+ * Removes a key below p_node. Children left underfull are rebalanced; p_node itself is left to its parent.
+ *
+ * Returns:
+ *      0 (ok) or -1 if the key isn't there.
+ */
+static int bpt_delete( struct bpt_node_t* p_node, struct entry_t* p_key )
+{
+    if ( p_node->is_leaf )
+    {
+        struct bpt_leaf_t* p_leaf = (struct bpt_leaf_t*)p_node;
+
+        int found;
+        int position = bpt_leaf_search( p_leaf, p_key, &found );
+
+        if ( !found )
+            return -1;
+
+        slab_free( p_leaf->entries[position].key );
+        data_destroy( p_leaf->entries[position].value );
+
+        bpt_leaf_copy( p_leaf, position, p_leaf, position + 1, p_node->n - position - 1 );
+        p_node->n--;
+
+        bpt_node_refresh( p_node, p_leaf->entries, p_leaf->heads, 0 );
+
+        return 0;
+    }
+
+    struct bpt_inner_t* p_inner = (struct bpt_inner_t*)p_node;
+    int i = bpt_child_index( p_inner, p_key );
+    struct bpt_node_t* p_child = p_inner->p_children[i];
+
+    if ( bpt_delete( p_child, p_key ) < 0 )
+        return -1;
+
+    p_inner->counts[i]--;
+
+    // Rebalance with the left sibling, or the right one for the first child.
+    int left = i > 0 ? i - 1 : 0;
+
+    if ( p_child->is_leaf && p_child->n < BPT_LEAF_MIN )
+        bpt_leaf_rebalance( p_inner, left );
+    else if ( !p_child->is_leaf && p_child->n < BPT_INNER_MIN_KEYS )
+        bpt_inner_rebalance( p_inner, left );
+
+    return 0;
+}
+
+int tree_bpt_del( struct tree_t* p_tree, struct entry_t* p_key )
+{
+    struct bpt_node_t* p_root = p_tree->p_bpt_root;
+
+    if ( !p_root || bpt_delete( p_root, p_key ) < 0 )
+        return -1;
+
+    p_tree->size--;
+
+    // The root shrinks when its last two children were merged, and goes away with the last key.
+    if ( !p_root->is_leaf && p_root->n == 0 )
+    {
+        p_tree->p_bpt_root = ((struct bpt_inner_t*)p_root)->p_children[0];
+        free( p_root );
+    }
+    else if ( p_root->is_leaf && p_root->n == 0 )
+    {
+        free( p_root );
+        p_tree->p_bpt_root = NULL;
+    }
+
+    return 0;
+}
+
+int tree_bpt_height( struct tree_t* p_tree )
+{
+    int height = 0;
+
+    for ( struct bpt_node_t* p_node = p_tree->p_bpt_root; p_node;
+          p_node = p_node->is_leaf ? NULL : ((struct bpt_inner_t*)p_node)->p_children[0] )
+        height++;
+
+    return height;
+}
+
+/*
+ * Finds the leaf holding the entry at a position of the key order.
+ *
+ * Parameters:
+ *      p_tree: Tree.
+ *      index: Position; must be < the tree size.
+ *      p_position: Set to the position of the entry on the leaf.
+ */
+static struct bpt_leaf_t* bpt_leaf_at( struct tree_t* p_tree, size_t index, int* p_position )
+{
+    struct bpt_node_t* p_node = p_tree->p_bpt_root;
+
+    while ( !p_node->is_leaf )
+    {
+        struct bpt_inner_t* p_inner = (struct bpt_inner_t*)p_node;
+        int i = 0;
+
+        while ( i < p_node->n && index >= p_inner->counts[i] )
+            index -= p_inner->counts[i++];
+
+        p_node = p_inner->p_children[i];
+    }
+
+    *p_position = (int)index;
+
+    return (struct bpt_leaf_t*)p_node;
+}
+
+struct entry_t* tree_bpt_entry_at( struct tree_t* p_tree, size_t index )
+{
+    if ( index >= p_tree->size )
+        return NULL;
+
+    int position;
+    struct bpt_leaf_t* p_leaf = bpt_leaf_at( p_tree, index, &position );
+
+    return &p_leaf->entries[position];
+}
+
+size_t tree_bpt_rank( struct tree_t* p_tree, struct entry_t* p_key )
+{
+    struct bpt_node_t* p_node = p_tree->p_bpt_root;
+    size_t rank = 0;
+
+    if ( !p_node )
+        return 0;
+
+    while ( !p_node->is_leaf )
+    {
+        struct bpt_inner_t* p_inner = (struct bpt_inner_t*)p_node;
+        int i = bpt_child_index( p_inner, p_key );
+
+        for ( int j = 0; j < i; j++ )
+            rank += p_inner->counts[j];
+
+        p_node = p_inner->p_children[i];
+    }
+
+    int found;
+    rank += bpt_leaf_search( (struct bpt_leaf_t*)p_node, p_key, &found );
+
+    return rank;
+}
+
+int tree_bpt_walk( struct tree_t* p_tree, struct entry_t* p_start_key, size_t skip,
+                   int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    struct bpt_node_t* p_node = p_tree->p_bpt_root;
+    struct bpt_leaf_t* p_leaf = NULL;
+    int position;
+
+    if ( !p_node )
+        return 0;
+
+    if ( p_start_key )
+    {
+        while ( !p_node->is_leaf )
+        {
+            struct bpt_inner_t* p_inner = (struct bpt_inner_t*)p_node;
+            p_node = p_inner->p_children[bpt_child_index( p_inner, p_start_key )];
+        }
+
+        int found;
+        p_leaf = (struct bpt_leaf_t*)p_node;
+        position = bpt_leaf_search( p_leaf, p_start_key, &found );
+    }
+    else
+    {
+        if ( skip >= p_tree->size )
+            return 0;
+
+        p_leaf = bpt_leaf_at( p_tree, skip, &position );
+        skip = 0;
+    }
+
+    // Sequential sweep over the linked leaves.
+    for ( ; p_leaf; p_leaf = p_leaf->p_next, position = 0 )
+    {
+        for ( ; position < p_leaf->header.n; position++ )
+        {
+            if ( skip > 0 )
+            {
+                skip--;
+                continue;
+            }
+
+            if ( callback( &p_leaf->entries[position], p_context ) )
+                return 1;
+        }
+    }
+
+    return 0;
+}
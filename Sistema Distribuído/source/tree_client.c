@@ -22,6 +22,11 @@ void print_commands(){
     printf("getkeys            || returns all the keys from the tree\n");
     printf("getvalues          || returns all the values from the tree\n");
     printf("verify <op_n>      || verifies if operation was finished\n");
+    printf("keyat <index>      || returns the key at the given position (sorted)\n");
+    printf("rank <key>         || returns how many keys are smaller than key\n");
+    printf("getkeyspage <offset> <limit> || returns limit keys starting at offset\n");
+    printf("scan <start> <end> || returns the entries with start <= key < end\n");
+    printf("scanprefix <prefix> || returns the entries whose key starts with prefix\n");
     printf("quit               || exits the program\n");
 }
 
@@ -298,11 +303,155 @@ int main( int argc, char **argv )
 
             if ( errno == EBADMSG )
                 printf( "\nInvalid operation number. No operation with specified number was assigned.\n" );
+            else if ( result == -2 )
+                printf( "\nOperation did finish, but the server rejected it.\n" );
             else if ( result < 0 )
                 printf( "\nOperation did not finish yet.\n" );
             else
                 printf( "\nOperation did finish.\n" );
         }
+        else if ( strcmp( p_first_arg, "keyat" ) == 0 )
+        {
+            if ( n_args != 1 )
+            {
+                printf( "Keyat command only has one argument (e.g. keyat <index> ).\n" );
+                continue;
+            }
+
+            char *p_additional_chars = NULL;
+            long index = strtol( p_second_arg, &p_additional_chars, 10 );
+
+            if ( *p_additional_chars != 0 || index < 0 )
+            {
+                printf( "Error: Keyat's argument must be a non negative number.\n" );
+                continue;
+            }
+
+            char *p_key;
+            if ( (p_key = rtree_get_key_at( p_rtree, (int)index )) == NULL )
+            {
+                printf( "There is no key at position %ld.\n", index );
+            }
+            else
+            {
+                printf( "Key at position %ld: %s\n", index, p_key );
+                free( p_key );
+            }
+        }
+        else if ( strcmp( p_first_arg, "rank" ) == 0 )
+        {
+            if ( n_args != 1 )
+            {
+                printf( "Rank command only has one argument (e.g. rank <key> ).\n" );
+                continue;
+            }
+
+            int rank = rtree_get_rank( p_rtree, p_second_arg );
+
+            if ( rank < 0 )
+                printf( "Error obtaining the rank of the key.\n" );
+            else
+                printf( "Keys smaller than %s: %d\n", p_second_arg, rank );
+        }
+        else if ( strcmp( p_first_arg, "getkeyspage" ) == 0 )
+        {
+            if ( n_args != 2 )
+            {
+                printf( "Getkeyspage command has two arguments (e.g. getkeyspage <offset> <limit> ).\n" );
+                continue;
+            }
+
+            char *p_additional_chars = NULL;
+            long offset = strtol( p_second_arg, &p_additional_chars, 10 );
+            char *p_additional_chars_limit = NULL;
+            long limit = strtol( p_third_arg, &p_additional_chars_limit, 10 );
+
+            if ( *p_additional_chars != 0 || *p_additional_chars_limit != 0 || offset < 0 || limit < 0 )
+            {
+                printf( "Error: Getkeyspage's arguments must be non negative numbers.\n" );
+                continue;
+            }
+
+            char **pp_keys = rtree_get_keys_page( p_rtree, (int)offset, (int)limit );
+
+            if ( !pp_keys || !pp_keys[0] )
+            {
+                printf( "No key found on that page.\n" );
+            }
+            else
+            {
+                printf( "Keys found:\n" );
+                for ( int i = 0; pp_keys[i]; i++ )
+                {
+                    printf( "%s\n", pp_keys[i] );
+                    free( pp_keys[i] );
+                }
+            }
+
+            if ( pp_keys ) free( pp_keys );
+        }
+        else if ( strcmp( p_first_arg, "scan" ) == 0 )
+        {
+            if ( n_args != 2 )
+            {
+                printf( "Scan command has two arguments (e.g. scan <start_key> <end_key> ).\n" );
+                continue;
+            }
+
+            struct entry_t **pp_entries = rtree_scan( p_rtree, p_second_arg, p_third_arg, 0 );
+
+            if ( !pp_entries || !pp_entries[0] )
+            {
+                printf( "No entry found on that range.\n" );
+            }
+            else
+            {
+                printf( "Entries found:\n" );
+                for ( int i = 0; pp_entries[i]; i++ )
+                {
+                    struct data_t* p_data = pp_entries[i]->value;
+                    char *p_str = malloc( sizeof( char ) * (p_data->datasize + 1 ) );
+                    p_str[p_data->datasize] = '\0';
+                    memcpy(p_str, p_data->data, p_data->datasize);
+                    printf("%s {datasize: %d; data: %s}\n", pp_entries[i]->key, p_data->datasize, p_str );
+                    free(p_str);
+                    entry_destroy( pp_entries[i] );
+                }
+            }
+
+            if ( pp_entries ) free( pp_entries );
+        }
+        else if ( strcmp( p_first_arg, "scanprefix" ) == 0 )
+        {
+            if ( n_args != 1 )
+            {
+                printf( "Scanprefix command only has one argument (e.g. scanprefix <prefix> ).\n" );
+                continue;
+            }
+
+            struct entry_t **pp_entries = rtree_scan_prefix( p_rtree, p_second_arg, 0 );
+
+            if ( !pp_entries || !pp_entries[0] )
+            {
+                printf( "No entry found with that prefix.\n" );
+            }
+            else
+            {
+                printf( "Entries found:\n" );
+                for ( int i = 0; pp_entries[i]; i++ )
+                {
+                    struct data_t* p_data = pp_entries[i]->value;
+                    char *p_str = malloc( sizeof( char ) * (p_data->datasize + 1 ) );
+                    p_str[p_data->datasize] = '\0';
+                    memcpy(p_str, p_data->data, p_data->datasize);
+                    printf("%s {datasize: %d; data: %s}\n", pp_entries[i]->key, p_data->datasize, p_str );
+                    free(p_str);
+                    entry_destroy( pp_entries[i] );
+                }
+            }
+
+            if ( pp_entries ) free( pp_entries );
+        }
 	// Quit command.
         else if ( strcmp( p_first_arg, "quit" ) == 0 )
         {
@@ -0,0 +1,774 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree-private.h"
+#include "tree_cow-private.h"
+#include "entry-private.h"
+#include "slab.h"
+
+/*
+ * One write in progress. The nodes it creates carry its version and may be changed in place until it publishes;
+ * older nodes are copied (cow_own) and retired.
+ *
+ * Members:
+ *      p_cow: The tree.
+ *      version: Version of the write.
+ *      failed: Set when there was no memory: the write is discarded.
+ *      pp_created: Nodes created, freed if the write is discarded.
+ *      pp_retired: Nodes and leaves replaced, retired when the write is published.
+ */
+struct cow_write_t
+{
+    struct tree_cow_t* p_cow;
+    unsigned long version;
+    int failed;
+    size_t n_created;
+    struct cow_node_t* pp_created[TREE_COW_MAX_WRITE_NODES];
+    size_t n_retired;
+    void* pp_retired[TREE_COW_MAX_WRITE_NODES + 2];
+};
+
+static inline size_t cow_size( struct cow_node_t* p_node )
+{
+    return p_node ? p_node->size : 0;
+}
+
+static inline int cow_height( struct cow_node_t* p_node )
+{
+    return p_node ? p_node->height : 0;
+}
+
+static inline void cow_update( struct cow_node_t* p_node )
+{
+    int left_height = cow_height( p_node->p_left );
+    int right_height = cow_height( p_node->p_right );
+
+    p_node->size = cow_size( p_node->p_left ) + cow_size( p_node->p_right ) + 1;
+    p_node->height = (left_height > right_height ? left_height : right_height) + 1;
+}
+
+static inline struct cow_node_t* cow_root( struct tree_cow_t* p_cow )
+{
+    return __atomic_load_n( &p_cow->p_root, __ATOMIC_ACQUIRE );
+}
+
+static struct cow_leaf_t* cow_leaf_create( struct entry_t* p_key, struct data_t* p_value )
+{
+    if ( !p_value || p_value->datasize <= 0 || !p_value->data )
+        return NULL;
+
+    struct cow_leaf_t* p_leaf = NULL;
+
+    if ( !(p_leaf = (struct cow_leaf_t*)slab_alloc( sizeof( struct cow_leaf_t ) + p_key->keysize + 1 )) )
+        return NULL;
+
+    memcpy( p_leaf->key, p_key->key, p_key->keysize );
+    p_leaf->key[p_key->keysize] = '\0';
+    entry_key_set( &p_leaf->entry, p_leaf->key, p_key->keysize );
+
+    if ( !(p_leaf->entry.value = data_share( p_value )) )
+    {
+        slab_free( p_leaf );
+        return NULL;
+    }
+
+    return p_leaf;
+}
+
+static void cow_leaf_destroy( struct cow_leaf_t* p_leaf )
+{
+    data_destroy( p_leaf->entry.value );
+    slab_free( p_leaf );
+}
+
+/*
+ * Frees the nodes and the leaves of a subtree that no reader can reach.
+ */
+static void cow_destroy_subtree( struct cow_node_t* p_node )
+{
+    // AVL trees are at most TREE_COW_MAX_HEIGHT deep: the recursion is bounded.
+    if ( !p_node )
+        return;
+
+    cow_destroy_subtree( p_node->p_left );
+    cow_destroy_subtree( p_node->p_right );
+    cow_leaf_destroy( p_node->p_leaf );
+    slab_free( p_node );
+}
+
+static void cow_garbage_free( struct cow_garbage_t* p_garbage )
+{
+    for ( size_t i = 0; i < p_garbage->n_items; i++ )
+    {
+        if ( COW_IS_LEAF( p_garbage->pp_items[i] ) )
+            cow_leaf_destroy( COW_LEAF( p_garbage->pp_items[i] ) );
+        else
+            slab_free( p_garbage->pp_items[i] );
+    }
+
+    p_garbage->n_items = 0;
+}
+
+struct tree_cow_t* tree_cow_create()
+{
+    struct tree_cow_t* p_cow = NULL;
+
+    if ( !(p_cow = (struct tree_cow_t*)calloc( 1, sizeof( struct tree_cow_t ) )) )
+        return NULL;
+
+    return p_cow;
+}
+
+void tree_cow_destroy( struct tree_cow_t* p_cow )
+{
+    if ( !p_cow )
+        return;
+
+    cow_destroy_subtree( p_cow->p_root );
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        cow_garbage_free( &p_cow->garbage[i] );
+        free( p_cow->garbage[i].pp_items );
+    }
+
+    free( p_cow );
+}
+
+unsigned long tree_cow_enter( struct tree_cow_t* p_cow )
+{
+    for ( ;; )
+    {
+        unsigned long epoch = __atomic_load_n( &p_cow->epoch, __ATOMIC_SEQ_CST );
+
+        __atomic_fetch_add( &p_cow->readers[epoch & 1], 1, __ATOMIC_SEQ_CST );
+
+        // The epoch moved before the reader was counted: the writer may not have seen it. Count it on the new one.
+        if ( __atomic_load_n( &p_cow->epoch, __ATOMIC_SEQ_CST ) == epoch )
+            return epoch;
+
+        __atomic_fetch_sub( &p_cow->readers[epoch & 1], 1, __ATOMIC_SEQ_CST );
+    }
+}
+
+void tree_cow_exit( struct tree_cow_t* p_cow, unsigned long epoch )
+{
+    __atomic_fetch_sub( &p_cow->readers[epoch & 1], 1, __ATOMIC_RELEASE );
+}
+
+/*
+ * Frees what was retired on the previous epoch and moves to the next one, if no reader of the previous epoch is
+ * left. Readers of the current epoch entered after everything retired on the previous one was unlinked; the ones that
+ * may still see what is retired now keep the epoch from moving twice.
+ */
+static void cow_advance( struct tree_cow_t* p_cow )
+{
+    unsigned long epoch = p_cow->epoch;
+
+    if ( __atomic_load_n( &p_cow->readers[(epoch + 1) & 1], __ATOMIC_SEQ_CST ) != 0 )
+        return;
+
+    cow_garbage_free( &p_cow->garbage[(epoch + 1) & 1] );
+
+    __atomic_store_n( &p_cow->epoch, epoch + 1, __ATOMIC_SEQ_CST );
+}
+
+static void cow_write_init( struct cow_write_t* p_write, struct tree_cow_t* p_cow )
+{
+    p_write->p_cow = p_cow;
+    p_write->version = ++p_cow->version;
+    p_write->failed = 0;
+    p_write->n_created = 0;
+    p_write->n_retired = 0;
+}
+
+static void cow_retire( struct cow_write_t* p_write, void* p_item )
+{
+    if ( p_write->n_retired == sizeof( p_write->pp_retired ) / sizeof( void* ) )
+    {
+        p_write->failed = 1;
+        return;
+    }
+
+    p_write->pp_retired[p_write->n_retired++] = p_item;
+}
+
+static struct cow_node_t* cow_node_create( struct cow_write_t* p_write, struct cow_node_t* p_left,
+                                           struct cow_leaf_t* p_leaf, struct cow_node_t* p_right )
+{
+    struct cow_node_t* p_node = NULL;
+
+    if ( p_write->failed || p_write->n_created == TREE_COW_MAX_WRITE_NODES ||
+         !(p_node = (struct cow_node_t*)slab_alloc( sizeof( struct cow_node_t ) )) )
+    {
+        p_write->failed = 1;
+        return NULL;
+    }
+
+    p_node->p_left = p_left;
+    p_node->p_right = p_right;
+    p_node->p_leaf = p_leaf;
+    p_node->version = p_write->version;
+    cow_update( p_node );
+
+    p_write->pp_created[p_write->n_created++] = p_node;
+
+    return p_node;
+}
+
+/*
+ * Returns a node the write may change: the node itself if the write created it, otherwise a copy (the original is
+ * retired). NULL if there was no memory.
+ */
+static struct cow_node_t* cow_own( struct cow_write_t* p_write, struct cow_node_t* p_node )
+{
+    if ( p_node->version == p_write->version )
+        return p_node;
+
+    struct cow_node_t* p_copy = cow_node_create( p_write, p_node->p_left, p_node->p_leaf, p_node->p_right );
+
+    if ( p_copy )
+        cow_retire( p_write, p_node );
+
+    return p_copy;
+}
+
+/*
+ * Rotations of a node owned by the write. The child that moves up is owned (copied) first.
+ */
+static struct cow_node_t* cow_rotate_right( struct cow_write_t* p_write, struct cow_node_t* p_node )
+{
+    struct cow_node_t* p_left = cow_own( p_write, p_node->p_left );
+
+    if ( !p_left )
+        return NULL;
+
+    p_node->p_left = p_left->p_right;
+    cow_update( p_node );
+
+    p_left->p_right = p_node;
+    cow_update( p_left );
+
+    return p_left;
+}
+
+static struct cow_node_t* cow_rotate_left( struct cow_write_t* p_write, struct cow_node_t* p_node )
+{
+    struct cow_node_t* p_right = cow_own( p_write, p_node->p_right );
+
+    if ( !p_right )
+        return NULL;
+
+    p_node->p_right = p_right->p_left;
+    cow_update( p_node );
+
+    p_right->p_left = p_node;
+    cow_update( p_right );
+
+    return p_right;
+}
+
+/*
+ * Restores the AVL balance of a node owned by the write whose children changed.
+ *
+ * Returns:
+ *      The root of the subtree; NULL if there was no memory.
+ */
+static struct cow_node_t* cow_rebalance( struct cow_write_t* p_write, struct cow_node_t* p_node )
+{
+    cow_update( p_node );
+
+    int balance = cow_height( p_node->p_left ) - cow_height( p_node->p_right );
+
+    if ( balance > 1 )
+    {
+        struct cow_node_t* p_left = p_node->p_left;
+
+        // Left-right case.
+        if ( cow_height( p_left->p_left ) < cow_height( p_left->p_right ) )
+        {
+            if ( !(p_left = cow_own( p_write, p_left )) || !(p_node->p_left = cow_rotate_left( p_write, p_left )) )
+                return NULL;
+        }
+
+        return cow_rotate_right( p_write, p_node );
+    }
+
+    if ( balance < -1 )
+    {
+        struct cow_node_t* p_right = p_node->p_right;
+
+        // Right-left case.
+        if ( cow_height( p_right->p_right ) < cow_height( p_right->p_left ) )
+        {
+            if ( !(p_right = cow_own( p_write, p_right )) ||
+                 !(p_node->p_right = cow_rotate_right( p_write, p_right )) )
+                return NULL;
+        }
+
+        return cow_rotate_left( p_write, p_node );
+    }
+
+    return p_node;
+}
+
+static struct cow_node_t* cow_insert( struct cow_write_t* p_write, struct cow_node_t* p_node,
+                                      struct cow_leaf_t* p_leaf, int* p_added )
+{
+    if ( !p_node )
+    {
+        *p_added = 1;
+        return cow_node_create( p_write, NULL, p_leaf, NULL );
+    }
+
+    int compare_value = entry_key_compare( &p_leaf->entry, &p_node->p_leaf->entry );
+    struct cow_node_t* p_owned = NULL;
+
+    if ( !(p_owned = cow_own( p_write, p_node )) )
+        return NULL;
+
+    // Existing key: only the leaf changes.
+    if ( compare_value == 0 )
+    {
+        cow_retire( p_write, COW_TAG_LEAF( p_owned->p_leaf ) );
+        p_owned->p_leaf = p_leaf;
+        return p_owned;
+    }
+
+    if ( compare_value < 0 )
+        p_owned->p_left = cow_insert( p_write, p_owned->p_left, p_leaf, p_added );
+    else
+        p_owned->p_right = cow_insert( p_write, p_owned->p_right, p_leaf, p_added );
+
+    if ( p_write->failed )
+        return NULL;
+
+    return cow_rebalance( p_write, p_owned );
+}
+
+/*
+ * Removes the smallest node of a subtree, giving back its leaf.
+ */
+static struct cow_node_t* cow_remove_min( struct cow_write_t* p_write, struct cow_node_t* p_node,
+                                          struct cow_leaf_t** pp_leaf )
+{
+    if ( !p_node->p_left )
+    {
+        *pp_leaf = p_node->p_leaf;
+        cow_retire( p_write, p_node );
+        return p_node->p_right;
+    }
+
+    struct cow_node_t* p_owned = NULL;
+
+    if ( !(p_owned = cow_own( p_write, p_node )) )
+        return NULL;
+
+    p_owned->p_left = cow_remove_min( p_write, p_owned->p_left, pp_leaf );
+
+    if ( p_write->failed )
+        return NULL;
+
+    return cow_rebalance( p_write, p_owned );
+}
+
+/*
+ * Removes a key, which must be on the subtree. The nodes reached going down are the published ones (the copies are
+ * only made on the way), so the removed node is always retired, never freed.
+ */
+static struct cow_node_t* cow_remove( struct cow_write_t* p_write, struct cow_node_t* p_node, struct entry_t* p_key )
+{
+    int compare_value = entry_key_compare( p_key, &p_node->p_leaf->entry );
+    struct cow_node_t* p_owned = NULL;
+
+    if ( compare_value == 0 )
+    {
+        cow_retire( p_write, COW_TAG_LEAF( p_node->p_leaf ) );
+
+        if ( !p_node->p_left || !p_node->p_right )
+        {
+            cow_retire( p_write, p_node );
+            return p_node->p_left ? p_node->p_left : p_node->p_right;
+        }
+
+        // Two children: the successor's leaf takes the place of the removed one.
+        if ( !(p_owned = cow_own( p_write, p_node )) )
+            return NULL;
+
+        p_owned->p_right = cow_remove_min( p_write, p_owned->p_right, &p_owned->p_leaf );
+    }
+    else
+    {
+        if ( !(p_owned = cow_own( p_write, p_node )) )
+            return NULL;
+
+        if ( compare_value < 0 )
+            p_owned->p_left = cow_remove( p_write, p_owned->p_left, p_key );
+        else
+            p_owned->p_right = cow_remove( p_write, p_owned->p_right, p_key );
+    }
+
+    if ( p_write->failed )
+        return NULL;
+
+    return cow_rebalance( p_write, p_owned );
+}
+
+/*
+ * Publishes the new root of a write and retires what it replaced.
+ *
+ * Returns:
+ *      0 (ok) or -1 if there was no memory to retire (nothing was published).
+ */
+static int cow_commit( struct cow_write_t* p_write, struct cow_node_t* p_root )
+{
+    struct tree_cow_t* p_cow = p_write->p_cow;
+    struct cow_garbage_t* p_garbage = &p_cow->garbage[p_cow->epoch & 1];
+
+    // Room for everything retired, before publishing: after that the write can't fail.
+    if ( p_garbage->n_items + p_write->n_retired > p_garbage->capacity )
+    {
+        size_t new_capacity = p_garbage->capacity ? p_garbage->capacity : 256;
+        void** pp_items = NULL;
+
+        while ( new_capacity < p_garbage->n_items + p_write->n_retired )
+            new_capacity *= 2;
+
+        if ( !(pp_items = (void**)realloc( p_garbage->pp_items, sizeof( void* ) * new_capacity )) )
+            return -1;
+
+        p_garbage->pp_items = pp_items;
+        p_garbage->capacity = new_capacity;
+    }
+
+    __atomic_store_n( &p_cow->p_root, p_root, __ATOMIC_SEQ_CST );
+
+    for ( size_t i = 0; i < p_write->n_retired; i++ )
+        p_garbage->pp_items[p_garbage->n_items++] = p_write->pp_retired[i];
+
+    cow_advance( p_cow );
+
+    return 0;
+}
+
+/*
+ * Discards a write that wasn't published: the published tree was never changed.
+ */
+static void cow_abort( struct cow_write_t* p_write )
+{
+    for ( size_t i = 0; i < p_write->n_created; i++ )
+        slab_free( p_write->pp_created[i] );
+}
+
+static struct cow_leaf_t* cow_find( struct cow_node_t* p_node, struct entry_t* p_key )
+{
+    while ( p_node )
+    {
+        int compare_value = entry_key_compare( p_key, &p_node->p_leaf->entry );
+
+        if ( compare_value == 0 )
+            return p_node->p_leaf;
+
+        p_node = compare_value < 0 ? p_node->p_left : p_node->p_right;
+    }
+
+    return NULL;
+}
+
+int tree_cow_put( struct tree_t* p_tree, struct entry_t* p_key, struct data_t* p_value )
+{
+    struct tree_cow_t* p_cow = p_tree->p_cow;
+    struct cow_leaf_t* p_leaf = NULL;
+
+    if ( !(p_leaf = cow_leaf_create( p_key, p_value )) )
+        return -1;
+
+    struct cow_write_t write;
+    cow_write_init( &write, p_cow );
+
+    int added = 0;
+    struct cow_node_t* p_root = cow_insert( &write, p_cow->p_root, p_leaf, &added );
+
+    if ( write.failed || cow_commit( &write, p_root ) < 0 )
+    {
+        cow_abort( &write );
+        cow_leaf_destroy( p_leaf );
+        return -1;
+    }
+
+    p_tree->size += added;
+
+    return 0;
+}
+
+int tree_cow_del( struct tree_t* p_tree, struct entry_t* p_key )
+{
+    struct tree_cow_t* p_cow = p_tree->p_cow;
+
+    // Nothing is copied for a missing key.
+    if ( !cow_find( p_cow->p_root, p_key ) )
+        return -1;
+
+    struct cow_write_t write;
+    cow_write_init( &write, p_cow );
+
+    struct cow_node_t* p_root = cow_remove( &write, p_cow->p_root, p_key );
+
+    if ( write.failed || cow_commit( &write, p_root ) < 0 )
+    {
+        cow_abort( &write );
+        return -1;
+    }
+
+    p_tree->size--;
+
+    return 0;
+}
+
+/*
+ * Builds a balanced subtree from n sorted entries. On error *p_failed is set and nothing is left allocated.
+ */
+static struct cow_node_t* cow_build( struct entry_t** pp_entries, int n, int* p_failed )
+{
+    if ( n == 0 )
+        return NULL;
+
+    int middle = n / 2;
+    struct cow_node_t* p_left = cow_build( pp_entries, middle, p_failed );
+    struct cow_node_t* p_right = *p_failed ? NULL : cow_build( pp_entries + middle + 1, n - middle - 1, p_failed );
+    struct cow_leaf_t* p_leaf = NULL;
+    struct cow_node_t* p_node = NULL;
+
+    if ( *p_failed || !(p_leaf = cow_leaf_create( pp_entries[middle], pp_entries[middle]->value )) ||
+         !(p_node = (struct cow_node_t*)slab_alloc( sizeof( struct cow_node_t ) )) )
+    {
+        *p_failed = 1;
+
+        if ( p_leaf )
+            cow_leaf_destroy( p_leaf );
+
+        cow_destroy_subtree( p_left );
+        cow_destroy_subtree( p_right );
+        return NULL;
+    }
+
+    p_node->p_left = p_left;
+    p_node->p_right = p_right;
+    p_node->p_leaf = p_leaf;
+    p_node->version = 0;
+    cow_update( p_node );
+
+    return p_node;
+}
+
+int tree_cow_bulk_load( struct tree_t* p_tree, struct entry_t** pp_entries, int n )
+{
+    struct tree_cow_t* p_cow = p_tree->p_cow;
+    int failed = 0;
+
+    struct cow_node_t* p_root = cow_build( pp_entries, n, &failed );
+
+    if ( failed )
+        return -1;
+
+    // The tree was empty: nothing to retire.
+    __atomic_store_n( &p_cow->p_root, p_root, __ATOMIC_SEQ_CST );
+    p_tree->size = n;
+
+    return 0;
+}
+
+/*
+ * Number of keys smaller than p_key on a subtree.
+ */
+static size_t cow_rank( struct cow_node_t* p_node, struct entry_t* p_key )
+{
+    size_t rank = 0;
+
+    while ( p_node )
+    {
+        int compare_value = entry_key_compare( p_key, &p_node->p_leaf->entry );
+
+        if ( compare_value <= 0 )
+        {
+            if ( compare_value == 0 )
+                return rank + cow_size( p_node->p_left );
+
+            p_node = p_node->p_left;
+        }
+        else
+        {
+            rank += cow_size( p_node->p_left ) + 1;
+            p_node = p_node->p_right;
+        }
+    }
+
+    return rank;
+}
+
+/*
+ * Visits the entries of a subtree in key order from position index on, until the callback returns non zero.
+ *
+ * Returns:
+ *      Non zero if the callback stopped the walk; 0 otherwise.
+ */
+static int cow_walk_from( struct cow_node_t* p_root, size_t index,
+                          int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    // Nodes still to visit (the ones where the descent went left), the next one on top.
+    struct cow_node_t* pp_stack[TREE_COW_MAX_HEIGHT];
+    int top = 0;
+    struct cow_node_t* p_node = p_root;
+
+    while ( p_node )
+    {
+        size_t left_size = cow_size( p_node->p_left );
+
+        if ( index <= left_size )
+        {
+            pp_stack[top++] = p_node;
+
+            if ( index == left_size )
+                break;
+
+            p_node = p_node->p_left;
+        }
+        else
+        {
+            index -= left_size + 1;
+            p_node = p_node->p_right;
+        }
+    }
+
+    while ( top > 0 )
+    {
+        p_node = pp_stack[--top];
+
+        if ( callback( &p_node->p_leaf->entry, p_context ) )
+            return 1;
+
+        for ( struct cow_node_t* p_child = p_node->p_right; p_child; p_child = p_child->p_left )
+            pp_stack[top++] = p_child;
+    }
+
+    return 0;
+}
+
+struct data_t* tree_cow_get( struct tree_t* p_tree, struct entry_t* p_key )
+{
+    unsigned long epoch = tree_cow_enter( p_tree->p_cow );
+
+    struct cow_leaf_t* p_leaf = cow_find( cow_root( p_tree->p_cow ), p_key );
+    struct data_t* p_value = p_leaf ? data_share( p_leaf->entry.value ) : data_create2( 0, NULL );
+
+    tree_cow_exit( p_tree->p_cow, epoch );
+
+    return p_value;
+}
+
+size_t tree_cow_size( struct tree_t* p_tree )
+{
+    unsigned long epoch = tree_cow_enter( p_tree->p_cow );
+    size_t size = cow_size( cow_root( p_tree->p_cow ) );
+    tree_cow_exit( p_tree->p_cow, epoch );
+
+    return size;
+}
+
+int tree_cow_height( struct tree_t* p_tree )
+{
+    unsigned long epoch = tree_cow_enter( p_tree->p_cow );
+    int height = cow_height( cow_root( p_tree->p_cow ) );
+    tree_cow_exit( p_tree->p_cow, epoch );
+
+    return height;
+}
+
+char* tree_cow_key_at( struct tree_t* p_tree, size_t index, size_t* p_keysize )
+{
+    unsigned long epoch = tree_cow_enter( p_tree->p_cow );
+
+    struct cow_node_t* p_node = cow_root( p_tree->p_cow );
+    char* p_key = NULL;
+
+    while ( p_node )
+    {
+        size_t left_size = cow_size( p_node->p_left );
+
+        if ( index < left_size )
+            p_node = p_node->p_left;
+        else if ( index > left_size )
+        {
+            index -= left_size + 1;
+            p_node = p_node->p_right;
+        }
+        else
+        {
+            struct entry_t* p_entry = &p_node->p_leaf->entry;
+
+            // Binary keys can hold '\0': copy keysize bytes and terminate the copy.
+            if ( (p_key = (char*)malloc( p_entry->keysize + 1 )) )
+            {
+                memcpy( p_key, p_entry->key, p_entry->keysize );
+                p_key[p_entry->keysize] = '\0';
+
+                if ( p_keysize )
+                    *p_keysize = p_entry->keysize;
+            }
+
+            break;
+        }
+    }
+
+    tree_cow_exit( p_tree->p_cow, epoch );
+
+    return p_key;
+}
+
+size_t tree_cow_rank( struct tree_t* p_tree, struct entry_t* p_key )
+{
+    unsigned long epoch = tree_cow_enter( p_tree->p_cow );
+    size_t rank = cow_rank( cow_root( p_tree->p_cow ), p_key );
+    tree_cow_exit( p_tree->p_cow, epoch );
+
+    return rank;
+}
+
+int tree_cow_walk( struct tree_t* p_tree, struct entry_t* p_start_key, size_t skip,
+                   int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    unsigned long epoch = tree_cow_enter( p_tree->p_cow );
+
+    struct cow_node_t* p_root = cow_root( p_tree->p_cow );
+    size_t start = p_start_key ? cow_rank( p_root, p_start_key ) : 0;
+    int stopped = cow_walk_from( p_root, start + skip, callback, p_context );
+
+    tree_cow_exit( p_tree->p_cow, epoch );
+
+    return stopped;
+}
+
+void** tree_cow_collect( struct tree_t* p_tree, size_t offset, size_t limit,
+                         int (*append)( struct entry_t* p_entry, void* p_append ), size_t* p_keysizes )
+{
+    unsigned long epoch = tree_cow_enter( p_tree->p_cow );
+
+    // The array is sized from the same snapshot that is walked.
+    struct cow_node_t* p_root = cow_root( p_tree->p_cow );
+    size_t size = offset < cow_size( p_root ) ? cow_size( p_root ) - offset : 0;
+    void** pp_items = NULL;
+
+    if ( size > limit )
+        size = limit;
+
+    if ( (pp_items = (void**)calloc( sizeof( void* ), size + 1 )) && size > 0 )
+    {
+        struct tree_append_t append_state = { pp_items, 0, size, p_keysizes };
+        cow_walk_from( p_root, offset, append, &append_state );
+    }
+
+    tree_cow_exit( p_tree->p_cow, epoch );
+
+    return pp_items;
+}
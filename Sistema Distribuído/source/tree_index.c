@@ -0,0 +1,206 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree-private.h"
+#include "tree_index-private.h"
+#include "entry-private.h"
+
+struct tree_index_t* tree_index_create()
+{
+    struct tree_index_t* p_index = NULL;
+
+    if ( !(p_index = (struct tree_index_t*)malloc( sizeof( struct tree_index_t ) )) )
+        return NULL;
+
+    if ( !(p_index->p_slots = (struct tree_index_slot_t*)calloc( TREE_INDEX_INITIAL_CAPACITY,
+                                                                   sizeof( struct tree_index_slot_t ) )) )
+    {
+        free( p_index );
+        return NULL;
+    }
+
+    p_index->capacity = TREE_INDEX_INITIAL_CAPACITY;
+    p_index->count = 0;
+    p_index->n_old_slots = 0;
+
+    return p_index;
+}
+
+void tree_index_destroy( struct tree_index_t* p_index )
+{
+    if ( !p_index )
+        return;
+
+    for ( int i = 0; i < p_index->n_old_slots; i++ )
+        free( p_index->pp_old_slots[i] );
+
+    free( p_index->p_slots );
+    free( p_index );
+}
+
+uint64_t tree_index_hash( const char* p_key, size_t keysize )
+{
+    // FNV-1a, with a final mix so the low bits (used to pick the slot) depend on every byte.
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for ( size_t i = 0; i < keysize; i++ )
+    {
+        hash ^= (uint8_t)p_key[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+struct node_t* tree_index_find( struct tree_index_t* p_index, struct entry_t* p_key, uint64_t hash )
+{
+    size_t mask = p_index->capacity - 1;
+
+    for ( size_t i = hash & mask; p_index->p_slots[i].p_node; i = (i + 1) & mask )
+    {
+        struct tree_index_slot_t* p_slot = &p_index->p_slots[i];
+
+        if ( p_slot->hash == hash && entry_key_compare( p_key, &p_slot->p_node->entry ) == 0 )
+            return p_slot->p_node;
+    }
+
+    return NULL;
+}
+
+int tree_index_find_optimistic( struct tree_index_t* p_index, struct entry_t* p_key, uint64_t hash,
+                                struct node_t** pp_node )
+{
+    size_t capacity = __atomic_load_n( &p_index->capacity, __ATOMIC_ACQUIRE );
+    struct tree_index_slot_t* p_slots = __atomic_load_n( &p_index->p_slots, __ATOMIC_RELAXED );
+    size_t mask = capacity - 1;
+    size_t i = hash & mask;
+
+    // A full index can't happen (see TREE_INDEX_LOAD_NUM), but a slot array being rehashed can look like one.
+    for ( size_t n_probes = 0; n_probes < capacity; n_probes++, i = (i + 1) & mask )
+    {
+        struct node_t* p_node = __atomic_load_n( &p_slots[i].p_node, __ATOMIC_RELAXED );
+        int compare_value;
+
+        if ( !p_node )
+            return 0;
+
+        if ( __atomic_load_n( &p_slots[i].hash, __ATOMIC_RELAXED ) != hash )
+            continue;
+
+        if ( node_key_compare_optimistic( p_node, p_key, &compare_value ) < 0 )
+            return -1;
+
+        if ( compare_value == 0 )
+        {
+            *pp_node = p_node;
+            return 1;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Puts a node on the first free slot of its probe sequence.
+ */
+static void tree_index_place( struct tree_index_slot_t* p_slots, size_t capacity, struct node_t* p_node,
+                              uint64_t hash )
+{
+    size_t mask = capacity - 1;
+    size_t i = hash & mask;
+
+    while ( p_slots[i].p_node )
+        i = (i + 1) & mask;
+
+    p_slots[i].hash = hash;
+    p_slots[i].p_node = p_node;
+}
+
+int tree_index_reserve( struct tree_index_t* p_index, size_t count )
+{
+    size_t capacity = p_index->capacity;
+
+    while ( count * TREE_INDEX_LOAD_DEN > capacity * TREE_INDEX_LOAD_NUM )
+        capacity *= 2;
+
+    if ( capacity == p_index->capacity )
+        return 0;
+
+    if ( p_index->n_old_slots == TREE_INDEX_MAX_OLD_SLOTS )
+        return -1;
+
+    struct tree_index_slot_t* p_slots = NULL;
+
+    if ( !(p_slots = (struct tree_index_slot_t*)calloc( capacity, sizeof( struct tree_index_slot_t ) )) )
+        return -1;
+
+    // Rehash. The stored hashes are reused.
+    for ( size_t i = 0; i < p_index->capacity; i++ )
+    {
+        if ( p_index->p_slots[i].p_node )
+            tree_index_place( p_slots, capacity, p_index->p_slots[i].p_node, p_index->p_slots[i].hash );
+    }
+
+    // Lookups that don't take the tree's lock may still be reading the old slots.
+    p_index->pp_old_slots[p_index->n_old_slots++] = p_index->p_slots;
+
+    __atomic_store_n( &p_index->p_slots, p_slots, __ATOMIC_RELEASE );
+    __atomic_store_n( &p_index->capacity, capacity, __ATOMIC_RELEASE );
+
+    return 0;
+}
+
+void tree_index_insert( struct tree_index_t* p_index, struct node_t* p_node, uint64_t hash )
+{
+    tree_index_place( p_index->p_slots, p_index->capacity, p_node, hash );
+    p_index->count++;
+}
+
+/*
+ * Finds the slot of a node.
+ *
+ * Returns:
+ *      Slot index; capacity if the node isn't indexed.
+ */
+static size_t tree_index_slot_of( struct tree_index_t* p_index, struct node_t* p_node, uint64_t hash )
+{
+    size_t mask = p_index->capacity - 1;
+
+    for ( size_t i = hash & mask; p_index->p_slots[i].p_node; i = (i + 1) & mask )
+    {
+        if ( p_index->p_slots[i].p_node == p_node )
+            return i;
+    }
+
+    return p_index->capacity;
+}
+
+void tree_index_remove( struct tree_index_t* p_index, struct node_t* p_node, uint64_t hash )
+{
+    size_t mask = p_index->capacity - 1;
+    size_t i = tree_index_slot_of( p_index, p_node, hash );
+
+    if ( i == p_index->capacity )
+        return;
+
+    // Backward shift: move back every following node of the cluster whose home slot is not in (i, j].
+    for ( size_t j = (i + 1) & mask; p_index->p_slots[j].p_node; j = (j + 1) & mask )
+    {
+        size_t home = p_index->p_slots[j].hash & mask;
+        int is_home_in_range = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+
+        if ( !is_home_in_range )
+        {
+            p_index->p_slots[i] = p_index->p_slots[j];
+            i = j;
+        }
+    }
+
+    p_index->p_slots[i].p_node = NULL;
+    p_index->count--;
+}
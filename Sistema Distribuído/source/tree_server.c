@@ -8,6 +8,7 @@
 #include "shared-private.h"
 #include "network_server.h"
 #include "tree_skel-private.h"
+#include "tree_shard-private.h"
 
 void sigint_handler()
 {
@@ -21,10 +22,10 @@ int main(int argc, char **argv)
     signal( SIGPIPE, SIG_IGN );
 
     // Verifiy if the argument are present.
-    if ( argc != 3 )
+    if ( argc < 3 || argc > 6 )
     {
-        printf( "Usage: ./tree-server <port> <n_threads>\n" );
-        printf( "Example: ./tree-server 1234 5\n" );
+        printf( "Usage: ./tree-server <port> <n_threads> [bst|avl|art|bptree|cow] [n_shards] [coalesce]\n" );
+        printf( "Example: ./tree-server 1234 5 art 8 coalesce\n" );
         exit( EXIT_FAILURE );
     }
 
@@ -50,6 +51,40 @@ int main(int argc, char **argv)
         exit( EXIT_FAILURE );
     }
 
+    // Verify and parse the tree type; avl by default.
+    int tree_type = TREE_AVL | TREE_HASH_INDEX;
+
+    if ( argc >= 4 && (tree_type = parse_tree_type( argv[3] )) < 0 )
+    {
+        exit( EXIT_FAILURE );
+    }
+
+    // Verify and parse the number of shards.
+    int n_shards = TREE_SKEL_DEFAULT_SHARDS;
+
+    if ( argc >= 5 && (n_shards = parse_int( argv[4] )) < 0 )
+    {
+        exit( EXIT_FAILURE );
+    }
+
+    if ( n_shards < 1 || n_shards > TREE_SHARDS_MAX )
+    {
+        fprintf( stderr, "The number of shards must be between 1 and %d.\n", TREE_SHARDS_MAX );
+        exit( EXIT_FAILURE );
+    }
+
+    // Coalescing of the writes of the same key; off by default.
+    if ( argc == 6 )
+    {
+        if ( strcmp( argv[5], "coalesce" ) != 0 )
+        {
+            fprintf( stderr, "The last argument can only be coalesce: %s\n", argv[5] );
+            exit( EXIT_FAILURE );
+        }
+
+        tree_skel_set_coalescing( 1 );
+    }
+
     // Init server.
     int sockfd;
 
@@ -62,7 +97,7 @@ int main(int argc, char **argv)
     signal( SIGINT, sigint_handler );
 
     // Start tree.
-    if ( tree_skel_init(n_threads) < 0 )
+    if ( tree_skel_init3( n_threads, tree_type, n_shards ) < 0 )
     {
         fprintf( stderr, "%s : error starting tree skel.\n", strerror( errno ) );
         exit( EXIT_FAILURE );
@@ -0,0 +1,863 @@
+
+// For pthread_rwlockattr_setkind_np.
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "tree.h"
+#include "data.h"
+#include "entry.h"
+#include "entry-private.h"
+#include "tree-private.h"
+#include "tree_cow-private.h"
+#include "tree_index-private.h"
+#include "tree_shard-private.h"
+#include "slab.h"
+
+struct tree_shards_t* tree_shards_create( int n_shards, int type )
+{
+    if ( n_shards < 1 || n_shards > TREE_SHARDS_MAX )
+    {
+        errno = EINVAL;
+        fprintf( stderr, "%s : the number of shards must be between 1 and %d.\n", strerror(errno), TREE_SHARDS_MAX );
+        return NULL;
+    }
+
+    struct tree_shards_t* p_shards = NULL;
+
+    if ( !(p_shards = (struct tree_shards_t*)malloc( sizeof( struct tree_shards_t ) )) )
+        return NULL;
+
+    if ( posix_memalign( (void**)&p_shards->p_shards, TREE_SHARDS_CACHE_LINE,
+                         sizeof( struct tree_shard_t ) * n_shards ) )
+    {
+        free( p_shards );
+        return NULL;
+    }
+
+    p_shards->n_shards = 0;
+    p_shards->type = type;
+
+    pthread_rwlockattr_t lock_attr;
+    pthread_rwlockattr_init( &lock_attr );
+
+#ifdef __GLIBC__
+    // glibc prefers readers by default: with reads arriving all the time a writer could wait forever.
+    pthread_rwlockattr_setkind_np( &lock_attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP );
+#endif
+
+    for ( int i = 0; i < n_shards; i++ )
+    {
+        struct tree_shard_t* p_shard = &p_shards->p_shards[i];
+
+        if ( !(p_shard->p_tree = tree_create2( type )) )
+        {
+            pthread_rwlockattr_destroy( &lock_attr );
+            tree_shards_destroy( p_shards );
+            return NULL;
+        }
+
+        pthread_rwlock_init( &p_shard->lock, &lock_attr );
+        p_shard->sequence = 0;
+        p_shards->n_shards++;
+    }
+
+    pthread_rwlockattr_destroy( &lock_attr );
+
+    return p_shards;
+}
+
+void tree_shards_destroy( struct tree_shards_t* p_shards )
+{
+    if ( !p_shards )
+        return;
+
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+    {
+        tree_destroy( p_shards->p_shards[i].p_tree );
+        pthread_rwlock_destroy( &p_shards->p_shards[i].lock );
+    }
+
+    free( p_shards->p_shards );
+    free( p_shards );
+}
+
+struct tree_shard_t* tree_shards_of( struct tree_shards_t* p_shards, char* p_key, size_t keysize )
+{
+    return &p_shards->p_shards[tree_shards_index( p_shards, p_key, keysize )];
+}
+
+int tree_shards_index( struct tree_shards_t* p_shards, char* p_key, size_t keysize )
+{
+    // The hash index's hash: its low bits are already mixed.
+    return (int)(tree_index_hash( p_key, keysize ) % (uint64_t)p_shards->n_shards);
+}
+
+/*
+ * Start / end of a change to a shard's tree, with its lock write locked: the sequence is odd in between, so the
+ * optimistic gets that overlap the change see it.
+ */
+static void tree_shards_write_begin( struct tree_shard_t* p_shard )
+{
+    __atomic_store_n( &p_shard->sequence, p_shard->sequence + 1, __ATOMIC_RELAXED );
+
+    // The odd sequence is visible before any change to the tree.
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+static void tree_shards_write_end( struct tree_shard_t* p_shard )
+{
+    __atomic_store_n( &p_shard->sequence, p_shard->sequence + 1, __ATOMIC_RELEASE );
+}
+
+void tree_shards_rdlock_all( struct tree_shards_t* p_shards )
+{
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+        pthread_rwlock_rdlock( &p_shards->p_shards[i].lock );
+}
+
+void tree_shards_wrlock_all( struct tree_shards_t* p_shards )
+{
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+        pthread_rwlock_wrlock( &p_shards->p_shards[i].lock );
+}
+
+void tree_shards_unlock_all( struct tree_shards_t* p_shards )
+{
+    for ( int i = p_shards->n_shards - 1; i >= 0; i-- )
+        pthread_rwlock_unlock( &p_shards->p_shards[i].lock );
+}
+
+/*
+ * Starts / ends a read of the whole store: read locks every shard or, on TREE_COW shards (whose readers don't lock),
+ * enters an epoch on each one, so the entries seen by the read stay allocated until it ends.
+ *
+ * Parameters:
+ *      p_epochs: Epochs entered, one per shard (TREE_SHARDS_MAX of them).
+ */
+static void tree_shards_read_begin( struct tree_shards_t* p_shards, unsigned long* p_epochs )
+{
+    if ( p_shards->type != TREE_COW )
+    {
+        tree_shards_rdlock_all( p_shards );
+        return;
+    }
+
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+        p_epochs[i] = tree_cow_enter( p_shards->p_shards[i].p_tree->p_cow );
+}
+
+static void tree_shards_read_end( struct tree_shards_t* p_shards, unsigned long* p_epochs )
+{
+    if ( p_shards->type != TREE_COW )
+    {
+        tree_shards_unlock_all( p_shards );
+        return;
+    }
+
+    for ( int i = p_shards->n_shards - 1; i >= 0; i-- )
+        tree_cow_exit( p_shards->p_shards[i].p_tree->p_cow, p_epochs[i] );
+}
+
+int tree_shards_put_take( struct tree_shards_t* p_shards, char* p_key, size_t keysize, struct data_t* p_value )
+{
+    if ( !p_shards || !p_key )
+    {
+        data_destroy( p_value );
+        return -1;
+    }
+
+    struct tree_shard_t* p_shard = tree_shards_of( p_shards, p_key, keysize );
+
+    pthread_rwlock_wrlock( &p_shard->lock );
+    tree_shards_write_begin( p_shard );
+    int result = tree_put_take( p_shard->p_tree, p_key, keysize, p_value );
+    tree_shards_write_end( p_shard );
+    pthread_rwlock_unlock( &p_shard->lock );
+
+    return result;
+}
+
+struct data_t* tree_shards_get2( struct tree_shards_t* p_shards, char* p_key, size_t keysize )
+{
+    if ( !p_shards || !p_key )
+        return NULL;
+
+    struct tree_shard_t* p_shard = tree_shards_of( p_shards, p_key, keysize );
+
+    // A TREE_COW tree reads its own snapshot: the lock would only make the read wait for the writer.
+    if ( p_shards->type == TREE_COW )
+        return tree_get2( p_shard->p_tree, p_key, keysize );
+
+    if ( TREE_USES_NODES( p_shard->p_tree->type ) )
+    {
+        char value[NODE_INLINE_VALUE_SIZE];
+        int value_size = 0;
+        int found = -1;
+
+        unsigned long sequence = __atomic_load_n( &p_shard->sequence, __ATOMIC_ACQUIRE );
+
+        if ( !(sequence & 1) )
+        {
+            found = tree_get_optimistic( p_shard->p_tree, p_key, keysize, value, &value_size );
+
+            // The tree reads are done before the sequence is read again.
+            __atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+            if ( __atomic_load_n( &p_shard->sequence, __ATOMIC_RELAXED ) != sequence )
+                found = -1;
+        }
+
+        if ( found == 0 )
+            return NULL;
+
+        if ( found == 1 )
+        {
+            char* p_data = NULL;
+            struct data_t* p_value = NULL;
+
+            if ( !(p_data = (char*)slab_alloc( value_size )) )
+                return NULL;
+
+            memcpy( p_data, value, value_size );
+
+            if ( !(p_value = data_create2( value_size, p_data )) )
+                slab_free( p_data );
+
+            return p_value;
+        }
+    }
+
+    pthread_rwlock_rdlock( &p_shard->lock );
+    struct data_t* p_value = tree_get2( p_shard->p_tree, p_key, keysize );
+    pthread_rwlock_unlock( &p_shard->lock );
+
+    return p_value;
+}
+
+int tree_shards_del2( struct tree_shards_t* p_shards, char* p_key, size_t keysize )
+{
+    if ( !p_shards || !p_key )
+        return -1;
+
+    struct tree_shard_t* p_shard = tree_shards_of( p_shards, p_key, keysize );
+
+    pthread_rwlock_wrlock( &p_shard->lock );
+    tree_shards_write_begin( p_shard );
+    int result = tree_del2( p_shard->p_tree, p_key, keysize );
+    tree_shards_write_end( p_shard );
+    pthread_rwlock_unlock( &p_shard->lock );
+
+    return result;
+}
+
+int tree_shards_write_batch( struct tree_shards_t* p_shards, struct tree_shards_write_t* p_writes, int n )
+{
+    if ( !p_shards || n < 0 || (n > 0 && !p_writes) )
+        return -1;
+
+    char is_touched[TREE_SHARDS_MAX] = { 0 };
+
+    for ( int i = 0; i < n; i++ )
+        is_touched[tree_shards_index( p_shards, p_writes[i].p_key, p_writes[i].keysize )] = 1;
+
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+    {
+        if ( !is_touched[i] )
+            continue;
+
+        pthread_rwlock_wrlock( &p_shards->p_shards[i].lock );
+        tree_shards_write_begin( &p_shards->p_shards[i] );
+    }
+
+    int result = 0;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        struct tree_shards_write_t* p_write = &p_writes[i];
+        struct tree_t* p_tree = tree_shards_of( p_shards, p_write->p_key, p_write->keysize )->p_tree;
+
+        if ( p_write->p_value )
+            p_write->result = tree_put_take( p_tree, p_write->p_key, p_write->keysize, p_write->p_value );
+        else
+            p_write->result = tree_del2( p_tree, p_write->p_key, p_write->keysize );
+
+        if ( p_write->result < 0 )
+            result = -1;
+    }
+
+    for ( int i = p_shards->n_shards - 1; i >= 0; i-- )
+    {
+        if ( !is_touched[i] )
+            continue;
+
+        tree_shards_write_end( &p_shards->p_shards[i] );
+        pthread_rwlock_unlock( &p_shards->p_shards[i].lock );
+    }
+
+    return result;
+}
+
+/*
+ * Splits the entries by shard, keeping their order: the entries of shard i end up on
+ * pp_split[p_starts[i]..p_starts[i + 1]).
+ *
+ * Returns:
+ *      The split array (free it); NULL if there was no memory.
+ */
+static struct entry_t** tree_shards_split( struct tree_shards_t* p_shards, struct entry_t** pp_entries, int n,
+                                           int* p_starts )
+{
+    struct entry_t** pp_split = NULL;
+    int* p_shard_of = NULL;
+
+    if ( !(pp_split = (struct entry_t**)malloc( sizeof( struct entry_t* ) * (n ? n : 1) )) ||
+         !(p_shard_of = (int*)malloc( sizeof( int ) * (n ? n : 1) )) )
+    {
+        free( pp_split );
+        return NULL;
+    }
+
+    memset( p_starts, 0, sizeof( int ) * (p_shards->n_shards + 1) );
+
+    for ( int i = 0; i < n; i++ )
+    {
+        p_shard_of[i] = tree_shards_index( p_shards, pp_entries[i]->key, pp_entries[i]->keysize );
+        p_starts[p_shard_of[i] + 1]++;
+    }
+
+    // Prefix sums: p_starts[i] becomes the start of shard i.
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+        p_starts[i + 1] += p_starts[i];
+
+    // p_starts[i] is the insertion point of shard i, which leaves it on the start of shard i + 1: shift them back.
+    for ( int i = 0; i < n; i++ )
+        pp_split[p_starts[p_shard_of[i]]++] = pp_entries[i];
+
+    for ( int i = p_shards->n_shards; i > 0; i-- )
+        p_starts[i] = p_starts[i - 1];
+
+    p_starts[0] = 0;
+
+    free( p_shard_of );
+
+    return pp_split;
+}
+
+int tree_shards_put_batch( struct tree_shards_t* p_shards, struct entry_t** pp_entries, int n )
+{
+    if ( !p_shards || n < 0 || (n > 0 && !pp_entries) )
+        return -1;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        if ( !pp_entries[i] || !pp_entries[i]->key || !pp_entries[i]->value )
+            return -1;
+    }
+
+    int starts[TREE_SHARDS_MAX + 1];
+    struct entry_t** pp_split = NULL;
+
+    if ( !(pp_split = tree_shards_split( p_shards, pp_entries, n, starts )) )
+        return -1;
+
+    int result = 0;
+
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+    {
+        if ( starts[i + 1] == starts[i] )
+            continue;
+
+        struct tree_shard_t* p_shard = &p_shards->p_shards[i];
+
+        pthread_rwlock_wrlock( &p_shard->lock );
+        tree_shards_write_begin( p_shard );
+        if ( tree_put_batch( p_shard->p_tree, pp_split + starts[i], starts[i + 1] - starts[i] ) < 0 )
+            result = -1;
+        tree_shards_write_end( p_shard );
+        pthread_rwlock_unlock( &p_shard->lock );
+    }
+
+    free( pp_split );
+
+    return result;
+}
+
+int tree_shards_bulk_load( struct tree_shards_t* p_shards, struct entry_t** pp_entries, int n )
+{
+    if ( !p_shards || n < 0 || (n > 0 && !pp_entries) )
+        return -1;
+
+    // The order is checked here: each shard only sees part of the entries.
+    for ( int i = 0; i < n; i++ )
+    {
+        if ( !pp_entries[i] || !pp_entries[i]->key )
+            return -1;
+
+        if ( i > 0 && entry_key_compare( pp_entries[i - 1], pp_entries[i] ) >= 0 )
+            return -1;
+    }
+
+    int starts[TREE_SHARDS_MAX + 1];
+    struct entry_t** pp_split = NULL;
+
+    if ( !(pp_split = tree_shards_split( p_shards, pp_entries, n, starts )) )
+        return -1;
+
+    int result = 0;
+    int i;
+
+    tree_shards_wrlock_all( p_shards );
+
+    for ( i = 0; i < p_shards->n_shards; i++ )
+        tree_shards_write_begin( &p_shards->p_shards[i] );
+
+    for ( i = 0; i < p_shards->n_shards; i++ )
+    {
+        if ( tree_size( p_shards->p_shards[i].p_tree ) > 0 )
+        {
+            result = -1;
+            break;
+        }
+    }
+
+    for ( i = 0; result == 0 && i < p_shards->n_shards; i++ )
+    {
+        if ( tree_bulk_load( p_shards->p_shards[i].p_tree, pp_split + starts[i], starts[i + 1] - starts[i] ) < 0 )
+        {
+            result = -1;
+
+            // Empty the shards already loaded (a failed tree_bulk_load leaves its own shard empty).
+            while ( i-- > 0 )
+            {
+                for ( int j = starts[i]; j < starts[i + 1]; j++ )
+                    tree_del2( p_shards->p_shards[i].p_tree, pp_split[j]->key, pp_split[j]->keysize );
+            }
+
+            break;
+        }
+    }
+
+    for ( i = 0; i < p_shards->n_shards; i++ )
+        tree_shards_write_end( &p_shards->p_shards[i] );
+
+    tree_shards_unlock_all( p_shards );
+
+    free( pp_split );
+
+    return result;
+}
+
+int tree_shards_size( struct tree_shards_t* p_shards )
+{
+    if ( !p_shards )
+        return 0;
+
+    unsigned long epochs[TREE_SHARDS_MAX];
+    int size = 0;
+
+    tree_shards_read_begin( p_shards, epochs );
+
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+        size += tree_size( p_shards->p_shards[i].p_tree );
+
+    tree_shards_read_end( p_shards, epochs );
+
+    return size;
+}
+
+int tree_shards_height( struct tree_shards_t* p_shards )
+{
+    if ( !p_shards )
+        return 0;
+
+    int height = 0;
+
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+    {
+        struct tree_shard_t* p_shard = &p_shards->p_shards[i];
+        int shard_height;
+
+        if ( p_shards->type == TREE_COW )
+            shard_height = tree_height( p_shard->p_tree );
+        else
+        {
+            pthread_rwlock_rdlock( &p_shard->lock );
+            shard_height = tree_height( p_shard->p_tree );
+            pthread_rwlock_unlock( &p_shard->lock );
+        }
+
+        if ( shard_height > height )
+            height = shard_height;
+    }
+
+    return height;
+}
+
+int tree_shards_run_append( struct entry_t* p_entry, void* p_run )
+{
+    struct tree_shards_run_t* p_state = (struct tree_shards_run_t*)p_run;
+
+    if ( p_state->n_entries == p_state->capacity )
+    {
+        size_t new_capacity = p_state->capacity ? p_state->capacity * 2 : 64;
+        struct entry_t** pp_entries;
+
+        if ( !(pp_entries = (struct entry_t**)realloc( p_state->pp_entries, sizeof( struct entry_t* ) * new_capacity )) )
+            return -1;
+
+        p_state->pp_entries = pp_entries;
+        p_state->capacity = new_capacity;
+    }
+
+    p_state->pp_entries[p_state->n_entries++] = p_entry;
+
+    return 0;
+}
+
+/*
+ * tree_shards_merge inside a read started by the caller (see tree_shards_read_begin).
+ */
+static int tree_shards_merge_read( struct tree_shards_t* p_shards, struct entry_t* p_start_key,
+                                   struct entry_t* p_end_key, struct entry_t* p_prefix, size_t skip, int limit,
+                                   int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    struct tree_shards_run_t runs[TREE_SHARDS_MAX];
+    int result = 0;
+
+    memset( runs, 0, sizeof( runs ) );
+
+    // No shard contributes more than the first skip + limit entries of the merge (saturated to what tree_scan takes; 0
+    // scans the whole shard).
+    size_t run_size = limit > 0 ? skip + (size_t)limit : 0;
+    int run_limit = run_size > INT_MAX || run_size < skip ? 0 : (int)run_size;
+
+    for ( int i = 0; result == 0 && i < p_shards->n_shards; i++ )
+    {
+        struct tree_t* p_tree = p_shards->p_shards[i].p_tree;
+        int n_scanned = p_prefix ? tree_scan_prefix2( p_tree, p_prefix->key, p_prefix->keysize, run_limit,
+                                                      tree_shards_run_append, &runs[i] )
+                                 : tree_scan2( p_tree, p_start_key ? p_start_key->key : NULL,
+                                               p_start_key ? p_start_key->keysize : 0,
+                                               p_end_key ? p_end_key->key : NULL, p_end_key ? p_end_key->keysize : 0,
+                                               run_limit, tree_shards_run_append, &runs[i] );
+
+        if ( n_scanned < 0 || (size_t)n_scanned != runs[i].n_entries )
+            result = -1;
+    }
+
+    int count = 0;
+
+    while ( result == 0 && (limit <= 0 || count < limit) )
+    {
+        // Smallest head among the shards. The shards hold disjoint keys, so there are no ties.
+        struct tree_shards_run_t* p_min_run = NULL;
+
+        for ( int i = 0; i < p_shards->n_shards; i++ )
+        {
+            struct tree_shards_run_t* p_run = &runs[i];
+
+            if ( p_run->position < p_run->n_entries &&
+                 (!p_min_run || entry_key_compare( p_run->pp_entries[p_run->position],
+                                                   p_min_run->pp_entries[p_min_run->position] ) < 0) )
+                p_min_run = p_run;
+        }
+
+        if ( !p_min_run )
+            break;
+
+        struct entry_t* p_entry = p_min_run->pp_entries[p_min_run->position++];
+
+        if ( skip > 0 )
+        {
+            skip--;
+            continue;
+        }
+
+        count++;
+
+        // A negative return is an error of the callback; a positive one only stops the merge.
+        int stop = callback( p_entry, p_context );
+
+        if ( stop < 0 )
+            result = -1;
+        else if ( stop )
+            break;
+    }
+
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+        free( runs[i].pp_entries );
+
+    return result < 0 ? -1 : count;
+}
+
+int tree_shards_merge( struct tree_shards_t* p_shards, struct entry_t* p_start_key, struct entry_t* p_end_key,
+                       struct entry_t* p_prefix, size_t skip, int limit,
+                       int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    if ( !p_shards || !callback )
+        return -1;
+
+    unsigned long epochs[TREE_SHARDS_MAX];
+
+    tree_shards_read_begin( p_shards, epochs );
+    int result = tree_shards_merge_read( p_shards, p_start_key, p_end_key, p_prefix, skip, limit, callback,
+                                         p_context );
+    tree_shards_read_end( p_shards, epochs );
+
+    return result;
+}
+
+/*
+ * Merge callback that builds the tree_get_values array. The array is NULL terminated after every append; it grows
+ * when it is full (only TREE_COW stores, which aren't presized).
+ */
+struct tree_shards_append_t
+{
+    void** pp_items;
+    size_t n_items;
+    size_t capacity;
+};
+
+static int tree_shards_append_reserve( struct tree_shards_append_t* p_state )
+{
+    if ( p_state->n_items + 1 < p_state->capacity )
+        return 0;
+
+    size_t new_capacity = p_state->capacity * 2;
+    void** pp_items;
+
+    if ( !(pp_items = (void**)realloc( p_state->pp_items, sizeof( void* ) * new_capacity )) )
+        return -1;
+
+    p_state->pp_items = pp_items;
+    p_state->capacity = new_capacity;
+
+    return 0;
+}
+
+static int tree_shards_append_value( struct entry_t* p_entry, void* p_append )
+{
+    struct tree_shards_append_t* p_state = (struct tree_shards_append_t*)p_append;
+
+    struct data_t* p_value;
+
+    if ( tree_shards_append_reserve( p_state ) < 0 || !(p_value = data_share( p_entry->value )) )
+        return -1;
+
+    p_state->pp_items[p_state->n_items++] = p_value;
+    p_state->pp_items[p_state->n_items] = NULL;
+
+    return 0;
+}
+
+/*
+ * Finds the key at an index of the merge of the shards from their ranks, without merging them: on each shard, a binary
+ * search for the position whose key has index keys smaller than it on all the shards. O(n_shards^2 log^2 n) tree
+ * lookups instead of the O(n_shards * index) entries of a merge. Called inside a read (see tree_shards_read_begin).
+ *
+ * Returns:
+ *      1 with a copy of the key on *pp_key and its size on *p_keysize; 0 if index is out of bounds; -1 if the search
+ *      failed (no memory, or a TREE_COW shard changed between the lookups), and the caller merges.
+ */
+static int tree_shards_select( struct tree_shards_t* p_shards, size_t index, char** pp_key, size_t* p_keysize )
+{
+    size_t size = 0;
+
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+        size += tree_size( p_shards->p_shards[i].p_tree );
+
+    // The sizes of locked shards are exact.
+    if ( index >= size && p_shards->type != TREE_COW )
+        return 0;
+
+    for ( int i = 0; i < p_shards->n_shards; i++ )
+    {
+        struct tree_t* p_tree = p_shards->p_shards[i].p_tree;
+        size_t low = 0;
+        size_t high = tree_size( p_tree );
+
+        // The key at position j of a shard has at least j keys smaller than it.
+        if ( high > index + 1 )
+            high = index + 1;
+
+        while ( low < high )
+        {
+            size_t middle = low + (high - low) / 2;
+            size_t keysize;
+            char* p_key = tree_get_key_at2( p_tree, (int)middle, &keysize );
+
+            if ( !p_key )
+                return -1;
+
+            size_t rank = middle;
+
+            for ( int j = 0; j < p_shards->n_shards && rank <= index; j++ )
+            {
+                int shard_rank = j == i ? 0 : tree_get_rank2( p_shards->p_shards[j].p_tree, p_key, keysize );
+
+                if ( shard_rank < 0 )
+                {
+                    free( p_key );
+                    return -1;
+                }
+
+                rank += shard_rank;
+            }
+
+            if ( rank == index )
+            {
+                *pp_key = p_key;
+                *p_keysize = keysize;
+                return 1;
+            }
+
+            free( p_key );
+
+            if ( rank < index )
+                low = middle + 1;
+            else
+                high = middle;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * tree_shards_page inside a read started by the caller (see tree_shards_read_begin).
+ */
+static int tree_shards_page_read( struct tree_shards_t* p_shards, size_t offset, int limit,
+                                  int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    struct entry_t start_key;
+    char* p_start_key = NULL;
+    size_t start_keysize;
+
+    // The merge starts at the key at offset, so no shard scans the offset entries before it.
+    if ( offset > 0 && limit > 0 )
+    {
+        int found = tree_shards_select( p_shards, offset, &p_start_key, &start_keysize );
+
+        if ( found == 0 )
+            return 0;
+
+        if ( found > 0 )
+        {
+            entry_key_set( &start_key, p_start_key, start_keysize );
+            offset = 0;
+        }
+    }
+
+    int result = tree_shards_merge_read( p_shards, p_start_key ? &start_key : NULL, NULL, NULL, offset, limit,
+                                         callback, p_context );
+    free( p_start_key );
+
+    return result;
+}
+
+int tree_shards_page( struct tree_shards_t* p_shards, size_t offset, int limit,
+                      int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    if ( !p_shards || !callback )
+        return -1;
+
+    unsigned long epochs[TREE_SHARDS_MAX];
+
+    tree_shards_read_begin( p_shards, epochs );
+    int result = tree_shards_page_read( p_shards, offset, limit, callback, p_context );
+    tree_shards_read_end( p_shards, epochs );
+
+    return result;
+}
+
+void** tree_shards_get_values( struct tree_shards_t* p_shards )
+{
+    if ( !p_shards )
+        return NULL;
+
+    unsigned long epochs[TREE_SHARDS_MAX];
+    size_t size = 0;
+
+    tree_shards_read_begin( p_shards, epochs );
+
+    // Locked shards can't change: the array is sized once. The sizes of TREE_COW shards are read on other snapshots
+    // than the merge's, so there the array starts small and grows.
+    if ( p_shards->type != TREE_COW )
+    {
+        for ( int i = 0; i < p_shards->n_shards; i++ )
+            size += tree_size( p_shards->p_shards[i].p_tree );
+    }
+    else
+        size = 63;
+
+    struct tree_shards_append_t append_state = { NULL, 0, size + 1 };
+
+    if ( (append_state.pp_items = (void**)calloc( sizeof( void* ), size + 1 )) && size > 0 &&
+         tree_shards_merge_read( p_shards, NULL, NULL, NULL, 0, 0, tree_shards_append_value, &append_state ) < 0 )
+    {
+        // Only the items already appended are freed (the array is NULL terminated after them).
+        tree_free_values( append_state.pp_items );
+        append_state.pp_items = NULL;
+    }
+
+    tree_shards_read_end( p_shards, epochs );
+
+    return append_state.pp_items;
+}
+
+int tree_shards_get_rank2( struct tree_shards_t* p_shards, char* p_key, size_t keysize )
+{
+    if ( !p_shards || !p_key )
+        return -1;
+
+    // The keys smaller than key on every shard.
+    unsigned long epochs[TREE_SHARDS_MAX];
+    int rank = 0;
+
+    tree_shards_read_begin( p_shards, epochs );
+
+    for ( int i = 0; i < p_shards->n_shards && rank >= 0; i++ )
+    {
+        int shard_rank = tree_get_rank2( p_shards->p_shards[i].p_tree, p_key, keysize );
+        rank = shard_rank < 0 ? -1 : rank + shard_rank;
+    }
+
+    tree_shards_read_end( p_shards, epochs );
+
+    return rank;
+}
+
+int tree_shards_scan2( struct tree_shards_t* p_shards, char* p_start_key, size_t start_keysize, char* p_end_key,
+                       size_t end_keysize, int limit, int (*callback)( struct entry_t* p_entry, void* p_context ),
+                       void* p_context )
+{
+    struct entry_t start_key;
+    struct entry_t end_key;
+
+    if ( p_start_key )
+        entry_key_set( &start_key, p_start_key, start_keysize );
+
+    if ( p_end_key )
+        entry_key_set( &end_key, p_end_key, end_keysize );
+
+    return tree_shards_merge( p_shards, p_start_key ? &start_key : NULL, p_end_key ? &end_key : NULL, NULL, 0, limit,
+                              callback, p_context );
+}
+
+int tree_shards_scan_prefix2( struct tree_shards_t* p_shards, char* p_prefix, size_t prefixsize, int limit,
+                              int (*callback)( struct entry_t* p_entry, void* p_context ), void* p_context )
+{
+    if ( !p_prefix )
+        return -1;
+
+    struct entry_t prefix;
+    entry_key_set( &prefix, p_prefix, prefixsize );
+
+    return tree_shards_merge( p_shards, NULL, NULL, &prefix, 0, limit, callback, p_context );
+}
@@ -1,5 +1,7 @@
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
 #include <string.h>
 #include <malloc.h>
@@ -7,13 +9,18 @@
 #include <signal.h>
 
 #include "tree.h"
+#include "entry.h"
+#include "entry-private.h"
 #include "tree_skel.h"
 #include "tree_skel-private.h"
 #include "sdmessage.pb-c.h"
 #include "message-private.h"
+#include "slab.h"
+#include "tree_shard-private.h"
+#include "tree_index-private.h"
 
-// Server tree.
-struct tree_t *gp_TREE;
+// Server tree, split in shards (each with its own lock).
+struct tree_shards_t *gp_shards;
 
 // Threads
 int g_n_threads;
@@ -22,99 +29,432 @@ pthread_t *gp_threads_ids;
 int g_are_threads_running = 1;
 
 // Mutexes.
-pthread_mutex_t g_tree_lock, g_queue_lock, g_op_proc_lock = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t g_queue_not_empty_cond = PTHREAD_COND_INITIALIZER;
+pthread_mutex_t g_op_proc_lock = PTHREAD_MUTEX_INITIALIZER;
 
 // Writing operation counters.
 int g_last_assignment = 1;
 
-// Queue head.
-struct request_t *gp_queue_head = NULL;
+// Write requests waiting for each worker (see struct request_deque_t).
+struct request_deque_t *gp_deques = NULL;
+
+// Worker that owns (executes the writes of) each shard.
+int *gp_shard_owners = NULL;
+
+// Number of steals done by the idle workers.
+unsigned long g_n_steals = 0;
+
+// Where the workers wait for the others on the requests with several keys.
+pthread_mutex_t g_barrier_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t g_barrier_cond = PTHREAD_COND_INITIALIZER;
 
 // op_proc
 struct op_proc *gp_op_proc = NULL;
 
+// Batches of writes executed by the workers, and the requests on them (see tree_skel_average_batch_size).
+unsigned long g_n_batches = 0;
+unsigned long g_n_batched_requests = 0;
+
+// Coalescing of the writes (NULL when it is off).
+int g_is_coalescing = 0;
+struct coalesce_t *gp_coalesce = NULL;
+pthread_mutex_t g_coalesce_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
 void request_queue_sigint_handler()
 {
-    g_are_threads_running = 0;
+    tree_skel_request_queue_threads_destroy();
 
-    // We will lock and clean the queue.
-    pthread_mutex_lock( &g_queue_lock );
+    if ( !gp_deques )
+        return;
 
-    while( gp_queue_head != NULL )
+    // Clean the requests still queued.
+    for ( int i = 0; i < g_n_threads; i++ )
     {
-        struct request_t *p_request = gp_queue_head;
-        gp_queue_head = gp_queue_head->p_next;
-        request_destroy( p_request );
-    }
+        struct request_deque_t *p_deque = &gp_deques[i];
+
+        if ( !p_deque->pp_requests )
+            continue;
 
+        pthread_mutex_lock( &p_deque->lock );
+
+        for ( ; p_deque->n_requests; p_deque->head = (p_deque->head + 1) & p_deque->mask )
+        {
+            request_release( p_deque->pp_requests[p_deque->head] );
+            __atomic_store_n( &p_deque->n_requests, p_deque->n_requests - 1, __ATOMIC_RELAXED );
+        }
 
+        pthread_mutex_unlock( &p_deque->lock );
+    }
 }
 
-void *process_request( void *p_params )
+/*
+ * Creates an empty coalescing table for up to max_requests requests.
+ *
+ * Returns:
+ *      The table; NULL on error.
+ */
+static struct coalesce_t *coalesce_create( size_t max_requests )
 {
-    int thread_id = *(int *)p_params;
+    struct coalesce_t *p_coalesce = (struct coalesce_t *) malloc( sizeof( struct coalesce_t ));
 
-    while ( g_are_threads_running )
+    if ( !p_coalesce )
+        return NULL;
+
+    // At most half full, so the probes stay short.
+    p_coalesce->capacity = 2;
+
+    while ( p_coalesce->capacity < 2 * max_requests )
+        p_coalesce->capacity *= 2;
+
+    p_coalesce->n_requests = 0;
+    p_coalesce->n_coalesced = 0;
+
+    if ( !(p_coalesce->p_slots = (struct coalesce_slot_t *) calloc( p_coalesce->capacity,
+                                                                     sizeof( struct coalesce_slot_t ))))
     {
-        struct request_t *p_request = queue_get_next_request();
+        free( p_coalesce );
+        return NULL;
+    }
 
-        // This is only supposed to happen when the server and, consequently, the thread is shutting down. Since in
-        // normal occasions, the thread waits untils there is a request in the queue.
-        if ( p_request == NULL )
-        {
+    return p_coalesce;
+}
+
+/*
+ * Slot with the request of a key, or the empty slot where it would be. Called with g_coalesce_lock.
+ */
+static size_t coalesce_find( struct coalesce_t *p_coalesce, char *p_key, size_t keysize, uint64_t hash )
+{
+    size_t mask = p_coalesce->capacity - 1;
+    size_t slot = (size_t)hash & mask;
+    struct coalesce_slot_t *p_slot;
+
+    while ( (p_slot = &p_coalesce->p_slots[slot])->p_request )
+    {
+        if ( p_slot->hash == hash && p_slot->p_request->keysize == keysize
+             && (!keysize || memcmp( p_slot->p_request->p_key, p_key, keysize ) == 0) )
             break;
-        }
 
-        // Modify op_proc with the op number of the request being processed by this thread.
-        op_proc_set_in_progress( gp_op_proc, thread_id, p_request->op_n );
+        slot = (slot + 1) & mask;
+    }
 
-        int result = -1;
+    return slot;
+}
 
-        // Process request.
-        if ( p_request->op == REQUEST_PUT )
-        {
-            struct data_t *p_data = data_create2( p_request->p_data->datasize, p_request->p_data->data );
+/*
+ * Empties a slot. Called with g_coalesce_lock.
+ */
+static void coalesce_remove_slot( struct coalesce_t *p_coalesce, size_t slot )
+{
+    size_t mask = p_coalesce->capacity - 1;
+    size_t next = slot;
 
-            pthread_mutex_lock( &g_tree_lock );
-            result = tree_put( gp_TREE, p_request->p_key, p_request->p_data );
-            pthread_mutex_unlock( &g_tree_lock );
+    // Backward shift: move back the requests whose probe went through the slot being emptied.
+    while ( p_coalesce->p_slots[next = (next + 1) & mask].p_request )
+    {
+        size_t home = (size_t)p_coalesce->p_slots[next].hash & mask;
 
-            free( p_data );
-        } else
+        if ( ((next - home) & mask) >= ((next - slot) & mask) )
         {
-            pthread_mutex_lock( &g_tree_lock );
-            result = tree_del( gp_TREE, p_request->p_key );
-            pthread_mutex_unlock( &g_tree_lock );
+            p_coalesce->p_slots[slot] = p_coalesce->p_slots[next];
+            slot = next;
         }
+    }
+
+    p_coalesce->p_slots[slot].p_request = NULL;
+    p_coalesce->n_requests--;
+}
+
+/*
+ * Makes a write the pending write of its key, superseding the one that was (its value is freed at once, and it is
+ * marked done). Called by imvoke before the request is queued.
+ */
+static void coalesce_add( struct coalesce_t *p_coalesce, struct request_t *p_request )
+{
+    uint64_t hash = tree_index_hash( p_request->p_key, p_request->keysize );
+    struct data_t *p_superseded_data = NULL;
+    int superseded_op_n = 0;
+
+    pthread_mutex_lock( &g_coalesce_lock );
+
+    size_t slot = coalesce_find( p_coalesce, p_request->p_key, p_request->keysize, hash );
+    struct coalesce_slot_t *p_slot = &p_coalesce->p_slots[slot];
+
+    if ( p_slot->p_request )
+    {
+        // The request stays on its queue until its worker skips it (and may destroy it as soon as the lock is
+        // released), but its value isn't needed anymore.
+        struct request_t *p_superseded = p_slot->p_request;
+
+        p_superseded->is_superseded = 1;
+        p_superseded_data = p_superseded->p_data;
+        p_superseded->p_data = NULL;
+        superseded_op_n = p_superseded->op_n;
+
+        p_slot->p_request = p_request;
+        p_coalesce->n_coalesced++;
+    }
+        // A full table only stops the coalescing of new keys.
+    else if ( 2 * (p_coalesce->n_requests + 1) <= p_coalesce->capacity )
+    {
+        p_slot->hash = hash;
+        p_slot->p_request = p_request;
+        p_coalesce->n_requests++;
+    }
+
+    pthread_mutex_unlock( &g_coalesce_lock );
+
+    if ( superseded_op_n )
+    {
+        data_destroy( p_superseded_data );
+        op_proc_set_done( gp_op_proc, superseded_op_n );
+    }
+}
+
+/*
+ * Takes a write out of the table, as its worker is about to execute it.
+ *
+ * Returns:
+ *      1 if the request must be executed, 0 if it was superseded.
+ */
+static int coalesce_take( struct coalesce_t *p_coalesce, struct request_t *p_request )
+{
+    int result = 0;
+
+    pthread_mutex_lock( &g_coalesce_lock );
+
+    if ( !p_request->is_superseded )
+    {
+        size_t slot = coalesce_find( p_coalesce, p_request->p_key, p_request->keysize,
+                                     tree_index_hash( p_request->p_key, p_request->keysize ));
+
+        // Not there if the table was full when it was added.
+        if ( p_coalesce->p_slots[slot].p_request == p_request )
+            coalesce_remove_slot( p_coalesce, slot );
+
+        result = 1;
+    }
+
+    pthread_mutex_unlock( &g_coalesce_lock );
+
+    return result;
+}
+
+/*
+ * Initializes an empty deque for capacity requests (rounded up to a power of 2).
+ *
+ * Returns:
+ *      0 (ok) or -1 on error.
+ */
+static int request_deque_init( struct request_deque_t *p_deque, size_t capacity )
+{
+    size_t n_slots = 2;
+
+    while ( n_slots < capacity )
+        n_slots *= 2;
+
+    if ( !(p_deque->pp_requests = (struct request_t **) malloc( n_slots * sizeof( struct request_t * ))))
+        return -1;
+
+    pthread_mutex_init( &p_deque->lock, NULL );
+    pthread_cond_init( &p_deque->not_empty, NULL );
+    pthread_cond_init( &p_deque->not_full, NULL );
+    p_deque->mask = n_slots - 1;
+    p_deque->head = 0;
+    p_deque->n_requests = 0;
+    p_deque->busy_shards = 0;
+    p_deque->is_idle = 0;
+    p_deque->is_woken = 0;
+    p_deque->is_closed = 0;
+
+    return 0;
+}
+
+/*
+ * Arrival of a worker to a request with several keys. The last worker to arrive returns at once, to execute it; the
+ * others wait until it is done (or the server is shutting down), so none of them runs a later write first.
+ *
+ * Returns:
+ *      1 if this worker must execute the request, 0 otherwise.
+ */
+static int request_barrier_wait( struct request_t *p_request )
+{
+    int is_last;
+
+    pthread_mutex_lock( &g_barrier_lock );
+
+    is_last = --p_request->n_arrivals == 0;
+
+    while ( !is_last && !p_request->is_done && g_are_threads_running )
+        pthread_cond_wait( &g_barrier_cond, &g_barrier_lock );
+
+    pthread_mutex_unlock( &g_barrier_lock );
+
+    return is_last;
+}
+
+/*
+ * Lets the workers waiting on a request with several keys go.
+ */
+static void request_barrier_done( struct request_t *p_request )
+{
+    pthread_mutex_lock( &g_barrier_lock );
+
+    p_request->is_done = 1;
+    pthread_cond_broadcast( &g_barrier_cond );
+
+    pthread_mutex_unlock( &g_barrier_lock );
+}
+
+/*
+ * Executes a request with several keys (REQUEST_BULK_LOAD or REQUEST_PUT_BATCH) taken from the worker's queue, if it
+ * is the last worker to reach it (see request_barrier_wait).
+ */
+static void process_barrier( int thread_id, struct request_t *p_request )
+{
+    if ( !request_barrier_wait( p_request ) )
+    {
+        request_release( p_request );
+        return;
+    }
+
+    // Modify op_proc with the op number of the request being processed by this thread.
+    op_proc_set_in_progress( gp_op_proc, thread_id, p_request->op_n );
+
+    int result = -1;
+
+    if ( p_request->op == REQUEST_BULK_LOAD )
+    {
+        result = tree_shards_bulk_load( gp_shards, p_request->pp_entries, (int)p_request->n_entries );
+
+        if ( result < 0 )
+            fprintf( stderr, "Bulk load of op_n %d failed (the tree must be empty).\n", p_request->op_n );
+    } else
+    {
+        result = tree_shards_put_batch( gp_shards, p_request->pp_entries, (int)p_request->n_entries );
+
+        if ( result < 0 )
+            fprintf( stderr, "Put batch of op_n %d failed.\n", p_request->op_n );
+    }
+
+    // Recorded before it is done, so verify never reports it as done without the failure.
+    if ( result < 0 )
+        op_proc_set_failed( gp_op_proc, p_request->op_n );
+
+    printf( "\nThread %d has finished op_n %d", thread_id, p_request->op_n );
+
+    // The request is done (verify), and if its op was bigger that op_proc->max_proc, max_proc is updated.
+    if ( op_proc_finish( gp_op_proc, thread_id, &p_request->op_n, 1 ) )
+        printf( " and changed the max_proc variable." );
+
+    printf("\n\n");
+
+    request_barrier_done( p_request );
+    request_release( p_request );
+}
+
+/*
+ * Executes a batch of writes of one key, in queue (op_n) order, holding each shard's lock once for all of them, and
+ * marks them done with one update of op_proc.
+ */
+static void process_batch( int thread_id, struct request_t **pp_batch, int n_requests )
+{
+    struct tree_shards_write_t writes[TREE_SKEL_MAX_BATCH];
+    int op_ns[TREE_SKEL_MAX_BATCH];
+    int n = 0;
+
+    for ( int i = 0; i < n_requests; i++ )
+    {
+        // A later write of the key took its place (and it is already done).
+        if ( gp_coalesce && !coalesce_take( gp_coalesce, pp_batch[i] ) )
+            request_release( pp_batch[i] );
+        else
+            pp_batch[n++] = pp_batch[i];
+    }
 
-        // Marks this request as finished in the op_proc struct.
-        op_proc_set_in_progress( gp_op_proc, thread_id, 0 );
+    if ( n == 0 )
+        return;
 
-        if ( p_request  != NULL )
-            printf( "\nThread %d has finished op_n %d", thread_id, p_request->op_n );
+    // Modify op_proc with the op number of the request being processed by this thread.
+    op_proc_set_in_progress( gp_op_proc, thread_id, pp_batch[0]->op_n );
+
+    for ( int i = 0; i < n; i++ )
+    {
+        writes[i].p_key = pp_batch[i]->p_key;
+        writes[i].keysize = pp_batch[i]->keysize;
+        writes[i].p_value = pp_batch[i]->op == REQUEST_PUT ? pp_batch[i]->p_data : NULL;
+        pp_batch[i]->p_data = NULL;
+        op_ns[i] = pp_batch[i]->op_n;
+    }
+
+    // Only the shards of the keys are locked (this worker is the only writer of its keys' shards, the locks are for
+    // the readers).
+    tree_shards_write_batch( gp_shards, writes, n );
+
+    if ( n == 1 )
+        printf( "\nThread %d has finished op_n %d", thread_id, op_ns[0] );
+    else
+        printf( "\nThread %d has finished %d requests (op_n %d to %d)", thread_id, n, op_ns[0], op_ns[n - 1] );
+
+    // The requests are done (verify), and if one op was bigger that op_proc->max_proc, max_proc is updated.
+    if ( op_proc_finish( gp_op_proc, thread_id, op_ns, n ) )
+        printf( " and changed the max_proc variable." );
+
+    printf("\n\n");
+
+    __atomic_add_fetch( &g_n_batches, 1, __ATOMIC_RELAXED );
+    __atomic_add_fetch( &g_n_batched_requests, n, __ATOMIC_RELAXED );
+
+    for ( int i = 0; i < n; i++ )
+        request_release( pp_batch[i] );
+}
+
+void *process_request( void *p_params )
+{
+    int thread_id = (int)(intptr_t)p_params;
+    struct request_t *pp_batch[TREE_SKEL_MAX_BATCH];
+
+    while ( g_are_threads_running )
+    {
+        int n = queue_get_next_batch( thread_id, pp_batch );
 
-        // If the request op was bigger that op_proc->max_proc, we need to update the max_proc.
-        if ( p_request->op_n > op_proc_get_max_proc( gp_op_proc ) )
+        // This is only supposed to happen when the server and, consequently, the thread is shutting down. Since in
+        // normal occasions, the thread waits untils there is a request in the queue.
+        if ( n == 0 )
         {
-            printf( " and changed the max_proc variable." );
-            op_proc_set_max_proc( gp_op_proc, p_request->op_n );
+            break;
         }
 
-        printf("\n\n");
+        // Requests with several keys are on every deque: only the last worker to reach it executes it.
+        if ( pp_batch[0]->op == REQUEST_BULK_LOAD || pp_batch[0]->op == REQUEST_PUT_BATCH )
+            process_barrier( thread_id, pp_batch[0] );
+        else
+            process_batch( thread_id, pp_batch, n );
 
-        request_destroy( p_request );
+        queue_batch_done( thread_id );
     }
 
+    // Give the blocks cached by this worker back to the allocator.
+    slab_thread_cache_flush();
+
     return NULL;
 }
 
 int tree_skel_init( int n_threads )
+{
+    return tree_skel_init2( n_threads, TREE_AVL | TREE_HASH_INDEX );
+}
+
+int tree_skel_init2( int n_threads, int type )
+{
+    return tree_skel_init3( n_threads, type, TREE_SKEL_DEFAULT_SHARDS );
+}
+
+int tree_skel_init3( int n_threads, int type, int n_shards )
 {
     // For the sigint handler.
     g_n_threads = n_threads;
 
-    if ( !(gp_TREE = tree_create()))
+    if ( !(gp_shards = tree_shards_create( n_shards, type )))
     {
         fprintf( stderr, "%s : error creating the tree.\n", strerror(errno));
         return -1;
@@ -122,6 +462,37 @@ int tree_skel_init( int n_threads )
 
     int i;
 
+    if ( posix_memalign( (void **)&gp_deques, TREE_SKEL_CACHE_LINE, n_threads * sizeof( struct request_deque_t )))
+    {
+        gp_deques = NULL;
+        fprintf( stderr, "Error allocating memory for the request deques.\n" );
+        tree_skel_destroy();
+        return -1;
+    }
+
+    memset( gp_deques, 0, n_threads * sizeof( struct request_deque_t ));
+
+    for ( i = 0; i < n_threads; i++ )
+    {
+        if ( request_deque_init( &gp_deques[i], TREE_SKEL_QUEUE_CAPACITY ) < 0 )
+        {
+            fprintf( stderr, "Error creating the request deque.\n" );
+            tree_skel_destroy();
+            return -1;
+        }
+    }
+
+    // The shards start spread over the workers.
+    if ( !(gp_shard_owners = (int *) malloc( gp_shards->n_shards * sizeof( int ))))
+    {
+        fprintf( stderr, "%s : error allocating memory for the shard owners.\n", strerror(errno));
+        tree_skel_destroy();
+        return -1;
+    }
+
+    for ( i = 0; i < gp_shards->n_shards; i++ )
+        gp_shard_owners[i] = i % n_threads;
+
     if ( !(gp_threads_ids = (pthread_t *) malloc( n_threads * sizeof( pthread_t ))))
     {
         fprintf( stderr, "%s : error allocating memory for the threads.\n", strerror(errno));
@@ -129,7 +500,8 @@ int tree_skel_init( int n_threads )
         return -1;
     }
 
-    if ( !(gp_op_proc = op_proc_create( n_threads )))
+    // Each queue, plus the request each worker holds and the one imvoke is adding.
+    if ( !(gp_op_proc = op_proc_create( n_threads, (size_t)n_threads * (TREE_SKEL_QUEUE_CAPACITY + 1) + 1 )))
     {
         fprintf( stderr, "Error creating the op_proc struct.\n" );
         tree_skel_destroy();
@@ -137,9 +509,18 @@ int tree_skel_init( int n_threads )
         return -1;
     }
 
+    // The same bound: every request on the table is pending.
+    if ( g_is_coalescing
+         && !(gp_coalesce = coalesce_create( (size_t)n_threads * (TREE_SKEL_QUEUE_CAPACITY + 1) + 1 )))
+    {
+        fprintf( stderr, "Error creating the coalescing table.\n" );
+        tree_skel_destroy();
+        return -1;
+    }
+
     for ( i = 0; i < n_threads; i++ )
     {
-        if ( pthread_create( &gp_threads_ids[i], NULL, process_request, (void *) &i ))
+        if ( pthread_create( &gp_threads_ids[i], NULL, process_request, (void *)(intptr_t)i ))
         {
             fprintf( stderr, "%s : error creating thread.\n", strerror(errno));
             free( gp_threads_ids );
@@ -154,24 +535,70 @@ int tree_skel_init( int n_threads )
 
 void tree_skel_request_queue_threads_destroy( )
 {
-    pthread_mutex_unlock( &g_queue_lock );
-
     // Stop threads from running.
     g_are_threads_running = 0;
 
-    // Unlock stuck threads waiting for non empty queue.
-    pthread_cond_broadcast( &g_queue_not_empty_cond );
+    // Unlock stuck threads waiting for non empty queue. The deques themselves are kept: the detached workers may
+    // still be returning from them.
+    if ( gp_deques )
+    {
+        for ( int i = 0; i < g_n_threads; i++ )
+        {
+            struct request_deque_t *p_deque = &gp_deques[i];
+
+            if ( !p_deque->pp_requests )
+                continue;
+
+            pthread_mutex_lock( &p_deque->lock );
+            p_deque->is_closed = 1;
+            pthread_cond_broadcast( &p_deque->not_empty );
+            pthread_cond_broadcast( &p_deque->not_full );
+            pthread_mutex_unlock( &p_deque->lock );
+        }
+    }
+
+    // And the ones waiting for the others on a request with several keys.
+    pthread_mutex_lock( &g_barrier_lock );
+    pthread_cond_broadcast( &g_barrier_cond );
+    pthread_mutex_unlock( &g_barrier_lock );
+}
+
+void tree_skel_set_coalescing( int is_enabled )
+{
+    g_is_coalescing = is_enabled;
+}
+
+double tree_skel_average_batch_size()
+{
+    unsigned long n_batches = __atomic_load_n( &g_n_batches, __ATOMIC_RELAXED );
+    unsigned long n_requests = __atomic_load_n( &g_n_batched_requests, __ATOMIC_RELAXED );
+
+    return n_batches ? (double)n_requests / (double)n_batches : 0.0;
 }
 
 void tree_skel_destroy()
 {
 
-    tree_destroy( gp_TREE );
+    tree_shards_destroy( gp_shards );
     op_proc_destroy( gp_op_proc );
+
+    printf( "Average write batch: %.2f requests\n", tree_skel_average_batch_size() );
+    printf( "Batches stolen: %lu\n", __atomic_load_n( &g_n_steals, __ATOMIC_RELAXED ));
+
+    // The table itself is kept, like the queues: the detached workers may still be using it.
+    if ( gp_coalesce )
+        printf( "Writes coalesced: %lu\n", gp_coalesce->n_coalesced );
+
+    slab_print_stats( stdout );
 }
 
 
 int imvoke( struct message_t *p_msg )
+{
+    return imvoke2( p_msg, NULL );
+}
+
+int imvoke2( struct message_t *p_msg, struct bulk_load_t *p_bulk_load )
 {
     if ( !p_msg )
     {
@@ -181,7 +608,7 @@ int imvoke( struct message_t *p_msg )
     }
 
     // Tree not initialized.
-    if ( !gp_TREE )
+    if ( !gp_shards )
     {
         errno = ENODATA;
         fprintf( stderr, "%s : tree was not initialized.\n", strerror(errno));
@@ -202,9 +629,7 @@ int imvoke( struct message_t *p_msg )
 
             p_msg->p_MessageT->c_type = CT_RESULT;
 
-            pthread_mutex_lock( &g_tree_lock );
-            p_msg->p_MessageT->result = tree_size( gp_TREE );
-            pthread_mutex_unlock( &g_tree_lock );
+            p_msg->p_MessageT->result = tree_shards_size( gp_shards );
 
             has_succeeded = 1;
             break;
@@ -213,11 +638,7 @@ int imvoke( struct message_t *p_msg )
         {
             p_msg->p_MessageT->c_type = CT_RESULT;
 
-            pthread_mutex_lock( &g_tree_lock );
-            int height = tree_height( gp_TREE );
-            pthread_mutex_unlock( &g_tree_lock );
-
-            p_msg->p_MessageT->result = height;
+            p_msg->p_MessageT->result = tree_shards_height( gp_shards );
 
             has_succeeded = 1;
             break;
@@ -227,7 +648,8 @@ int imvoke( struct message_t *p_msg )
             struct request_t *p_request = request_create(
                     g_last_assignment,
                     REQUEST_DEL,
-                    p_msg->p_MessageT->key,
+                    (char *)p_msg->p_MessageT->key.data,
+                    p_msg->p_MessageT->key.len,
                     NULL );
 
             queue_add_request( p_request );
@@ -244,26 +666,18 @@ int imvoke( struct message_t *p_msg )
         {
             p_msg->p_MessageT->c_type = CT_VALUE;
 
-            pthread_mutex_lock( &g_tree_lock );
-            // Get the value (if NULL, it's not an error).
-            struct data_t *p_data_from_tree = tree_get( gp_TREE, p_msg->p_MessageT->key );
-            pthread_mutex_unlock( &g_tree_lock );
+            // Get the value (if NULL, it's not an error). Big values are shared with the tree, not copied.
+            struct data_t *p_data_from_tree = tree_shards_get2( gp_shards, (char *)p_msg->p_MessageT->key.data,
+                                                                p_msg->p_MessageT->key.len );
 
             ProtobufCBinaryData data_temp;
 
             if ( p_data_from_tree )
             {
+                // The message keeps the reference until it is sent (see message_destroy).
                 data_temp.len = p_data_from_tree->datasize;
-
-                // Copy data to message data.
-                if ( !(data_temp.data = (void *) malloc( sizeof( void ) * data_temp.len )))
-                {
-                    data_destroy( p_data_from_tree );
-                    break;
-                }
-
-                memcpy( data_temp.data, p_data_from_tree->data, data_temp.len );
-                data_destroy( p_data_from_tree );
+                data_temp.data = p_data_from_tree->data;
+                p_msg->p_value_ref = p_data_from_tree;
             }
                 // Key was not found.
             else
@@ -278,16 +692,27 @@ int imvoke( struct message_t *p_msg )
         }
         case OP_PUT:
         {
-            struct data_t* p_data = data_create( (int)p_msg->p_MessageT->entry->data.len );
-            memcpy( p_data->data, p_msg->p_MessageT->entry->data.data, p_data->datasize );
+            MessageT__Entry *p_entry = p_msg->p_MessageT->entry;
+            struct data_t* p_data = data_create2( (int)p_entry->data.len, p_entry->data.data );
 
-            struct request_t *p_request = request_create(
-                    g_last_assignment,
-                    REQUEST_PUT,
-                    p_msg->p_MessageT->entry->key,
-                    p_data );
+            if ( !p_data )
+                break;
+
+            // The buffers unpacked from the message move to the request, and from it to the tree (tree_put_take),
+            // so the value is never copied: detach them so message_destroy doesn't free them.
+            char *p_key = (char *)p_entry->key.data;
+            size_t keysize = p_entry->key.len;
+
+            p_entry->data.data = NULL;
+            p_entry->data.len = 0;
+            p_entry->key.data = NULL;
+            p_entry->key.len = 0;
+
+            struct request_t *p_request = request_create_take( g_last_assignment, REQUEST_PUT, p_key, keysize, p_data );
+
+            if ( !p_request )
+                break;
 
-            data_destroy( p_data );
             queue_add_request( p_request );
 
             p_msg->p_MessageT->c_type = CT_RESULT;
@@ -299,22 +724,22 @@ int imvoke( struct message_t *p_msg )
         }
         case OP_GETKEYS:
         {
-            p_msg->p_MessageT->c_type = CT_KEYS;
+            struct keys_result_t keys_result = { 0, 0, NULL };
 
-            pthread_mutex_lock( &g_tree_lock );
-            int num_keys = tree_size( gp_TREE );
-            char **pp_keys_temp = tree_get_keys( gp_TREE );
-            pthread_mutex_unlock( &g_tree_lock );
+            // The shards are merged in key order.
+            int num_keys = tree_shards_page( gp_shards, 0, 0, keys_append_key, &keys_result );
 
-            p_msg->p_MessageT->n_keys = num_keys;
-            p_msg->p_MessageT->keys = malloc( sizeof( char * ) * num_keys );
+            // Keys are handed to the message (freed with message_t__free_unpacked).
+            p_msg->p_MessageT->n_keys = keys_result.n_keys;
+            p_msg->p_MessageT->keys = keys_result.p_keys;
 
-            for ( int i = 0; i < num_keys; i++ )
+            if ( num_keys < 0 || (size_t)num_keys != keys_result.n_keys )
             {
-                p_msg->p_MessageT->keys[i] = pp_keys_temp[i];
+                break;
             }
 
-            free( pp_keys_temp );
+            p_msg->p_MessageT->c_type = CT_KEYS;
+
             has_succeeded = 1;
             break;
         }
@@ -322,10 +747,16 @@ int imvoke( struct message_t *p_msg )
         {
             p_msg->p_MessageT->c_type = CT_VALUES;
 
-            pthread_mutex_lock( &g_tree_lock );
-            int num_values = tree_size( gp_TREE );
-            void **pp_values_temp = tree_get_values( gp_TREE );
-            pthread_mutex_unlock( &g_tree_lock );
+            void **pp_values_temp = tree_shards_get_values( gp_shards );
+
+            if ( !pp_values_temp )
+            {
+                break;
+            }
+
+            int num_values = 0;
+            while ( pp_values_temp[num_values] )
+                num_values++;
 
             p_msg->p_MessageT->n_datas = num_values;
             p_msg->p_MessageT->datas = malloc( sizeof( ProtobufCBinaryData ) * num_values );
@@ -346,112 +777,867 @@ int imvoke( struct message_t *p_msg )
             has_succeeded = 1;
             break;
         }
-        case OP_VERIFY:
+        case OP_GETKEYAT:
         {
-            int op_n = (int)p_msg->p_MessageT->result;
+            struct keys_result_t keys_result = { 0, 0, NULL };
 
-            // Operation number was not assigned.
-            if ( op_n < 1 || op_n >= g_last_assignment )
+            int num_keys = tree_shards_page( gp_shards, p_msg->p_MessageT->result, 1, keys_append_key, &keys_result );
+
+            // Index out of bounds.
+            if ( num_keys != 1 || keys_result.n_keys != 1 )
             {
+                for ( size_t i = 0; i < keys_result.n_keys; i++ )
+                    free( keys_result.p_keys[i].data );
+
+                free( keys_result.p_keys );
                 break;
             }
 
+            p_msg->p_MessageT->c_type = CT_KEY;
 
-            p_msg->p_MessageT->c_type = CT_RESULT;
-            p_msg->p_MessageT->result = verify( op_n );
-            g_last_assignment++;
+            // Replace the unpacked key (NULL if it was not sent).
+            free( p_msg->p_MessageT->key.data );
+
+            p_msg->p_MessageT->key = keys_result.p_keys[0];
+            free( keys_result.p_keys );
 
             has_succeeded = 1;
             break;
         }
-        default:
-            break;
-    }
+        case OP_GETRANK:
+        {
+            p_msg->p_MessageT->c_type = CT_RESULT;
 
-    // Change opcode according to the success flag
-    p_msg->p_MessageT->opcode = has_succeeded ? ++(p_msg->p_MessageT->opcode) : OP_ERROR;
+            char *p_key = message_key_dup( &p_msg->p_MessageT->key );
 
-    return 0;
-}
+            if ( !p_key )
+            {
+                break;
+            }
 
-int verify(int op_n) {
-    if ( op_n >= g_last_assignment )
-        return -1;
+            p_msg->p_MessageT->result = tree_shards_get_rank2( gp_shards, p_key, p_msg->p_MessageT->key.len );
 
-    int result = -1;
-    if ( op_n <= op_proc_get_max_proc( gp_op_proc ) )
-    {
-        // Check if operation is still in progress.
-        pthread_mutex_lock( &g_op_proc_lock );
-        for ( int i = 0; i < gp_op_proc->in_progress_size; i++ )
+            free( p_key );
+
+            has_succeeded = 1;
+            break;
+        }
+        case OP_GETKEYSPAGE:
         {
-            if ( gp_op_proc->p_in_progress[i] == op_n )
+            struct keys_result_t keys_result = { 0, 0, NULL };
+            int num_keys = 0;
+
+            // A page with limit 0 is empty (tree_shards_page would not limit it).
+            if ( p_msg->p_MessageT->limit > 0 )
+                num_keys = tree_shards_page( gp_shards, p_msg->p_MessageT->offset, (int)p_msg->p_MessageT->limit,
+                                             keys_append_key, &keys_result );
+
+            // Keys are handed to the message (freed with message_t__free_unpacked).
+            p_msg->p_MessageT->n_keys = keys_result.n_keys;
+            p_msg->p_MessageT->keys = keys_result.p_keys;
+
+            if ( num_keys < 0 || (size_t)num_keys != keys_result.n_keys )
             {
                 break;
             }
+
+            p_msg->p_MessageT->c_type = CT_KEYS;
+
+            has_succeeded = 1;
+            break;
         }
-        pthread_mutex_unlock( &g_op_proc_lock );
+        case OP_SCAN:
+        {
+            struct scan_result_t scan_result = { 0, 0, NULL };
 
-        result = 0;
-    }
+            // Empty keys (proto3 default) mean an unbounded range.
+            ProtobufCBinaryData *p_start_key = &p_msg->p_MessageT->key;
+            ProtobufCBinaryData *p_end_key = &p_msg->p_MessageT->end_key;
 
-    return result;
-}
+            int num_entries = tree_shards_scan2( gp_shards, p_start_key->len ? (char *)p_start_key->data : NULL,
+                                                 p_start_key->len, p_end_key->len ? (char *)p_end_key->data : NULL,
+                                                 p_end_key->len, (int)p_msg->p_MessageT->limit, scan_append_entry,
+                                                 &scan_result );
 
-void queue_add_request( struct request_t *p_request )
-{
-    pthread_mutex_lock( &g_queue_lock );
+            // Entries are handed to the message (freed with message_t__free_unpacked).
+            p_msg->p_MessageT->n_entries = scan_result.n_entries;
+            p_msg->p_MessageT->entries = scan_result.pp_entries;
 
-    // Head is new request if queue is empty.
-    if ( !gp_queue_head )
-    {
-        gp_queue_head = p_request;
-        p_request->p_next = NULL;
+            if ( num_entries < 0 || (size_t)num_entries != scan_result.n_entries )
+            {
+                break;
+            }
+
+            p_msg->p_MessageT->c_type = CT_ENTRIES;
+
+            has_succeeded = 1;
+            break;
+        }
+        case OP_SCANPREFIX:
+        {
+            struct scan_result_t scan_result = { 0, 0, NULL };
+
+            char *p_prefix = message_key_dup( &p_msg->p_MessageT->key );
+
+            if ( !p_prefix )
+            {
+                break;
+            }
+
+            int num_entries = tree_shards_scan_prefix2( gp_shards, p_prefix, p_msg->p_MessageT->key.len,
+                                                        (int)p_msg->p_MessageT->limit, scan_append_entry,
+                                                        &scan_result );
+
+            free( p_prefix );
+
+            // Entries are handed to the message (freed with message_t__free_unpacked).
+            p_msg->p_MessageT->n_entries = scan_result.n_entries;
+            p_msg->p_MessageT->entries = scan_result.pp_entries;
+
+            if ( num_entries < 0 || (size_t)num_entries != scan_result.n_entries )
+            {
+                break;
+            }
+
+            p_msg->p_MessageT->c_type = CT_ENTRIES;
+
+            has_succeeded = 1;
+            break;
+        }
+        case OP_BULKLOAD:
+        {
+            // Without a connection's session the whole load must come in one message.
+            struct bulk_load_t single_load = { 0, 0, NULL };
+
+            if ( !p_bulk_load )
+            {
+                if ( !p_msg->p_MessageT->result )
+                {
+                    fprintf( stderr, "A bulk load in chunks needs the session of a connection.\n" );
+                    break;
+                }
+
+                p_bulk_load = &single_load;
+            }
+
+            // Chunks are collected until the last one (result != 0), which queues the whole load as one write.
+            if ( bulk_load_append( p_bulk_load, p_msg->p_MessageT ) < 0 )
+            {
+                break;
+            }
+
+            p_msg->p_MessageT->c_type = CT_RESULT;
+
+            if ( !p_msg->p_MessageT->result )
+            {
+                p_msg->p_MessageT->result = p_bulk_load->n_entries;
+
+                has_succeeded = 1;
+                break;
+            }
+
+            struct request_t *p_request = request_create_entries( g_last_assignment, REQUEST_BULK_LOAD,
+                                                                  p_bulk_load->pp_entries, p_bulk_load->n_entries );
+            p_bulk_load->pp_entries = NULL;
+            p_bulk_load->n_entries = 0;
+            p_bulk_load->capacity = 0;
+
+            if ( !p_request )
+            {
+                break;
+            }
+
+            queue_add_request( p_request );
+
+            p_msg->p_MessageT->result = g_last_assignment;
+            g_last_assignment++;
+
+            has_succeeded = 1;
+            break;
+        }
+        case OP_PUTBATCH:
+        {
+            // The whole batch is one write: one op_n, and the worker takes each shard's lock once for it.
+            size_t n_entries;
+            struct entry_t **pp_entries = message_entries_take( p_msg->p_MessageT, &n_entries );
+
+            if ( !pp_entries )
+            {
+                break;
+            }
+
+            struct request_t *p_request = request_create_entries( g_last_assignment, REQUEST_PUT_BATCH, pp_entries,
+                                                                  n_entries );
+
+            if ( !p_request )
+            {
+                break;
+            }
+
+            queue_add_request( p_request );
+
+            p_msg->p_MessageT->c_type = CT_RESULT;
+            p_msg->p_MessageT->result = g_last_assignment;
+            g_last_assignment++;
+
+            has_succeeded = 1;
+            break;
+        }
+        case OP_VERIFY:
+        {
+            int op_n = (int)p_msg->p_MessageT->result;
+
+            // Operation number was not assigned.
+            if ( op_n < 1 || op_n >= g_last_assignment )
+            {
+                break;
+            }
+
+
+            p_msg->p_MessageT->c_type = CT_RESULT;
+            p_msg->p_MessageT->result = verify( op_n );
+            g_last_assignment++;
+
+            has_succeeded = 1;
+            break;
+        }
+        default:
+            break;
     }
-        // Add request to the end of the queue.
-    else
+
+    // Change opcode according to the success flag
+    p_msg->p_MessageT->opcode = has_succeeded ? ++(p_msg->p_MessageT->opcode) : OP_ERROR;
+
+    return 0;
+}
+
+int verify(int op_n) {
+    if ( op_n >= g_last_assignment )
+        return -1;
+
+    // Queued or still in progress. Operations are marked pending before they get their op_n out of imvoke.
+    if ( op_proc_is_pending( gp_op_proc, op_n ))
+        return -1;
+
+    // Done, but rejected.
+    return op_proc_has_failed( gp_op_proc, op_n ) ? -2 : 0;
+}
+
+int scan_append_entry( struct entry_t *p_entry, void *p_scan_result )
+{
+    struct scan_result_t *p_result = (struct scan_result_t *) p_scan_result;
+
+    // Grow the array when full.
+    if ( p_result->n_entries == p_result->capacity )
     {
-        struct request_t *p_request_itr = gp_queue_head;
-        while ( p_request_itr->p_next )
+        size_t new_capacity = p_result->capacity ? p_result->capacity * 2 : 16;
+        MessageT__Entry **pp_entries;
+
+        if ( !(pp_entries = (MessageT__Entry **) realloc( p_result->pp_entries,
+                                                          sizeof( MessageT__Entry * ) * new_capacity )))
+            return -1;
+
+        p_result->pp_entries = pp_entries;
+        p_result->capacity = new_capacity;
+    }
+
+    MessageT__Entry *p_msg_entry;
+    if ( !(p_msg_entry = (MessageT__Entry *) malloc( sizeof( MessageT__Entry ))))
+        return -1;
+
+    message_t__entry__init( p_msg_entry );
+
+    p_msg_entry->key.len = p_entry->keysize;
+    p_msg_entry->data.len = p_entry->value->datasize;
+
+    if ( !(p_msg_entry->key.data = (uint8_t *) malloc( p_msg_entry->key.len + 1 )))
+    {
+        free( p_msg_entry );
+        return -1;
+    }
+
+    if ( !(p_msg_entry->data.data = (uint8_t *) malloc( p_msg_entry->data.len )))
+    {
+        free( p_msg_entry->key.data );
+        free( p_msg_entry );
+        return -1;
+    }
+
+    // The extra '\0' is not sent; it only keeps text keys printable.
+    memcpy( p_msg_entry->key.data, p_entry->key, p_msg_entry->key.len );
+    p_msg_entry->key.data[p_msg_entry->key.len] = '\0';
+    memcpy( p_msg_entry->data.data, p_entry->value->data, p_msg_entry->data.len );
+
+    p_result->pp_entries[p_result->n_entries++] = p_msg_entry;
+
+    return 0;
+}
+
+int keys_append_key( struct entry_t *p_entry, void *p_keys_result )
+{
+    struct keys_result_t *p_result = (struct keys_result_t *) p_keys_result;
+
+    // Grow the array when full.
+    if ( p_result->n_keys == p_result->capacity )
+    {
+        size_t new_capacity = p_result->capacity ? p_result->capacity * 2 : 16;
+        ProtobufCBinaryData *p_keys;
+
+        if ( !(p_keys = (ProtobufCBinaryData *) realloc( p_result->p_keys, sizeof( ProtobufCBinaryData ) * new_capacity )))
+            return -1;
+
+        p_result->p_keys = p_keys;
+        p_result->capacity = new_capacity;
+    }
+
+    ProtobufCBinaryData *p_key = &p_result->p_keys[p_result->n_keys];
+
+    if ( !(p_key->data = (uint8_t *) malloc( p_entry->keysize + 1 )))
+        return -1;
+
+    // The extra '\0' is not sent; it only keeps text keys printable.
+    memcpy( p_key->data, p_entry->key, p_entry->keysize );
+    p_key->data[p_entry->keysize] = '\0';
+    p_key->len = p_entry->keysize;
+
+    p_result->n_keys++;
+
+    return 0;
+}
+
+struct entry_t *message_entry_take( MessageT__Entry *p_msg_entry )
+{
+    // Empty keys may come without a buffer.
+    char *p_key = p_msg_entry->key.data ? (char *)p_msg_entry->key.data : (char *) calloc( 1, 1 );
+    struct data_t *p_data = p_key ? data_create2( (int)p_msg_entry->data.len, p_msg_entry->data.data ) : NULL;
+    struct entry_t *p_entry = p_data ? entry_create2( p_key, p_msg_entry->key.len, p_data ) : NULL;
+
+    if ( !p_entry )
+    {
+        // Buffers not taken stay with the message.
+        if ( p_key != (char *)p_msg_entry->key.data )
+            free( p_key );
+
+        if ( p_data )
         {
-            p_request_itr = p_request_itr->p_next;
+            p_data->data = NULL;
+            data_destroy( p_data );
         }
 
-        p_request_itr->p_next = p_request;
-        p_request->p_next = NULL;
+        return NULL;
     }
 
-    pthread_cond_signal( &g_queue_not_empty_cond );
-    pthread_mutex_unlock( &g_queue_lock );
+    p_msg_entry->key.data = NULL;
+    p_msg_entry->key.len = 0;
+    p_msg_entry->data.data = NULL;
+    p_msg_entry->data.len = 0;
+
+    return p_entry;
 }
 
-struct request_t *queue_get_next_request()
+struct entry_t **message_entries_take( MessageT *p_MessageT, size_t *p_n_entries )
 {
-    pthread_mutex_lock( &g_queue_lock );
+    size_t n_entries = p_MessageT->n_entries;
+    struct entry_t **pp_entries = NULL;
 
-    // Wait until queue is not empty.
-    while ( !gp_queue_head )
+    if ( (pp_entries = (struct entry_t **) malloc( sizeof( struct entry_t * ) * (n_entries ? n_entries : 1) )))
     {
-        pthread_cond_wait( &g_queue_not_empty_cond, &g_queue_lock );
+        for ( size_t i = 0; i < n_entries; i++ )
+        {
+            if ( !(pp_entries[i] = message_entry_take( p_MessageT->entries[i] )))
+            {
+                while ( i-- > 0 )
+                    entry_destroy( pp_entries[i] );
+
+                free( pp_entries );
+                pp_entries = NULL;
+                break;
+            }
+        }
     }
 
-    struct request_t *p_request = gp_queue_head;
-    gp_queue_head = gp_queue_head->p_next;
+    // The entries aren't sent back on the response.
+    for ( size_t i = 0; i < n_entries; i++ )
+        protobuf_c_message_free_unpacked( &p_MessageT->entries[i]->base, NULL );
 
-    pthread_mutex_unlock( &g_queue_lock );
+    p_MessageT->n_entries = 0;
+    *p_n_entries = n_entries;
 
-    return p_request;
+    return pp_entries;
+}
+
+int bulk_load_append( struct bulk_load_t *p_bulk_load, MessageT *p_MessageT )
+{
+    size_t n_chunk_entries;
+    struct entry_t **pp_chunk_entries = message_entries_take( p_MessageT, &n_chunk_entries );
+
+    if ( !pp_chunk_entries )
+    {
+        bulk_load_clear( p_bulk_load );
+        return -1;
+    }
+
+    int result = 0;
+    size_t n_entries = p_bulk_load->n_entries + n_chunk_entries;
+
+    if ( n_entries > p_bulk_load->capacity )
+    {
+        size_t new_capacity = p_bulk_load->capacity ? p_bulk_load->capacity : 1024;
+        struct entry_t **pp_entries;
+
+        while ( new_capacity < n_entries )
+            new_capacity *= 2;
+
+        if ( (pp_entries = (struct entry_t **) realloc( p_bulk_load->pp_entries,
+                                                       sizeof( struct entry_t * ) * new_capacity )))
+        {
+            p_bulk_load->pp_entries = pp_entries;
+            p_bulk_load->capacity = new_capacity;
+        }
+        else
+            result = -1;
+    }
+
+    for ( size_t i = 0; i < n_chunk_entries; i++ )
+    {
+        struct entry_t *p_entry = pp_chunk_entries[i];
+
+        if ( result < 0 || (p_bulk_load->n_entries > 0 &&
+             entry_key_compare( p_bulk_load->pp_entries[p_bulk_load->n_entries - 1], p_entry ) >= 0) )
+        {
+            result = -1;
+            entry_destroy( p_entry );
+            continue;
+        }
+
+        p_bulk_load->pp_entries[p_bulk_load->n_entries++] = p_entry;
+    }
+
+    free( pp_chunk_entries );
+
+    if ( result < 0 )
+        bulk_load_clear( p_bulk_load );
+
+    return result;
+}
+
+void bulk_load_clear( struct bulk_load_t *p_bulk_load )
+{
+    for ( size_t i = 0; i < p_bulk_load->n_entries; i++ )
+        entry_destroy( p_bulk_load->pp_entries[i] );
+
+    free( p_bulk_load->pp_entries );
+
+    p_bulk_load->pp_entries = NULL;
+    p_bulk_load->n_entries = 0;
+    p_bulk_load->capacity = 0;
+}
+
+void request_release( struct request_t *p_request )
+{
+    if ( __atomic_sub_fetch( &p_request->n_references, 1, __ATOMIC_ACQ_REL ) == 0 )
+        request_destroy( p_request );
+}
+
+int queue_worker_of( int shard )
+{
+    return __atomic_load_n( &gp_shard_owners[shard], __ATOMIC_RELAXED );
+}
+
+/*
+ * Wakes up an idle worker to steal from a busy one (see TREE_SKEL_STEAL_THRESHOLD).
+ */
+static void queue_wake_thief( int busy_worker )
+{
+    for ( int i = 0; i < g_n_threads; i++ )
+    {
+        struct request_deque_t *p_deque = &gp_deques[i];
+
+        if ( i == busy_worker || !__atomic_load_n( &p_deque->is_idle, __ATOMIC_RELAXED ) )
+            continue;
+
+        pthread_mutex_lock( &p_deque->lock );
+        p_deque->is_woken = 1;
+        pthread_cond_signal( &p_deque->not_empty );
+        pthread_mutex_unlock( &p_deque->lock );
+
+        return;
+    }
+}
+
+/*
+ * Adds a request to the back of a deque, waiting while it is full.
+ *
+ * Parameters:
+ *      shard: for the writes of one key, the shard the worker must still own (-1 for the other requests).
+ *
+ * Returns:
+ *      0 (ok), 1 if the shard was stolen from the worker (the request isn't added) or -1 if the deque was closed.
+ */
+static int request_deque_push( struct request_deque_t *p_deque, int worker, struct request_t *p_request, int shard )
+{
+    pthread_mutex_lock( &p_deque->lock );
+
+    while ( !p_deque->is_closed && (shard < 0 || queue_worker_of( shard ) == worker)
+            && p_deque->n_requests > p_deque->mask )
+        pthread_cond_wait( &p_deque->not_full, &p_deque->lock );
+
+    if ( p_deque->is_closed || (shard >= 0 && queue_worker_of( shard ) != worker) )
+    {
+        pthread_mutex_unlock( &p_deque->lock );
+        return p_deque->is_closed ? -1 : 1;
+    }
+
+    p_deque->pp_requests[(p_deque->head + p_deque->n_requests) & p_deque->mask] = p_request;
+
+    size_t n_requests = p_deque->n_requests + 1;
+
+    __atomic_store_n( &p_deque->n_requests, n_requests, __ATOMIC_RELAXED );
+
+    pthread_cond_signal( &p_deque->not_empty );
+    pthread_mutex_unlock( &p_deque->lock );
+
+    if ( n_requests % TREE_SKEL_STEAL_THRESHOLD == 0 )
+        queue_wake_thief( worker );
+
+    return 0;
 }
 
-struct request_t *request_create( int op_n, int op, char *p_key, struct data_t *p_data )
+/*
+ * Shard a thief can take from a deque: the shard of the newest request that can move (see struct request_deque_t).
+ * Called with the deque's lock.
+ *
+ * Parameters:
+ *      p_end: set to the position of the first request with several keys (or n_requests): the shard's requests are
+ *             all before it.
+ *
+ * Returns:
+ *      The shard; -1 if there is none.
+ */
+static int queue_steal_shard( struct request_deque_t *p_deque, size_t *p_end )
+{
+    uint64_t blocked = p_deque->busy_shards;
+    size_t end = p_deque->n_requests;
+
+    for ( size_t i = 0; i < p_deque->n_requests; i++ )
+    {
+        struct request_t *p_request = p_deque->pp_requests[(p_deque->head + i) & p_deque->mask];
+
+        // The requests behind a request with several keys must run after it.
+        if ( p_request->shard < 0 )
+        {
+            if ( end == p_deque->n_requests )
+                end = i;
+        } else if ( i > end )
+        {
+            blocked |= (uint64_t)1 << p_request->shard;
+        }
+    }
+
+    *p_end = end;
+
+    for ( size_t i = end; i-- > 0; )
+    {
+        int shard = p_deque->pp_requests[(p_deque->head + i) & p_deque->mask]->shard;
+
+        if ( !(blocked & ((uint64_t)1 << shard)) )
+            return shard;
+    }
+
+    return -1;
+}
+
+/*
+ * Steals the requests of one shard, and the shard, from the busiest worker: they go to the front of the thief's deque
+ * (they are older than anything there).
+ *
+ * Returns:
+ *      1 if something was stolen, 0 otherwise.
+ */
+static int queue_steal( int thief )
+{
+    int victim = -1;
+    size_t most = 1;
+
+    for ( int i = 0; i < g_n_threads; i++ )
+    {
+        size_t n_requests = __atomic_load_n( &gp_deques[i].n_requests, __ATOMIC_RELAXED );
+
+        if ( i != thief && n_requests > most )
+        {
+            victim = i;
+            most = n_requests;
+        }
+    }
+
+    if ( victim < 0 )
+        return 0;
+
+    struct request_deque_t *p_from = &gp_deques[victim];
+    struct request_deque_t *p_to = &gp_deques[thief];
+
+    // Like every lock of several deques, in index order.
+    pthread_mutex_lock( &gp_deques[victim < thief ? victim : thief].lock );
+    pthread_mutex_lock( &gp_deques[victim < thief ? thief : victim].lock );
+
+    size_t end;
+    int shard = queue_steal_shard( p_from, &end );
+    size_t n_stolen = 0;
+
+    for ( size_t i = 0; shard >= 0 && i < end; i++ )
+    {
+        if ( p_from->pp_requests[(p_from->head + i) & p_from->mask]->shard == shard )
+            n_stolen++;
+    }
+
+    if ( n_stolen > 0 && n_stolen <= p_to->mask + 1 - p_to->n_requests )
+    {
+        size_t n_kept = 0;
+
+        // The front of the thief's deque gets the shard's requests, in their order.
+        p_to->head = (p_to->head - n_stolen) & p_to->mask;
+
+        for ( size_t i = 0, j = 0; i < p_from->n_requests; i++ )
+        {
+            struct request_t *p_request = p_from->pp_requests[(p_from->head + i) & p_from->mask];
+
+            if ( i < end && p_request->shard == shard )
+                p_to->pp_requests[(p_to->head + j++) & p_to->mask] = p_request;
+            else
+                p_from->pp_requests[(p_from->head + n_kept++) & p_from->mask] = p_request;
+        }
+
+        __atomic_store_n( &p_from->n_requests, n_kept, __ATOMIC_RELAXED );
+        __atomic_store_n( &p_to->n_requests, p_to->n_requests + n_stolen, __ATOMIC_RELAXED );
+
+        // imvoke rechecks the owner under the deque's lock, so it can't add a write of the shard to the old owner.
+        __atomic_store_n( &gp_shard_owners[shard], thief, __ATOMIC_RELAXED );
+
+        pthread_cond_broadcast( &p_from->not_full );
+        __atomic_add_fetch( &g_n_steals, 1, __ATOMIC_RELAXED );
+    } else
+    {
+        n_stolen = 0;
+    }
+
+    pthread_mutex_unlock( &gp_deques[victim < thief ? thief : victim].lock );
+    pthread_mutex_unlock( &gp_deques[victim < thief ? victim : thief].lock );
+
+    return n_stolen > 0;
+}
+
+void queue_add_request( struct request_t *p_request )
+{
+    op_proc_add_pending( gp_op_proc, p_request->op_n );
+
+    if ( p_request->op == REQUEST_PUT || p_request->op == REQUEST_DEL )
+    {
+        int result;
+
+        p_request->shard = tree_shards_index( gp_shards, p_request->p_key, p_request->keysize );
+
+        // Before it is queued, so its worker always finds it on the table.
+        if ( gp_coalesce )
+            coalesce_add( gp_coalesce, p_request );
+
+        // Waits while the deque is full; again on the new owner if the shard was stolen meanwhile. A closed deque
+        // (server shutting down) won't run it anymore.
+        do
+        {
+            int worker = queue_worker_of( p_request->shard );
+
+            result = request_deque_push( &gp_deques[worker], worker, p_request, p_request->shard );
+        } while ( result > 0 );
+
+        if ( result < 0 )
+        {
+            if ( gp_coalesce )
+                coalesce_take( gp_coalesce, p_request );
+
+            op_proc_set_done( gp_op_proc, p_request->op_n );
+            request_release( p_request );
+        }
+
+        return;
+    }
+
+    // One reference per deque, set before any worker can take it.
+    p_request->n_references = g_n_threads;
+    p_request->n_arrivals = g_n_threads;
+
+    for ( int i = 0; i < g_n_threads; i++ )
+    {
+        if ( request_deque_push( &gp_deques[i], i, p_request, -1 ) < 0 )
+        {
+            op_proc_set_done( gp_op_proc, p_request->op_n );
+
+            // The references of the deques it didn't get to.
+            for ( ; i < g_n_threads; i++ )
+                request_release( p_request );
+
+            return;
+        }
+    }
+}
+
+int queue_get_next_batch( int worker, struct request_t **pp_batch )
+{
+    struct request_deque_t *p_deque = &gp_deques[worker];
+    int n = 0;
+
+    pthread_mutex_lock( &p_deque->lock );
+
+    while ( !p_deque->n_requests && !p_deque->is_closed )
+    {
+        // Nothing to do: look for work on the busy workers before sleeping.
+        __atomic_store_n( &p_deque->is_idle, 1, __ATOMIC_RELAXED );
+        pthread_mutex_unlock( &p_deque->lock );
+
+        int has_stolen = queue_steal( worker );
+
+        pthread_mutex_lock( &p_deque->lock );
+
+        if ( !has_stolen && !p_deque->n_requests && !p_deque->is_closed && !p_deque->is_woken )
+            pthread_cond_wait( &p_deque->not_empty, &p_deque->lock );
+
+        p_deque->is_woken = 0;
+    }
+
+    __atomic_store_n( &p_deque->is_idle, 0, __ATOMIC_RELAXED );
+
+    if ( p_deque->is_closed )
+    {
+        pthread_mutex_unlock( &p_deque->lock );
+        return 0;
+    }
+
+    // As many as are queued now: the batch grows with the backlog, but a steady stream of writes doesn't hold it.
+    size_t limit = p_deque->n_requests < TREE_SKEL_MAX_BATCH ? p_deque->n_requests : TREE_SKEL_MAX_BATCH;
+    struct request_t *p_request = p_deque->pp_requests[p_deque->head];
+
+    // A request with several keys goes alone, and no shard can be stolen until it is done.
+    if ( p_request->shard < 0 )
+    {
+        pp_batch[n++] = p_request;
+        p_deque->head = (p_deque->head + 1) & p_deque->mask;
+        p_deque->busy_shards = ~(uint64_t)0;
+    } else
+    {
+        p_deque->busy_shards = 0;
+
+        while ( (size_t)n < limit && (p_request = p_deque->pp_requests[p_deque->head])->shard >= 0 )
+        {
+            pp_batch[n++] = p_request;
+            p_deque->head = (p_deque->head + 1) & p_deque->mask;
+            p_deque->busy_shards |= (uint64_t)1 << p_request->shard;
+        }
+    }
+
+    __atomic_store_n( &p_deque->n_requests, p_deque->n_requests - n, __ATOMIC_RELAXED );
+
+    pthread_cond_signal( &p_deque->not_full );
+    pthread_mutex_unlock( &p_deque->lock );
+
+    return n;
+}
+
+void queue_batch_done( int worker )
+{
+    struct request_deque_t *p_deque = &gp_deques[worker];
+
+    pthread_mutex_lock( &p_deque->lock );
+    p_deque->busy_shards = 0;
+    pthread_mutex_unlock( &p_deque->lock );
+}
+
+struct request_t *request_create( int op_n, int op, char *p_key, size_t keysize, struct data_t *p_data )
 {
     struct request_t *p_request = (struct request_t *) malloc( sizeof( struct request_t ));
 
     p_request->op_n = op_n;
     p_request->op = op;
-    p_request->p_key = strdup( p_key );
+    p_request->keysize = keysize;
+
+    // Keys can be binary: copy keysize bytes (and terminate the copy).
+    if ( (p_request->p_key = (char *) malloc( keysize + 1 )))
+    {
+        if ( keysize )
+            memcpy( p_request->p_key, p_key, keysize );
+
+        p_request->p_key[keysize] = '\0';
+    }
+
     p_request->p_data = data_dup( p_data );
-    p_request->p_next = NULL;
+    p_request->pp_entries = NULL;
+    p_request->n_entries = 0;
+    p_request->n_references = 1;
+    p_request->n_arrivals = 1;
+    p_request->is_done = 0;
+    p_request->is_superseded = 0;
+    p_request->shard = -1;
+
+    return p_request;
+}
+
+struct request_t *request_create_take( int op_n, int op, char *p_key, size_t keysize, struct data_t *p_data )
+{
+    struct request_t *p_request = NULL;
+
+    // Empty keys may come without a buffer.
+    if ( !p_key && !(p_key = (char *) calloc( 1, 1 )) )
+    {
+        data_destroy( p_data );
+        return NULL;
+    }
+
+    if ( !(p_request = (struct request_t *) malloc( sizeof( struct request_t ))) )
+    {
+        free( p_key );
+        data_destroy( p_data );
+        return NULL;
+    }
+
+    p_request->op_n = op_n;
+    p_request->op = op;
+    p_request->p_key = p_key;
+    p_request->keysize = keysize;
+    p_request->p_data = p_data;
+    p_request->pp_entries = NULL;
+    p_request->n_entries = 0;
+    p_request->n_references = 1;
+    p_request->n_arrivals = 1;
+    p_request->is_done = 0;
+    p_request->is_superseded = 0;
+    p_request->shard = -1;
+
+    return p_request;
+}
+
+struct request_t *request_create_entries( int op_n, int op, struct entry_t **pp_entries, size_t n_entries )
+{
+    struct request_t *p_request = NULL;
+
+    if ( !(p_request = (struct request_t *) malloc( sizeof( struct request_t ))) )
+    {
+        for ( size_t i = 0; i < n_entries; i++ )
+            entry_destroy( pp_entries[i] );
+
+        free( pp_entries );
+        return NULL;
+    }
+
+    p_request->op_n = op_n;
+    p_request->op = op;
+    p_request->p_key = NULL;
+    p_request->keysize = 0;
+    p_request->p_data = NULL;
+    p_request->pp_entries = pp_entries;
+    p_request->n_entries = n_entries;
+    p_request->n_references = 1;
+    p_request->n_arrivals = 1;
+    p_request->is_done = 0;
+    p_request->is_superseded = 0;
+    p_request->shard = -1;
 
     return p_request;
 }
@@ -460,26 +1646,202 @@ void request_destroy( struct request_t *p_request )
 {
     free( p_request->p_key );
     data_destroy( p_request->p_data );
+
+    for ( size_t i = 0; i < p_request->n_entries; i++ )
+        entry_destroy( p_request->pp_entries[i] );
+
+    free( p_request->pp_entries );
     free( p_request );
 }
 
-struct op_proc *op_proc_create( int in_progress_size )
+struct op_proc *op_proc_create( int in_progress_size, size_t max_pending )
 {
     struct op_proc *p_op_proc = (struct op_proc *) malloc( sizeof( struct op_proc ));
 
+    if ( !p_op_proc )
+        return NULL;
+
     p_op_proc->max_proc = 0;
     p_op_proc->in_progress_size = in_progress_size;
     p_op_proc->p_in_progress = (int *) calloc( sizeof( int ),  in_progress_size );
 
+    // At most half full, so the probes stay short.
+    p_op_proc->pending_capacity = 2;
+
+    while ( p_op_proc->pending_capacity < 2 * max_pending )
+        p_op_proc->pending_capacity *= 2;
+
+    p_op_proc->n_pending = 0;
+    p_op_proc->p_pending = (int *) calloc( sizeof( int ), p_op_proc->pending_capacity );
+    p_op_proc->n_failed = 0;
+
+    if ( !p_op_proc->p_in_progress || !p_op_proc->p_pending )
+    {
+        op_proc_destroy( p_op_proc );
+        return NULL;
+    }
+
     return p_op_proc;
 }
 
 void op_proc_destroy( struct op_proc *p_op_proc )
 {
+    if ( !p_op_proc )
+        return;
+
     free( p_op_proc->p_in_progress );
+    free( p_op_proc->p_pending );
     free( p_op_proc );
 }
 
+/*
+ * Slot of p_pending where the probe for an op_n starts (op_n are consecutive: spread them with a multiplicative hash).
+ */
+static size_t op_proc_home( struct op_proc *p_op_proc, int op_n )
+{
+    return ((size_t)((unsigned int)op_n * 2654435761u)) & (p_op_proc->pending_capacity - 1);
+}
+
+/*
+ * Slot of p_pending with an op_n, or the empty slot where it would be. Called with g_op_proc_lock.
+ */
+static size_t op_proc_find( struct op_proc *p_op_proc, int op_n )
+{
+    size_t mask = p_op_proc->pending_capacity - 1;
+    size_t slot = op_proc_home( p_op_proc, op_n );
+
+    while ( p_op_proc->p_pending[slot] && p_op_proc->p_pending[slot] != op_n )
+        slot = (slot + 1) & mask;
+
+    return slot;
+}
+
+int op_proc_add_pending( struct op_proc *p_op_proc, int op_n )
+{
+    int result = -1;
+
+    pthread_mutex_lock( &g_op_proc_lock );
+
+    if ( 2 * (p_op_proc->n_pending + 1) <= p_op_proc->pending_capacity )
+    {
+        size_t slot = op_proc_find( p_op_proc, op_n );
+
+        if ( !p_op_proc->p_pending[slot] )
+        {
+            p_op_proc->p_pending[slot] = op_n;
+            p_op_proc->n_pending++;
+        }
+
+        result = 0;
+    }
+
+    pthread_mutex_unlock( &g_op_proc_lock );
+
+    if ( result < 0 )
+        fprintf( stderr, "Too many pending operations: op_n %d won't be tracked by verify.\n", op_n );
+
+    return result;
+}
+
+/*
+ * Marks a pending operation as done. Called with g_op_proc_lock.
+ *
+ * Returns:
+ *      1 if max_proc changed, 0 otherwise.
+ */
+static int op_proc_done( struct op_proc *p_op_proc, int op_n )
+{
+    size_t mask = p_op_proc->pending_capacity - 1;
+    size_t slot = op_proc_find( p_op_proc, op_n );
+
+    if ( p_op_proc->p_pending[slot] )
+    {
+        // Backward shift: move back the op_n whose probe went through the slot being emptied.
+        size_t next = slot;
+
+        while ( p_op_proc->p_pending[next = (next + 1) & mask] )
+        {
+            size_t home = op_proc_home( p_op_proc, p_op_proc->p_pending[next] );
+
+            if ( ((next - home) & mask) >= ((next - slot) & mask) )
+            {
+                p_op_proc->p_pending[slot] = p_op_proc->p_pending[next];
+                slot = next;
+            }
+        }
+
+        p_op_proc->p_pending[slot] = 0;
+        p_op_proc->n_pending--;
+    }
+
+    if ( op_n <= p_op_proc->max_proc )
+        return 0;
+
+    p_op_proc->max_proc = op_n;
+
+    return 1;
+}
+
+int op_proc_set_done( struct op_proc *p_op_proc, int op_n )
+{
+    pthread_mutex_lock( &g_op_proc_lock );
+    int has_changed = op_proc_done( p_op_proc, op_n );
+    pthread_mutex_unlock( &g_op_proc_lock );
+
+    return has_changed;
+}
+
+int op_proc_finish( struct op_proc *p_op_proc, int index, int *p_op_ns, int n )
+{
+    int has_changed = 0;
+
+    pthread_mutex_lock( &g_op_proc_lock );
+
+    for ( int i = 0; i < n; i++ )
+        has_changed |= op_proc_done( p_op_proc, p_op_ns[i] );
+
+    if ( index >= 0 && (size_t)index < p_op_proc->in_progress_size )
+        p_op_proc->p_in_progress[index] = 0;
+
+    pthread_mutex_unlock( &g_op_proc_lock );
+
+    return has_changed;
+}
+
+void op_proc_set_failed( struct op_proc *p_op_proc, int op_n )
+{
+    pthread_mutex_lock( &g_op_proc_lock );
+    p_op_proc->p_failed[p_op_proc->n_failed++ % TREE_SKEL_MAX_FAILED] = op_n;
+    pthread_mutex_unlock( &g_op_proc_lock );
+}
+
+int op_proc_has_failed( struct op_proc *p_op_proc, int op_n )
+{
+    int result = 0;
+
+    pthread_mutex_lock( &g_op_proc_lock );
+
+    size_t n = p_op_proc->n_failed < TREE_SKEL_MAX_FAILED ? p_op_proc->n_failed : TREE_SKEL_MAX_FAILED;
+
+    for ( size_t i = 0; i < n && !result; i++ )
+        result = p_op_proc->p_failed[i] == op_n;
+
+    pthread_mutex_unlock( &g_op_proc_lock );
+
+    return result;
+}
+
+int op_proc_is_pending( struct op_proc *p_op_proc, int op_n )
+{
+    int result;
+
+    pthread_mutex_lock( &g_op_proc_lock );
+    result = p_op_proc->p_pending[op_proc_find( p_op_proc, op_n )] != 0;
+    pthread_mutex_unlock( &g_op_proc_lock );
+
+    return result;
+}
+
 int op_proc_get_max_proc( struct op_proc *p_op_proc )
 {
     int result;